@@ -0,0 +1,224 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#include "analysiscache.h"
+
+std::map<AST *, std::pair<std::weak_ptr<AST>, std::shared_ptr<AnalysisCache>>> AnalysisCache::m_caches;
+std::mutex AnalysisCache::m_cachesLock;
+
+AnalysisCache::Mutation::Mutation(ASTNode tree) :
+    m_cache(AnalysisCache::forTree(tree))
+{
+    if (m_cache) {
+        m_cache->m_mutations++;
+    }
+}
+
+AnalysisCache::Mutation::~Mutation()
+{
+    if (m_cache) {
+        {
+            std::lock_guard<std::mutex> locker(m_cache->m_lock);
+            m_cache->m_declarations.clear();
+            m_cache->m_values.clear();
+            m_cache->m_generation++;
+        }
+        m_cache->m_mutations--;
+    }
+}
+
+AnalysisCache::AnalysisCache(ASTNode tree) :
+    m_tree(tree)
+{
+}
+
+std::shared_ptr<AnalysisCache> AnalysisCache::forTree(ASTNode tree)
+{
+    if (!tree) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> locker(m_cachesLock);
+    auto it = m_caches.find(tree.get());
+    if (it != m_caches.end() && it->second.first.lock() == tree) {
+        return it->second.second;
+    }
+    // Drop caches of trees that are gone before adding a new one
+    for (auto cache = m_caches.begin(); cache != m_caches.end();) {
+        if (cache->second.first.expired()) {
+            cache = m_caches.erase(cache);
+        } else {
+            ++cache;
+        }
+    }
+    auto cache = std::make_shared<AnalysisCache>(tree);
+    m_caches[tree.get()] = std::make_pair(std::weak_ptr<AST>(tree), cache);
+    return cache;
+}
+
+void AnalysisCache::invalidate(ASTNode tree)
+{
+    std::shared_ptr<AnalysisCache> cache = forTree(tree);
+    if (cache) {
+        std::lock_guard<std::mutex> locker(cache->m_lock);
+        cache->m_declarations.clear();
+        cache->m_values.clear();
+        cache->m_generation++;
+    }
+}
+
+std::shared_ptr<DeclarationNode> AnalysisCache::findDeclaration(std::string objectName, const QVector<ASTNode> &scopeStack,
+                                                                ASTNode tree, const std::vector<std::string> &scope,
+                                                                const std::vector<std::string> &defaultNamespaces,
+                                                                std::function<std::shared_ptr<DeclarationNode>()> lookup)
+{
+    std::shared_ptr<AnalysisCache> cache = forTree(tree);
+    if (!cache || cache->m_mutations.load() > 0) {
+        return lookup();
+    }
+    std::string key = objectName;
+    for (const std::string &ns: scope) {
+        key += ':' + ns;
+    }
+    key += '\0';
+    for (const std::string &ns: defaultNamespaces) {
+        key += ':' + ns;
+    }
+    key += '\0' + cache->scopeKey(scopeStack);
+    std::vector<std::pair<size_t, unsigned int>> snapshot = cache->takeSnapshot(scopeStack);
+    unsigned int generation;
+    {
+        std::lock_guard<std::mutex> locker(cache->m_lock);
+        auto it = cache->m_declarations.find(key);
+        if (it != cache->m_declarations.end() && it->second.snapshot == snapshot
+                && sameNodes(it->second.scopeNodes, scopeStack)) {
+            return it->second.declaration;
+        }
+        generation = cache->m_generation.load();
+    }
+    std::shared_ptr<DeclarationNode> declaration = lookup();
+    std::lock_guard<std::mutex> locker(cache->m_lock);
+    // Don't keep results found while the tree was changing
+    if (cache->m_generation.load() == generation && cache->m_mutations.load() == 0) {
+        std::vector<std::weak_ptr<AST>> scopeNodes(scopeStack.begin(), scopeStack.end());
+        cache->m_declarations[key] = DeclarationEntry{declaration, snapshot, scopeNodes};
+    }
+    return declaration;
+}
+
+double AnalysisCache::memoize(AnalysisCache::Query query, ASTNode node, const QVector<ASTNode> &scopeStack,
+                              ASTNode tree, QList<LangError> *errors, std::function<double ()> compute)
+{
+    std::shared_ptr<AnalysisCache> cache = forTree(tree);
+    if (!cache || cache->m_mutations.load() > 0) {
+        return compute();
+    }
+    std::string key(1, (char) query);
+    AST *pointer = node.get();
+    key.append((const char *) &pointer, sizeof(pointer));
+    key += cache->scopeKey(scopeStack);
+    unsigned int generation;
+    {
+        std::lock_guard<std::mutex> locker(cache->m_lock);
+        auto it = cache->m_values.find(key);
+        if (it != cache->m_values.end()) {
+            if (sameNodes(it->second.nodes, scopeStack, node)) {
+                return it->second.value;
+            }
+            // A new node at the address of a freed one
+            cache->m_values.erase(it);
+        }
+        generation = cache->m_generation.load();
+    }
+    int errorCount = errors ? errors->size() : 0;
+    double value = compute();
+    if (errors && errors->size() != errorCount) {
+        return value;
+    }
+    std::lock_guard<std::mutex> locker(cache->m_lock);
+    // Don't keep results computed while the tree was changing
+    if (cache->m_generation.load() == generation && cache->m_mutations.load() == 0) {
+        std::vector<std::weak_ptr<AST>> nodes{node};
+        nodes.insert(nodes.end(), scopeStack.begin(), scopeStack.end());
+        cache->m_values[key] = ValueEntry{value, nodes};
+    }
+    return value;
+}
+
+std::string AnalysisCache::scopeKey(const QVector<ASTNode> &scopeStack)
+{
+    std::string key;
+    for (const ASTNode &scopeNode: scopeStack) {
+        AST *pointer = scopeNode.get();
+        key.append((const char *) &pointer, sizeof(pointer));
+    }
+    return key;
+}
+
+std::vector<std::pair<size_t, unsigned int>> AnalysisCache::takeSnapshot(const QVector<ASTNode> &scopeStack)
+{
+    std::vector<std::pair<size_t, unsigned int>> snapshot;
+    ASTNode tree = m_tree.lock();
+    if (tree) {
+        snapshot.push_back({tree->getChildCount(), tree->getChildrenRevision()});
+    }
+    for (const ASTNode &scopeNode: scopeStack) {
+        if (scopeNode) {
+            snapshot.push_back({scopeNode->getChildCount(), scopeNode->getChildrenRevision()});
+        }
+    }
+    return snapshot;
+}
+
+bool AnalysisCache::sameNodes(const std::vector<std::weak_ptr<AST>> &nodes, const QVector<ASTNode> &scopeStack,
+                              ASTNode first)
+{
+    size_t offset = first ? 1 : 0;
+    if (nodes.size() != offset + scopeStack.size()) {
+        return false;
+    }
+    // Compared by owner, so a node allocated where a freed one was is a
+    // different node
+    auto same = [](const std::weak_ptr<AST> &stored, const ASTNode &node) {
+        return !stored.owner_before(node) && !node.owner_before(stored);
+    };
+    if (first && !same(nodes[0], first)) {
+        return false;
+    }
+    for (int i = 0; i < scopeStack.size(); i++) {
+        if (!same(nodes[offset + i], scopeStack[i])) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,138 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#ifndef ANALYSISCACHE_H
+#define ANALYSISCACHE_H
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <QList>
+#include <QVector>
+
+#include "ast.h"
+#include "declarationnode.h"
+#include "langerror.h"
+
+/// Memoized results of CodeValidator queries on a tree, shared by everything
+/// analyzing that tree during a compilation.
+///
+/// Declaration lookups are kept until the tree or a list in the scope gains
+/// or replaces children, or a node in the scope is freed. Query results are
+/// dropped when their node or a node in their scope is freed. All results
+/// are kept until invalidate() is called, and are not memoized while a
+/// Mutation is alive, as the resolver changes the tree as it goes. All
+/// functions can be called from several threads.
+class AnalysisCache
+{
+public:
+    typedef enum {
+        ConstInteger,
+        ConstReal,
+        NodeSize,
+        BundleSize,
+        BlockDeclaredSize,
+        NumOutputs,
+        NumInputs
+    } Query;
+
+    /// Held by code that changes the tree. Results are not memoized while it
+    /// is alive and are dropped when it goes away.
+    class Mutation {
+    public:
+        Mutation(ASTNode tree);
+        ~Mutation();
+    private:
+        std::shared_ptr<AnalysisCache> m_cache;
+    };
+
+    AnalysisCache(ASTNode tree);
+
+    /// The cache for tree, or nullptr if tree is nullptr.
+    static std::shared_ptr<AnalysisCache> forTree(ASTNode tree);
+
+    /// Drop all memoized results for tree.
+    static void invalidate(ASTNode tree);
+
+    /// Memoized CodeValidator::findDeclaration(). lookup is called on a miss.
+    static std::shared_ptr<DeclarationNode> findDeclaration(std::string objectName, const QVector<ASTNode> &scopeStack,
+                                                            ASTNode tree, const std::vector<std::string> &scope,
+                                                            const std::vector<std::string> &defaultNamespaces,
+                                                            std::function<std::shared_ptr<DeclarationNode>()> lookup);
+
+    /// Memoized result of query for node in scopeStack. compute is called on
+    /// a miss. Results that add to errors are not memoized, so their errors
+    /// are reported every time.
+    static double memoize(Query query, ASTNode node, const QVector<ASTNode> &scopeStack, ASTNode tree,
+                          QList<LangError> *errors, std::function<double()> compute);
+
+private:
+    struct DeclarationEntry {
+        std::shared_ptr<DeclarationNode> declaration;
+        // Child count and revision of the tree and of each scope entry
+        std::vector<std::pair<size_t, unsigned int>> snapshot;
+        // The key holds scope node addresses, which a new node can reuse
+        // once these are gone
+        std::vector<std::weak_ptr<AST>> scopeNodes;
+    };
+
+    struct ValueEntry {
+        double value;
+        // The node followed by the scope, for the same reason
+        std::vector<std::weak_ptr<AST>> nodes;
+    };
+
+    std::string scopeKey(const QVector<ASTNode> &scopeStack);
+    std::vector<std::pair<size_t, unsigned int>> takeSnapshot(const QVector<ASTNode> &scopeStack);
+    static bool sameNodes(const std::vector<std::weak_ptr<AST>> &nodes, const QVector<ASTNode> &scopeStack,
+                          ASTNode first = nullptr);
+
+    std::weak_ptr<AST> m_tree;
+    std::unordered_map<std::string, DeclarationEntry> m_declarations;
+    std::unordered_map<std::string, ValueEntry> m_values;
+    std::atomic<int> m_mutations {0};
+    std::atomic<unsigned int> m_generation {0};
+    std::mutex m_lock;
+
+    static std::map<AST *, std::pair<std::weak_ptr<AST>, std::shared_ptr<AnalysisCache>>> m_caches;
+    static std::mutex m_cachesLock;
+};
+
+#endif // ANALYSISCACHE_H
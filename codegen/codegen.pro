@@ -21,7 +21,10 @@ SOURCES += \
     stridelibrary.cpp \
     strideplatform.cpp \
     stridesystem.cpp \
-    systemconfiguration.cpp
+    systemconfiguration.cpp \
+    typeregistry.cpp \
+    analysiscache.cpp \
+    streamgraph.cpp
 
 HEADERS += \
     pythonproject.h \
@@ -32,7 +35,10 @@ HEADERS += \
     strideplatform.hpp \
     porttypes.h \
     stridesystem.hpp \
-    systemconfiguration.hpp
+    systemconfiguration.hpp \
+    typeregistry.h \
+    analysiscache.h \
+    streamgraph.h
 
 win32-msvc2015:CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../parser/release/ -lStrideParser
 else:win32-msvc2015:CONFIG(debug, debug|release): LIBS += -L$$OUT_PWD/../parser/debug/ -lStrideParser
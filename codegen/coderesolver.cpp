@@ -32,10 +32,13 @@
     Authors: Andres Cabrera and Joseph Tilbian
 */
 
+#include <deque>
+
 #include <QDebug>
 
 #include "coderesolver.h"
 #include "codevalidator.h"
+#include "analysiscache.h"
 
 CodeResolver::CodeResolver(std::shared_ptr<StrideSystem> system, ASTNode tree,
                            SystemConfiguration systemConfig) :
@@ -51,6 +54,8 @@ CodeResolver::~CodeResolver()
 
 void CodeResolver::preProcess()
 {
+    // Sizes and constants change while the tree is being resolved
+    AnalysisCache::Mutation mutation(m_tree);
     insertBuiltinObjects();
     fillDefaultProperties();
     declareModuleInternalBlocks();
@@ -77,76 +82,210 @@ void CodeResolver::processSystem()
 
 void CodeResolver::resolveRates()
 {
-    vector<ASTNode> children = m_tree->getChildren();
-    // First go through backwards to prioritize pull
-    vector<ASTNode>::reverse_iterator rit = children.rbegin();
-    while(rit != children.rend()) {
-        ASTNode node = *rit;
-        if (node->getNodeType() == AST::Stream) {
-            resolveStreamRatesReverse(static_pointer_cast<StreamNode>(node));
+    StreamGraph graph(m_tree);
+    std::vector<RateCell> cells;
+    std::map<void *, int> cellIndex;
+    std::vector<RateTerm> terms;
+    for (size_t i = 0; i < graph.size(); i++) {
+        terms.push_back(makeRateTerm(graph.member(i), cells, cellIndex));
+    }
+    // Members that need to be looked at again when a cell changes
+    std::vector<std::vector<size_t>> cellMembers(cells.size());
+    for (size_t i = 0; i < terms.size(); i++) {
+        std::vector<int> termCells;
+        collectTermCells(terms[i], termCells);
+        for (int cell : termCells) {
+            cellMembers[cell].push_back(i);
+        }
+    }
+
+    std::deque<size_t> worklist;
+    std::vector<bool> queued(terms.size(), false);
+    auto queueChanged = [&](std::vector<int> &changedCells) {
+        for (int cell : changedCells) {
+            for (size_t member : cellMembers[cell]) {
+                if (!queued[member]) {
+                    queued[member] = true;
+                    worklist.push_back(member);
+                }
+            }
+        }
+        changedCells.clear();
+    };
+    auto queueKnown = [&]() {
+        for (size_t i = 0; i < terms.size(); i++) {
+            if (!queued[i] && getTermRate(terms[i], cells) >= 0) {
+                queued[i] = true;
+                worklist.push_back(i);
+            }
+        }
+    };
+    std::vector<int> changedCells;
+
+    // Pull first: members without rate take the rate of the member they
+    // connect to.
+    queueKnown();
+    while (!worklist.empty()) {
+        size_t member = worklist.front();
+        worklist.pop_front();
+        queued[member] = false;
+        double rate = getTermRate(terms[member], cells);
+        if (rate < 0) {
+            continue;
+        }
+        for (size_t connection : graph.incoming(member)) {
+            size_t source = graph.connections()[connection].source;
+            if (getTermRate(terms[source], cells) < 0) {
+                setTermRate(terms[source], rate, cells, changedCells);
+                queueChanged(changedCells);
+            }
         }
-        rit++;
     }
-    // Then do it again from the top to try to resolve the rest
-    for(ASTNode node: children) {
-        if (node->getNodeType() == AST::Stream) {
-            resolveStreamRates(static_pointer_cast<StreamNode>(node));
+
+    // Then push known rates downstream
+    auto propagateForward = [&]() {
+        while (!worklist.empty()) {
+            size_t member = worklist.front();
+            worklist.pop_front();
+            queued[member] = false;
+            double rate = getTermRate(terms[member], cells);
+            if (rate < 0) {
+                continue;
+            }
+            for (size_t connection : graph.outgoing(member)) {
+                size_t destination = graph.connections()[connection].destination;
+                if (getTermRate(terms[destination], cells) <= 0) {
+                    setTermRate(terms[destination], rate, cells, changedCells);
+                    queueChanged(changedCells);
+                }
+            }
+        }
+    };
+    queueKnown();
+    propagateForward();
+
+    // Anything feeding a stream that is still unresolved runs at platform rate
+    std::shared_ptr<DeclarationNode> domainDeclaration = CodeValidator::findDomainDeclaration(m_system->getPlatformDomain().toStdString(), m_tree);
+    if (domainDeclaration) {
+        ASTNode rateValue = domainDeclaration->getPropertyValue("rate");
+        if (rateValue->getNodeType() == AST::Int
+                || rateValue->getNodeType() == AST::Real) {
+            double platformRate = static_cast<ValueNode *>(rateValue.get())->toReal();
+            for (const StreamGraph::Connection &connection : graph.connections()) {
+                if (getTermRate(terms[connection.source], cells) < 0) {
+                    setTermRate(terms[connection.source], platformRate, cells, changedCells);
+                    queueChanged(changedCells);
+                }
+            }
+            propagateForward();
+        } else {
+            qDebug() << "Unexpected type for rate in domain declaration: " << m_system->getPlatformDomain();
+        }
+    }
+
+    for (RateCell &cell : cells) {
+        if (cell.changed) {
+            if (cell.declaration) {
+                cell.declaration->replacePropertyValue("rate", std::make_shared<ValueNode>(cell.rate, "", -1));
+            } else if (cell.function) {
+                cell.function->setRate(cell.rate);
+            }
         }
     }
 }
 
-void CodeResolver::resolveStreamRatesReverse(std::shared_ptr<StreamNode> stream)
+CodeResolver::RateTerm CodeResolver::makeRateTerm(ASTNode node, std::vector<RateCell> &cells, std::map<void *, int> &cellIndex)
 {
-    ASTNode left = stream->getLeft();
-    ASTNode right = stream->getRight();
-    double rate = CodeValidator::getNodeRate(left, QVector<ASTNode>(), m_tree);
-    double rightRate = -1;
-    if (right->getNodeType() == AST::Stream) {
-        resolveStreamRatesReverse(static_pointer_cast<StreamNode>(right));
-        rightRate = CodeValidator::getNodeRate(static_cast<StreamNode *>(right.get())->getLeft(), QVector<ASTNode>(), m_tree);
-    } else {
-        rightRate = CodeValidator::getNodeRate(right, QVector<ASTNode>(), m_tree);
-    }
-    if (rate < 0 && rightRate >= 0) {
-        CodeValidator::setNodeRate(left, rightRate, QVector<ASTNode>(), m_tree);
+    RateTerm term;
+    if (node->getNodeType() == AST::Block || node->getNodeType() == AST::Bundle) {
+        std::shared_ptr<DeclarationNode> declaration;
+        if (node->getNodeType() == AST::Block) {
+            BlockNode *name = static_cast<BlockNode *>(node.get());
+            declaration = CodeValidator::findDeclaration(QString::fromStdString(name->getName()), QVector<ASTNode>(), m_tree, name->getNamespaceList());
+        } else {
+            BundleNode *bundle = static_cast<BundleNode *>(node.get());
+            declaration = CodeValidator::findDeclaration(QString::fromStdString(bundle->getName()), QVector<ASTNode>(), m_tree, bundle->getNamespaceList());
+        }
+        if (declaration) {
+            auto it = cellIndex.find(declaration.get());
+            if (it != cellIndex.end()) {
+                term.cell = it->second;
+            } else {
+                RateCell cell;
+                cell.declaration = declaration;
+                cell.rate = CodeValidator::findRateInProperties(declaration->getProperties(), QVector<ASTNode>(), m_tree);
+                // Rate can only be set on declarations that have a rate property
+                cell.writable = CodeValidator::findPropertyByName(declaration->getProperties(), "rate") != nullptr;
+                term.cell = cells.size();
+                cellIndex[declaration.get()] = term.cell;
+                cells.push_back(cell);
+            }
+        }
+    } else if (node->getNodeType() == AST::Function) {
+        RateCell cell;
+        cell.function = static_pointer_cast<FunctionNode>(node);
+        cell.rate = cell.function->getRate();
+        cell.writable = true;
+        term.cell = cells.size();
+        cellIndex[node.get()] = term.cell;
+        cells.push_back(cell);
+    } else if (node->getNodeType() == AST::List
+               || node->getNodeType() == AST::Expression) {
+        term.aggregate = true;
+        for (ASTNode element : node->getChildren()) {
+            term.elements.push_back(makeRateTerm(element, cells, cellIndex));
+        }
     }
-//    Q_ASSERT(rate != -1);
-    //    stream->setRate(rate);
+    return term;
 }
 
-void CodeResolver::resolveStreamRates(std::shared_ptr<StreamNode> stream)
+double CodeResolver::getTermRate(const RateTerm &term, const std::vector<RateCell> &cells)
 {
-    ASTNode left = stream->getLeft();
-    ASTNode right = stream->getRight();
-    double rate = CodeValidator::getNodeRate(left, QVector<ASTNode>(), m_tree);
-    if (rate < 0) { // Force node rate to platform rate
-        std::shared_ptr<DeclarationNode> domainDeclaration = CodeValidator::findDomainDeclaration(m_system->getPlatformDomain().toStdString(), m_tree);
-        if (domainDeclaration) {
-            ASTNode rateValue = domainDeclaration->getPropertyValue("rate");
-            if (rateValue->getNodeType() == AST::Int
-                    || rateValue->getNodeType() == AST::Real) {
-                double rate = static_cast<ValueNode *>(rateValue.get())->toReal();
-                CodeValidator::setNodeRate(left, rate, QVector<ASTNode>(), m_tree);
-            } else {
-                qDebug() << "Unexpected type for rate in domain declaration: " << m_system->getPlatformDomain();
+    if (term.aggregate) {
+        // Same as CodeValidator::getNodeRate(): the last element with a rate
+        double rate = -1.0;
+        for (const RateTerm &element : term.elements) {
+            double elementRate = getTermRate(element, cells);
+            if (elementRate != -1.0) {
+                rate = elementRate;
             }
         }
+        return rate;
     }
-    double rightRate = -1;
-    if (right->getNodeType() == AST::Stream) {
-        rightRate = CodeValidator::getNodeRate(static_cast<StreamNode *>(right.get())->getLeft(), QVector<ASTNode>(), m_tree);
-        if (rightRate <= 0 && rate >= 0) {
-            CodeValidator::setNodeRate(static_cast<StreamNode *>(right.get())->getLeft(), rate, QVector<ASTNode>(), m_tree);
+    if (term.cell >= 0) {
+        return cells[term.cell].rate;
+    }
+    return -1;
+}
+
+void CodeResolver::setTermRate(const RateTerm &term, double rate, std::vector<RateCell> &cells, std::vector<int> &changedCells)
+{
+    if (term.aggregate) {
+        for (const RateTerm &element : term.elements) {
+            if (getTermRate(element, cells) < 0.0) {
+                setTermRate(element, rate, cells, changedCells);
+            }
         }
-        resolveStreamRates(static_pointer_cast<StreamNode>(right));
-    } else {
-        rightRate = CodeValidator::getNodeRate(right, QVector<ASTNode>(), m_tree);
-        if (rightRate <= 0 && rate >= 0) {
-            CodeValidator::setNodeRate(right, rate, QVector<ASTNode>(), m_tree);
+    } else if (term.cell >= 0) {
+        RateCell &cell = cells[term.cell];
+        if (cell.writable && cell.rate != rate) {
+            cell.rate = rate;
+            cell.changed = true;
+            changedCells.push_back(term.cell);
         }
     }
 }
 
+void CodeResolver::collectTermCells(const RateTerm &term, std::vector<int> &termCells)
+{
+    if (term.cell >= 0) {
+        termCells.push_back(term.cell);
+    }
+    for (const RateTerm &element : term.elements) {
+        collectTermCells(element, termCells);
+    }
+}
+
 void CodeResolver::fillDefaultPropertiesForNode(ASTNode node)
 {
     if (node->getNodeType() == AST::Declaration || node->getNodeType() == AST::BundleDeclaration) {
@@ -498,6 +637,7 @@ void CodeResolver::insertBuiltinObjects()
     if (m_system) {
         bultinObjects = m_system->getBuiltinObjectsReference();
     }
+    indexBuiltinObjects(bultinObjects);
 
     // First pass to add the fundamental types
     for (ASTNode object : bultinObjects[""]) {
@@ -534,41 +674,32 @@ void CodeResolver::insertBuiltinObjects()
         }
     }
     for (std::shared_ptr<DeclarationNode> declaration : requiredDeclarations) {
-//        insertBuiltinObjectsForNode(declaration, bultinObjects);
-        insertDependentTypes(declaration->getObjectType(), bultinObjects);
+        insertDependentTypes(declaration->getObjectType());
         m_tree->addChild(declaration->deepCopy());
     }
 
     // Second pass to add elements that depend on the user's code
     for (ASTNode object : m_tree->getChildren()) {
-        insertBuiltinObjectsForNode(object, bultinObjects);
+        insertBuiltinObjectsForNode(object);
     }
 
 }
 
 void CodeResolver::processDomains()
 {
-    // Fill missing domain information (propagate domains)
-    // First we need to traverse the streams backwards to make sure we propagate the domains from the furthest point down the line
+    // Fill missing domain information. Module internals are resolved first
+    // as top level streams may connect to them.
     vector<ASTNode > children = m_tree->getChildren();
+    QVector<ASTNode > scopeStack;
     vector<ASTNode >::reverse_iterator rit = children.rbegin();
-    QVector<ASTNode > scopeStack; // = QVector<AST*>::fromStdVector(children);
-
     while(rit != children.rend()) {
         ASTNode node = *rit;
-        propagateDomainsForNode(node, scopeStack);
+        if (node->getNodeType() == AST::Declaration) {
+            propagateDomainsForNode(node, scopeStack);
+        }
         rit++;
     }
-    // Now go forward propagating domains
-    // But this is currently messing things up... Test carefully
-//    auto it = children.begin();
-//    while(it != children.end()) {
-//        ASTNode node = *it;
-//        propagateDomainsForNode(node, scopeStack);
-//        ++it;
-//    }
-
-    // TODO Do we need to propagate domains forward too
+    inferStreamDomains(children, scopeStack, getContextDomainName(scopeStack));
 
     // Any signals without domain are assigned to the platform domain
     std::shared_ptr<DeclarationNode> domainDecl = CodeValidator::findDomainDeclaration(m_system->getPlatformDomain().toStdString(), m_tree);
@@ -622,118 +753,225 @@ void CodeResolver::analyzeConnections()
     }
 }
 
-void CodeResolver::insertDependentTypes(string typeName, map<string, vector<ASTNode>> &objects) {
-    QList<std::shared_ptr<DeclarationNode>> blockList;
+void CodeResolver::eliminateDeadCode()
+{
+    AnalysisCache::Mutation mutation(m_tree);
+    // Streams are kept if they reach a sink (hardware or network outputs,
+    // reactions, loops or platform modules) or if they write to a name read
+    // by something that is kept. Declarations of the prunable types are kept
+    // only if something that is kept refers to them. Names used inside live
+    // reactions, loops and modules are reads too, so streams and declarations
+    // are marked together until nothing changes.
+    const std::set<string> prunableTypes = {"module", "reaction", "loop", "signal", "switch",
+                                            "trigger", "buffer", "signalbridge"};
+    std::vector<ASTNode> streams;
+    std::vector<std::shared_ptr<DeclarationNode>> pending;
+    std::set<string> liveNames;
+    for (ASTNode object : m_tree->getChildren()) {
+        if (object->getNodeType() == AST::Stream) {
+            streams.push_back(object);
+        } else if (object->getNodeType() == AST::Declaration || object->getNodeType() == AST::BundleDeclaration) {
+            std::shared_ptr<DeclarationNode> decl = static_pointer_cast<DeclarationNode>(object);
+            if (prunableTypes.find(decl->getObjectType()) == prunableTypes.end()) {
+                collectReferencedNames(decl, liveNames);
+            } else {
+                pending.push_back(decl);
+            }
+        }
+    }
+    std::vector<std::set<string>> writtenNames(streams.size());
+    std::vector<bool> liveStreams(streams.size(), false);
+    for (size_t i = 0; i < streams.size(); i++) {
+        collectWrittenNames(streams[i], writtenNames[i]);
+        if (nodeHasSideEffects(streams[i], QVector<ASTNode>())) {
+            liveStreams[i] = true;
+            collectReferencedNames(streams[i], liveNames);
+        }
+    }
+    std::set<std::shared_ptr<DeclarationNode>> liveDeclarations;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < streams.size(); i++) {
+            if (liveStreams[i]) {
+                continue;
+            }
+            for (string name: writtenNames[i]) {
+                if (liveNames.find(name) != liveNames.end()) {
+                    liveStreams[i] = true;
+                    collectReferencedNames(streams[i], liveNames);
+                    changed = true;
+                    break;
+                }
+            }
+        }
+        for (auto decl: pending) {
+            if (liveDeclarations.find(decl) == liveDeclarations.end()
+                    && liveNames.find(decl->getName()) != liveNames.end()) {
+                liveDeclarations.insert(decl);
+                if (decl->getObjectType() == "module") {
+                    eliminateDeadModuleCode(decl);
+                }
+                collectReferencedNames(decl, liveNames);
+                changed = true;
+            }
+        }
+    }
+
+    std::vector<ASTNode> liveNodes;
+    for (ASTNode object : m_tree->getChildren()) {
+        if (object->getNodeType() == AST::Stream) {
+            size_t index = std::find(streams.begin(), streams.end(), object) - streams.begin();
+            if (!liveStreams[index]) {
+                continue;
+            }
+        } else if (object->getNodeType() == AST::Declaration || object->getNodeType() == AST::BundleDeclaration) {
+            std::shared_ptr<DeclarationNode> decl = static_pointer_cast<DeclarationNode>(object);
+            if (prunableTypes.find(decl->getObjectType()) != prunableTypes.end()
+                    && liveDeclarations.find(decl) == liveDeclarations.end()) {
+                continue;
+            }
+        }
+        liveNodes.push_back(object);
+    }
+    m_tree->setChildren(liveNodes);
+}
+
+void CodeResolver::indexBuiltinObjects(const map<string, vector<ASTNode>> &objects)
+{
+    m_builtinsByName.clear();
+    m_builtinTypes.clear();
+    m_builtinDomains.clear();
+    for (auto it = objects.begin(); it != objects.end(); it++) {
+        for (ASTNode object : it->second) {
+            if (object->getNodeType() != AST::Declaration
+                    && object->getNodeType() != AST::BundleDeclaration) {
+                continue;
+            }
+            std::shared_ptr<DeclarationNode> declaration = static_pointer_cast<DeclarationNode>(object);
+            BuiltinObject builtin{it->first, declaration};
+            m_builtinsByName[declaration->getName()].push_back(builtin);
+            if (object->getNodeType() != AST::Declaration) {
+                continue;
+            }
+            if (declaration->getObjectType() == "type"
+                    || declaration->getObjectType() == "platformType") {
+                ASTNode nameNode = declaration->getPropertyValue("typeName");
+                if (nameNode && nameNode->getNodeType() == AST::String) {
+                    m_builtinTypes[static_cast<ValueNode *>(nameNode.get())->getStringValue()].push_back(builtin);
+                }
+            } else if (declaration->getObjectType() == "_domainDefinition") {
+                ASTNode nameNode = declaration->getPropertyValue("domainName");
+                if (nameNode && nameNode->getNodeType() == AST::String) {
+                    m_builtinDomains[static_cast<ValueNode *>(nameNode.get())->getStringValue()].push_back(builtin);
+                }
+            }
+        }
+    }
+    m_builtinsIndexed = true;
+}
+
+vector<string> CodeResolver::builtinNamespaces(const BuiltinIndex &index, string key)
+{
+    vector<string> namespaces;
+    auto candidates = index.find(key);
+    if (candidates != index.end()) {
+        for (const BuiltinObject &builtin : candidates->second) {
+            // Candidates are grouped by namespace
+            if (namespaces.empty() || namespaces.back() != builtin.rootNamespace) {
+                namespaces.push_back(builtin.rootNamespace);
+            }
+        }
+    }
+    return namespaces;
+}
+
+QVector<ASTNode> CodeResolver::builtinCandidates(const BuiltinIndex &index, string key, string rootNamespace, bool includeInserted)
+{
+    QVector<ASTNode> candidates;
+    auto entries = index.find(key);
+    if (entries != index.end()) {
+        for (const BuiltinObject &builtin : entries->second) {
+            if (builtin.rootNamespace == rootNamespace
+                    && (includeInserted || m_insertedBuiltins.find(builtin.declaration) == m_insertedBuiltins.end())) {
+                candidates << builtin.declaration;
+            }
+        }
+    }
+    return candidates;
+}
+
+void CodeResolver::insertDependentTypes(string typeName) {
+    // Once a type has been looked up, it and the types it inherits from are
+    // either in the tree or not available in the library.
+    if (!m_resolvedTypes.insert(typeName).second) {
+        return;
+    }
     QList<LangError> errors;
-//    auto is_declared = CodeValidator::findTypeDeclaration(decl, QVector<ASTNode >(), m_tree, errors);
     std::shared_ptr<DeclarationNode> existingDecl = CodeValidator::findTypeDeclarationByName(typeName, QVector<ASTNode >(), m_tree, errors);
-    for (auto it = objects.begin(); it != objects.end(); it++)  {
-        // Look for type declaration in object lists
-        if(!existingDecl) {
-            auto newTypeDeclaration = CodeValidator::findTypeDeclarationByName(typeName, QVector<ASTNode >::fromStdVector(it->second), nullptr, errors);
+    if (!existingDecl) {
+        // Look for type declaration in library namespaces
+        for (string rootNamespace : builtinNamespaces(m_builtinTypes, typeName)) {
+            auto newTypeDeclaration = CodeValidator::findTypeDeclarationByName(typeName, builtinCandidates(m_builtinTypes, typeName, rootNamespace), nullptr, errors);
             if (newTypeDeclaration) { // type declaration found
-                newTypeDeclaration->setRootScope(it->first);
+                newTypeDeclaration->setRootScope(rootNamespace);
                 m_tree->addChild(newTypeDeclaration);
                 existingDecl = newTypeDeclaration;
                 for (ASTNode child : existingDecl->getChildren()) {
-                    insertBuiltinObjectsForNode(child, objects);
-                }
-            }
-        }
-        if (existingDecl) {
-            vector<string> inheritedTypes = CodeValidator::getInheritedTypeNames(existingDecl, QVector<ASTNode>::fromStdVector(it->second), m_tree);
-            for (auto inheritedType: inheritedTypes) {
-                insertDependentTypes(inheritedType, objects);
-            }
-        }
-
-        //            if (typeDeclaration && !blockList.contains(typeDeclaration)) {
-        //                typeDeclaration->setRootScope(it->first);
-        //                blockList << typeDeclaration;
-
-        //                for(string &typeName : inheritedTypes) {
-        //                    ASTNode existingDeclaration = CodeValidator::findTypeDeclarationByName(typeName, QVector<ASTNode >(), m_tree, errors);
-        //                    if (!existingDeclaration) {
-        //                        auto newTypeDeclaration = CodeValidator::findTypeDeclarationByName(typeName, QVector<ASTNode >::fromStdVector(rootNamespace), nullptr, errors);
-        //                        if (newTypeDeclaration && !blockList.contains(newTypeDeclaration)) {
-        //                            newTypeDeclaration->setRootScope(it->first);
-        //                            blockList << newTypeDeclaration;
-        //                        }
-        //                    }
-        //                }
-        //            }
-    }
-
-    // Insert declaration for inherited types
-
-//    // Add types that need to be added
-//    for(auto usedBlock : blockList) {
-////        QVector<ASTNode > subscope;
-////        // Make subscope in case this is a module declaration
-////        ASTNode blocks = usedBlock->getPropertyValue("blocks");
-////        if (blocks) {
-////            for(ASTNode declarationNode : blocks->getChildren()) {
-////                if (declarationNode->getNodeType() == AST::Declaration
-////                        || declarationNode->getNodeType() == AST::BundleDeclaration) {
-////                    subscope << declarationNode;
-////                }
-////            }
-////        }
-//        // Add type. It shouldn't be there as this has been checked above
-//        if (!CodeValidator::findDeclaration(QString::fromStdString(usedBlock->getName()),
-//                                            QVector<ASTNode>(), m_tree)) {
-//            m_tree->addChild(usedBlock);
-//            for (auto it = objects.begin(); it != objects.end(); it++)  {
-//                vector<ASTNode > &namespaceObjects = it->second;
-//                auto position = std::find(namespaceObjects.begin(), namespaceObjects.end(), usedBlock);
-//                if (position != namespaceObjects.end()) {
-//                    namespaceObjects.erase(position);
-//                }
-//            }
-//            insertDependentTypes(usedBlock, objects);
-//            //            insertBuiltinObjectsForNode(newBlock, objects);
-//        }
-
-//    }
+                    insertBuiltinObjectsForNode(child);
+                }
+                break;
+            }
+        }
+    }
+    if (existingDecl) {
+        // Parent types are inserted by the recursive calls, so each one can
+        // be found in the tree when its own parents are looked up.
+        vector<string> inheritedTypes = CodeValidator::getInheritedTypeNames(existingDecl, QVector<ASTNode>(), m_tree);
+        for (auto inheritedType: inheritedTypes) {
+            insertDependentTypes(inheritedType);
+        }
+    }
 }
 
-void CodeResolver::insertBuiltinObjectsForNode(ASTNode node, map<string, vector<ASTNode>> &objects)
+void CodeResolver::insertBuiltinObjectsForNode(ASTNode node)
 {
     QList<std::shared_ptr<DeclarationNode>> blockList;
     if (node->getNodeType() == AST::List) {
         for (ASTNode child : node->getChildren()) {
-            insertBuiltinObjectsForNode(child, objects);
+            insertBuiltinObjectsForNode(child);
         }
     } else if (node->getNodeType() == AST::Stream) {
         StreamNode *stream = static_cast<StreamNode*>(node.get());
-        insertBuiltinObjectsForNode(stream->getLeft(), objects);
-        insertBuiltinObjectsForNode(stream->getRight(), objects);
+        insertBuiltinObjectsForNode(stream->getLeft());
+        insertBuiltinObjectsForNode(stream->getRight());
     } else if (node->getNodeType() == AST::Expression) {
         ExpressionNode *expr = static_cast<ExpressionNode*>(node.get());
         if (expr->isUnary()) {
-            insertBuiltinObjectsForNode(expr->getValue(), objects);
+            insertBuiltinObjectsForNode(expr->getValue());
         } else {
-            insertBuiltinObjectsForNode(expr->getLeft(), objects);
-            insertBuiltinObjectsForNode(expr->getRight(), objects);
+            insertBuiltinObjectsForNode(expr->getLeft());
+            insertBuiltinObjectsForNode(expr->getRight());
         }
     } else if (node->getNodeType() == AST::Function) {
         FunctionNode *func = static_cast<FunctionNode *>(node.get());
-        for (auto it = objects.begin(); it != objects.end(); it++)  {
+        for (string rootNamespace : builtinNamespaces(m_builtinsByName, func->getName()))  {
             std::shared_ptr<DeclarationNode> declaration  = CodeValidator::findDeclaration(QString::fromStdString(func->getName()),
-                                                                           QVector<ASTNode >::fromStdVector(it->second), nullptr);
+                                                                           builtinCandidates(m_builtinsByName, func->getName(), rootNamespace), nullptr);
             if (declaration) {
-                declaration->setRootScope(it->first);
+                declaration->setRootScope(rootNamespace);
                 for(auto child: declaration->getChildren()) { // Check if declaration is in current namespace. If it is, set as the namespace of the child
-                    std::shared_ptr<DeclarationNode> childDeclaration = nullptr;
+                    string childName;
                     if (child->getNodeType() == AST::Block) {
-                        childDeclaration = CodeValidator::findDeclaration(QString::fromStdString(static_cast<BlockNode *>(child.get())->getName()),
-                                                                                       QVector<ASTNode >::fromStdVector(it->second), nullptr,
-                                                                                       declaration->getNamespaceList());
+                        childName = static_cast<BlockNode *>(child.get())->getName();
                     } else if (child->getNodeType() == AST::Bundle) {
-                        childDeclaration = CodeValidator::findDeclaration(QString::fromStdString(static_cast<BundleNode *>(child.get())->getName()),
-                                                                                       QVector<ASTNode >::fromStdVector(it->second), nullptr,
-                                                                                       declaration->getNamespaceList());
-                    } // FIXME need to implement for expressions, lists, etc.
+                        childName = static_cast<BundleNode *>(child.get())->getName();
+                    } else {
+                        continue; // FIXME need to implement for expressions, lists, etc.
+                    }
+                    std::shared_ptr<DeclarationNode> childDeclaration = CodeValidator::findDeclaration(QString::fromStdString(childName),
+                                                                                                       builtinCandidates(m_builtinsByName, childName, rootNamespace), nullptr,
+                                                                                                       declaration->getNamespaceList());
                     if (childDeclaration) {
                         child->setNamespaceList(declaration->getNamespaceList());
                     }
@@ -743,14 +981,14 @@ void CodeResolver::insertBuiltinObjectsForNode(ASTNode node, map<string, vector<
         }
         // Look for declarations of blocks present in function properties
         for(auto property :func->getProperties()) {
-            insertBuiltinObjectsForNode(property->getValue(), objects);
+            insertBuiltinObjectsForNode(property->getValue());
         }
         for (std::shared_ptr<DeclarationNode> usedBlock : blockList) {
             // Add declarations to tree if not there
             if (!CodeValidator::findDeclaration(QString::fromStdString(usedBlock->getName()), QVector<ASTNode >(), m_tree, usedBlock->getNamespaceList())) {
-                insertBuiltinObjectsForNode(usedBlock, objects);
+                insertBuiltinObjectsForNode(usedBlock);
                 for (std::shared_ptr<PropertyNode> property : usedBlock->getProperties()) {
-                    insertBuiltinObjectsForNode(property->getValue(), objects);
+                    insertBuiltinObjectsForNode(property->getValue());
                 }
                 ASTNode newBlock = usedBlock;
                 m_tree->addChild(newBlock);
@@ -759,269 +997,275 @@ void CodeResolver::insertBuiltinObjectsForNode(ASTNode node, map<string, vector<
     } else if (node->getNodeType() == AST::Declaration
                || node->getNodeType() == AST::BundleDeclaration) {
         std::shared_ptr<DeclarationNode> declaration = static_pointer_cast<DeclarationNode>(node);
-        vector<ASTNode > namespaceObjects;
         if (declaration->getScopeLevels() > 0) {
-            namespaceObjects = objects[declaration->getScopeAt(0)]; // TODO need to implement for namespaces that are more than one level deep...
-        }
-
-        for(auto child: declaration->getChildren()) { // Check if declaration is in current namespace. If it is, set as the namespace of the child
-            std::shared_ptr<DeclarationNode> childDeclaration = nullptr;
-            if (child->getNodeType() == AST::Block) {
-                childDeclaration = CodeValidator::findDeclaration(QString::fromStdString(static_cast<BlockNode *>(child.get())->getName()),
-                                                                  QVector<ASTNode >::fromStdVector(namespaceObjects), nullptr,
-                                                                  declaration->getNamespaceList());
-            } else if (child->getNodeType() == AST::Bundle) {
-                childDeclaration = CodeValidator::findDeclaration(QString::fromStdString(static_cast<BundleNode *>(child.get())->getName()),
-                                                                  QVector<ASTNode >::fromStdVector(namespaceObjects), nullptr,
-                                                                  declaration->getNamespaceList());
-            } // FIXME need to implement for expressions, lists, etc.
-            if (childDeclaration) {
-                child->setNamespaceList(declaration->getNamespaceList());
+            string rootNamespace = declaration->getScopeAt(0); // TODO need to implement for namespaces that are more than one level deep...
+            for(auto child: declaration->getChildren()) { // Check if declaration is in current namespace. If it is, set as the namespace of the child
+                string childName;
+                if (child->getNodeType() == AST::Block) {
+                    childName = static_cast<BlockNode *>(child.get())->getName();
+                } else if (child->getNodeType() == AST::Bundle) {
+                    childName = static_cast<BundleNode *>(child.get())->getName();
+                } else {
+                    continue; // FIXME need to implement for expressions, lists, etc.
+                }
+                std::shared_ptr<DeclarationNode> childDeclaration = CodeValidator::findDeclaration(QString::fromStdString(childName),
+                                                                                                   builtinCandidates(m_builtinsByName, childName, rootNamespace), nullptr,
+                                                                                                   declaration->getNamespaceList());
+                if (childDeclaration) {
+                    child->setNamespaceList(declaration->getNamespaceList());
+                }
             }
         }
         // Find type declaration and insert it if needed
-        QList<LangError> errors;
-        // Check if type is already declared
-
-        insertDependentTypes(declaration->getObjectType(), objects);
+        insertDependentTypes(declaration->getObjectType());
 
         // Insert needed objects for things in module properties
         for(std::shared_ptr<PropertyNode> property : declaration->getProperties()) {
-            insertBuiltinObjectsForNode(property->getValue(), objects);
+            insertBuiltinObjectsForNode(property->getValue());
         }
         // Process index for bundle declarations
         if (node->getNodeType() == AST::BundleDeclaration) {
-            insertBuiltinObjectsForNode(declaration->getBundle()->index(), objects);
-        }
-
-    } else if (node->getNodeType() == AST::Block) {
-        QList<std::shared_ptr<DeclarationNode>> blockList;
-        BlockNode *name = static_cast<BlockNode *>(node.get());
-
-        for (auto it = objects.begin(); it != objects.end(); it++)  {
-            for(ASTNode object : it->second) {
-                if (object->getNodeType() == AST::Declaration
-                        || object->getNodeType() == AST::BundleDeclaration) {
-                    std::shared_ptr<DeclarationNode> block = static_pointer_cast<DeclarationNode>(object);
-                    if (block->getName() == name->getName()
-                            && !blockList.contains(block)) {
-                        if (!CodeValidator::findDeclaration(QString::fromStdString(block->getName()), QVector<ASTNode >(), m_tree, block->getNamespaceList())) {
-                            //                        ASTNode usedObject = object;
-                            //                        fillDefaultPropertiesForNode(usedObject);
-                            //                        m_tree->addChild(usedObject);
-                            block->setRootScope(it->first);
-                            blockList << block;
-                        }
-                        break;
-
-                    }
-                }
-            }
+            insertBuiltinObjectsForNode(declaration->getBundle()->index());
         }
-        for(auto usedBlock : blockList) {
-            ASTNode newBlock = usedBlock;
-            m_tree->addChild(newBlock);
-            for (auto it = objects.begin(); it != objects.end(); it++)  {
-                vector<ASTNode > &namespaceObjects = it->second;
-                auto position = std::find(namespaceObjects.begin(), namespaceObjects.end(), usedBlock);
-                if (position != namespaceObjects.end()) {
-                    namespaceObjects.erase(position);
-                }
-            }
-            insertBuiltinObjectsForNode(newBlock, objects);
-        }
-    } else if (node->getNodeType() == AST::Bundle) {
-        QList<std::shared_ptr<DeclarationNode>> blockList;
-        for (auto it = objects.begin(); it != objects.end(); it++)  {
-            for(ASTNode object : it->second) {
-                if (object->getNodeType() == AST::Declaration
-                        || object->getNodeType() == AST::BundleDeclaration) {
-                    BundleNode *bundle = static_cast<BundleNode *>(node.get());
-                    std::shared_ptr<DeclarationNode> block = static_pointer_cast<DeclarationNode>(object);
-                    if (block->getName() == bundle->getName()
-                            && !blockList.contains(block)) {
-                        if (!CodeValidator::findDeclaration(QString::fromStdString(block->getName()), QVector<ASTNode >(), m_tree, block->getNamespaceList())) {
-                            //                        ASTNode usedObject = object;
-                            //                        fillDefaultPropertiesForNode(usedObject);
-                            //                        m_tree->addChild(usedObject);
-
-                            block->setRootScope(it->first);
-                            blockList << block;
-                        }
-                        break;
 
-                    }
+    } else if (node->getNodeType() == AST::Block
+               || node->getNodeType() == AST::Bundle) {
+        string name;
+        if (node->getNodeType() == AST::Block) {
+            name = static_cast<BlockNode *>(node.get())->getName();
+        } else {
+            name = static_cast<BundleNode *>(node.get())->getName();
+        }
+        // Only the first declaration with the name in each namespace is used
+        for (string rootNamespace : builtinNamespaces(m_builtinsByName, name)) {
+            for (ASTNode candidate : builtinCandidates(m_builtinsByName, name, rootNamespace)) {
+                std::shared_ptr<DeclarationNode> block = static_pointer_cast<DeclarationNode>(candidate);
+                if (blockList.contains(block)) {
+                    continue; // Already taken from a previous namespace
                 }
+                if (!CodeValidator::findDeclaration(QString::fromStdString(block->getName()), QVector<ASTNode >(), m_tree, block->getNamespaceList())) {
+                    block->setRootScope(rootNamespace);
+                    blockList << block;
+                }
+                break;
             }
         }
         for(auto usedBlock : blockList) {
             ASTNode newBlock = usedBlock;
             m_tree->addChild(newBlock);
-            for (auto it = objects.begin(); it != objects.end(); it++)  {
-                vector<ASTNode > &namespaceObjects = it->second;
-                auto position = std::find(namespaceObjects.begin(), namespaceObjects.end(), usedBlock);
-                if (position != namespaceObjects.end()) {
-                    namespaceObjects.erase(position);
-                }
-            }
-            insertBuiltinObjectsForNode(newBlock, objects);
+            m_insertedBuiltins.insert(newBlock);
+            insertBuiltinObjectsForNode(newBlock);
         }
     } else if (node->getNodeType() == AST::Property) {
         std::shared_ptr<PropertyNode> prop = std::static_pointer_cast<PropertyNode>(node);
-        insertBuiltinObjectsForNode(prop->getValue(), objects);
+        insertBuiltinObjectsForNode(prop->getValue());
+    }
+}
+
+void CodeResolver::inferStreamDomains(vector<ASTNode> streams, QVector<ASTNode> scopeStack, string contextDomain)
+{
+    StreamGraph graph(streams);
+    vector<DomainElement> elements;
+    map<void *, int> elementIndex;
+    vector<int> memberElements;
+    for (size_t i = 0; i < graph.size(); i++) {
+        int element = domainElementForNode(graph.member(i), scopeStack, elements, elementIndex);
+        if (element < 0) {
+            // Members that can't have a domain pass it on from what follows
+            element = elements.size();
+            elements.push_back(DomainElement());
+        }
+        memberElements.push_back(element);
+    }
+    int contextElement = -1;
+    if (contextDomain.size() > 0) {
+        DomainElement element;
+        element.domain = contextDomain;
+        element.fixed = true;
+        contextElement = elements.size();
+        elements.push_back(element);
+    }
+
+    // Members without domain take the domain of the member they feed. An
+    // element keeps the first link it gets, so later streams take precedence.
+    for (size_t stream = graph.streamCount(); stream-- > 0;) {
+        const vector<size_t> &members = graph.streamMembers(stream);
+        for (size_t i = 0; i + 1 < members.size(); i++) {
+            linkDomainElement(elements, memberElements[members[i]], memberElements[members[i + 1]]);
+        }
+        // The end of a stream takes the context domain, except for functions
+        // which take the domain of what is connected to them.
+        size_t last = members.back();
+        if (graph.member(last)->getNodeType() == AST::Function && members.size() > 1
+                && elements[memberElements[members[members.size() - 2]]].fixed) {
+            linkDomainElement(elements, memberElements[last], memberElements[members[members.size() - 2]]);
+        } else {
+            linkDomainElement(elements, memberElements[last], contextElement);
+        }
     }
-}
 
-void CodeResolver::resolveDomainsForStream(std::shared_ptr<StreamNode> stream, QVector<ASTNode > scopeStack, QString contextDomain)
-{
-    ASTNode left = stream->getLeft();
-    ASTNode right = stream->getRight();
-    QList<ASTNode > domainStack;
-    string previousDomainName = CodeValidator::getDomainNodeString(CodeValidator::getNodeDomain(left, scopeStack, m_tree));
-
-    if (previousDomainName.size() == 0) {
-        previousDomainName = contextDomain.toStdString();
-    }
-    string domainName;
-    while (right) {
-        domainName = processDomainsForNode(left, scopeStack, domainStack);
-        if (left == right && domainName.size() == 0) { // If this is is the last pass then set the unknown domains to platform domain
-            if (left->getNodeType() == AST::Function && domainName == "") {
-                // Have functions/loops/reactions be assigned to whatever they are connected to
-                // if they are final in a stream.
-                if (previousDomainName.size() != 0) {
-                    domainName = previousDomainName;
-                } else {
-                    domainName = contextDomain.toStdString();
-                }
-            } else {
-                // This is needed in cases where signals with no set domain are connected
-                // to input ports on other objects. Domains are not
-                // propagated across secondary ports
-                domainName = contextDomain.toStdString();
-            }
-            domainStack << left;
+    std::set<string> domainNames;
+    for (size_t i = 0; i < elements.size(); i++) {
+        DomainElement &element = elements[i];
+        if (!element.declaration && !element.function) {
+            continue;
         }
-
-        if (domainName.size() > 0 && previousDomainName != domainName) {
-            setDomainForStack(domainStack, domainName, scopeStack);
-            domainStack.clear();
+        if (element.fixed) {
+            domainNames.insert(element.domain);
+            continue;
         }
-        previousDomainName = domainName;
-
-        if (left == right) {
-            if (domainName.size() > 0) {
-                setDomainForStack(domainStack, domainName, scopeStack);
-                domainStack.clear();
+        const DomainElement &root = elements[findDomainRoot(elements, i)];
+        if (root.fixed) {
+            if (element.declaration) {
+                element.declaration->setDomainString(root.domain);
+            } else {
+                element.function->setDomainString(root.domain);
             }
-            right = left = nullptr; // End
-        } else if(right->getNodeType() == AST::Stream) {
-            stream = static_pointer_cast<StreamNode>(right);
-            left = stream->getLeft();
-            right = stream->getRight();
-        } else {
-            left = right; // Last pass (process right, call it left)
+            domainNames.insert(root.domain);
         }
     }
+    for (string domainName : domainNames) {
+        insertDomainDeclaration(domainName);
+    }
 }
 
-std::string CodeResolver::processDomainsForNode(ASTNode node, QVector<ASTNode > scopeStack, QList<ASTNode > &domainStack)
+int CodeResolver::domainElementForNode(ASTNode node, QVector<ASTNode> scopeStack, vector<DomainElement> &elements, map<void *, int> &elementIndex)
 {
-    string domainName;
-    resolveDomainForStreamNode(node, scopeStack);
     if (node->getNodeType() == AST::Block
             || node->getNodeType() == AST::Bundle) {
+        resolveDomainForStreamNode(node, scopeStack);
         std::shared_ptr<DeclarationNode> declaration = CodeValidator::findDeclaration(CodeValidator::streamMemberName(node, scopeStack, m_tree), scopeStack, m_tree, node->getNamespaceList());
-        if(declaration) {
-            ASTNode domain = declaration->getDomain();
-            if (!domain) {
-                // Put declaration in stack to set domain once domain is resolved
-                domainStack << declaration;
-            } else {
-                if (domain->getNodeType() == AST::String) {
-                    domainName = static_cast<ValueNode *>(domain.get())->getStringValue();
-                } else if (domain->getNodeType() == AST::Block) {
-                    QList<LangError> errors;
-                    domainName = CodeValidator::evaluateConstString(domain, scopeStack, m_tree, errors);
-                } else if (domain->getNodeType() == AST::None) {
-                    // TODO does this need to be handled?
-                    domainStack << declaration;
-                } else if (domain->getNodeType() == AST::PortProperty) {
-                    ASTNode resolvedDomain = resolvePortProperty(static_pointer_cast<PortPropertyNode>(domain),
-                                                         scopeStack);
-                    if (resolvedDomain) {
-                        if (resolvedDomain->getNodeType() == AST::String) {
-                            domainName = std::static_pointer_cast<ValueNode>(resolvedDomain)->getStringValue();
-                        } else {
-                            domainName = CodeValidator::getNodeDomainName(resolvedDomain, scopeStack, m_tree);
-                        }
-                        declaration->setDomainString(domainName);
+        if (!declaration) {
+            return -1;
+        }
+        auto it = elementIndex.find(declaration.get());
+        if (it != elementIndex.end()) {
+            return it->second;
+        }
+        DomainElement element;
+        element.declaration = declaration;
+        ASTNode domain = declaration->getDomain();
+        if (domain) {
+            if (domain->getNodeType() == AST::String) {
+                element.domain = static_cast<ValueNode *>(domain.get())->getStringValue();
+                element.fixed = true;
+            } else if (domain->getNodeType() == AST::Block) {
+                QList<LangError> errors;
+                element.domain = CodeValidator::evaluateConstString(domain, scopeStack, m_tree, errors);
+                element.fixed = true;
+            } else if (domain->getNodeType() == AST::PortProperty) {
+                ASTNode resolvedDomain = resolvePortProperty(static_pointer_cast<PortPropertyNode>(domain),
+                                                             scopeStack);
+                if (resolvedDomain) {
+                    if (resolvedDomain->getNodeType() == AST::String) {
+                        element.domain = std::static_pointer_cast<ValueNode>(resolvedDomain)->getStringValue();
+                    } else {
+                        element.domain = CodeValidator::getNodeDomainName(resolvedDomain, scopeStack, m_tree);
                     }
-                    //                    domainStack << declaration;
-                } else {
-                    domainStack << declaration;
+                    declaration->setDomainString(element.domain);
                 }
+                element.fixed = true;
             }
         }
+        if (element.fixed && element.domain.size() == 0) {
+            // Domain can't be resolved, so it is neither set nor passed on
+            elementIndex[declaration.get()] = -1;
+            return -1;
+        }
+        elementIndex[declaration.get()] = elements.size();
+        elements.push_back(element);
+        return elements.size() - 1;
     } else if (node->getNodeType() == AST::Function) {
-        FunctionNode *func = static_cast<FunctionNode *>(node.get());
+        resolveDomainForStreamNode(node, scopeStack);
+        std::shared_ptr<FunctionNode> func = static_pointer_cast<FunctionNode>(node);
+        DomainElement element;
+        element.function = func;
         ASTNode domain = func->getDomain();
-        if (!domain) {
-            // Put declaration in stack to set domain once domain is resolved
-            domainStack << node;
-        } else {
+        if (domain) {
             if (domain->getNodeType() == AST::String) {
-                domainName = static_cast<ValueNode *>(domain.get())->getStringValue();
-            } else if (domain->getNodeType() == AST::None) { // domain is streamDomain
-                domainStack << node;
-            } else {
+                element.domain = static_cast<ValueNode *>(domain.get())->getStringValue();
+                element.fixed = element.domain.size() > 0;
+            } else if (domain->getNodeType() != AST::None) { // None means stream domain
                 qDebug() << "WARNING: Unrecognized domain type"; // Should this trigger an error?
-                domainStack << node;
             }
         }
+        int functionElement = elements.size();
+        elementIndex[func.get()] = functionElement;
+        elements.push_back(element);
+        // Properties without domain take the function's domain
         for(auto member : func->getProperties()) {
-            string propertyDomainName = processDomainsForNode(member->getValue(), scopeStack, domainStack);
-            if (propertyDomainName.size() == 0) {
-                 domainStack << member->getValue();
-            }
+            int propertyElement = domainElementForNode(member->getValue(), scopeStack, elements, elementIndex);
+            linkDomainElement(elements, propertyElement, functionElement);
         }
+        return functionElement;
     } else if (node->getNodeType() == AST::List) {
-        QList<ASTNode > listDomainStack;
-        for (ASTNode  member : node->getChildren()) {
-            string memberDomainName = processDomainsForNode(member, scopeStack, domainStack);
-            if (domainName.size() == 0 && memberDomainName.size() > 0) {
-                domainName = memberDomainName; // list takes domain from first element that has a domain
+        // A list takes the domain of its first element that has one, and
+        // elements without domain take the domain of the list
+        int listElement = elements.size();
+        elements.push_back(DomainElement());
+        int domainMember = -1;
+        vector<int> memberElements;
+        for (ASTNode member : node->getChildren()) {
+            int memberElement = domainElementForNode(member, scopeStack, elements, elementIndex);
+            if (memberElement < 0) {
+                continue;
             }
-            if (memberDomainName.size() == 0) {
-                // Put declaration in stack to set domain once domain is resolved
-
-                listDomainStack << member;
-                // FIMXE: This is very simplistic (or plain wrong....)
-                // It assumes that the next found domain affects all elements
-                // in the list that don't have domains. This is likely a
-                // common case but list elements should inherit domains from
-                // the port to which they are connected.
+            if (elements[memberElement].fixed) {
+                if (domainMember < 0) {
+                    domainMember = memberElement;
+                }
+            } else {
+                memberElements.push_back(memberElement);
             }
         }
-        if (domainName.size() > 0) {
-            setDomainForStack(listDomainStack, domainName, scopeStack);
-        } else {
-            domainStack << listDomainStack; // If list has no defined domain, pass all elements to be set later
+        linkDomainElement(elements, listElement, domainMember);
+        for (int memberElement : memberElements) {
+            linkDomainElement(elements, memberElement, listElement);
         }
+        return listElement;
     } else if (node->getNodeType() == AST::Expression) {
-        for(ASTNode  member : node->getChildren()) {
-            string newDomainName = processDomainsForNode(member, scopeStack, domainStack);
-            // if member doesn't have a domain, put in the stack to resolve later.
-            if (newDomainName.size() == 0) {
-                // Put declaration in stack to set domain once domain is resolved
-                domainStack << member;
-            }
+        // Expressions have no domain of their own. Operands without domain
+        // take the domain of what the expression feeds.
+        int expressionElement = elements.size();
+        elements.push_back(DomainElement());
+        for(ASTNode member : node->getChildren()) {
+            int memberElement = domainElementForNode(member, scopeStack, elements, elementIndex);
+            linkDomainElement(elements, memberElement, expressionElement);
         }
+        return expressionElement;
+    }
+    return -1;
+}
+
+int CodeResolver::findDomainRoot(vector<DomainElement> &elements, int element)
+{
+    int root = element;
+    while (elements[root].parent >= 0) {
+        root = elements[root].parent;
+    }
+    while (elements[element].parent >= 0) {
+        int next = elements[element].parent;
+        elements[element].parent = root;
+        element = next;
+    }
+    return root;
+}
+
+void CodeResolver::linkDomainElement(vector<DomainElement> &elements, int element, int target)
+{
+    if (element < 0 || target < 0) {
+        return;
+    }
+    if (elements[element].fixed || elements[element].parent >= 0) {
+        return;
+    }
+    if (findDomainRoot(elements, target) == element) { // Would close a loop
+        return;
     }
-    return domainName;
+    elements[element].parent = target;
 }
 
-void CodeResolver::setDomainForStack(QList<ASTNode > domainStack, string domainName,  QVector<ASTNode > scopeStack)
+void CodeResolver::insertDomainDeclaration(string domainName)
 {
     // Add domain declaration if not already present (This might happen if
     // the domain is resolved after and it has not been explicitly declared,
@@ -1043,77 +1287,17 @@ void CodeResolver::setDomainForStack(QList<ASTNode > domainStack, string domainN
         }
     }
     if (!domainFound) {
-        map<string, vector<ASTNode >> bultinObjects;
-        if (m_system) {
-            bultinObjects = m_system->getBuiltinObjectsReference();
+        if (!m_builtinsIndexed && m_system) {
+            indexBuiltinObjects(m_system->getBuiltinObjectsReference());
         }
-
         // FIXME shouldnt this have happened in the insert built-in objects function
-        for (auto it = bultinObjects.begin(); it != bultinObjects.end(); it++)  {
-            for (ASTNode object : it->second) {
-                if (object->getNodeType() == AST::Declaration) {
-                    std::shared_ptr<DeclarationNode>block = static_pointer_cast<DeclarationNode>(object);
-                    if (block->getObjectType() == "_domainDefinition") {
-                        ASTNode nameNode = block->getPropertyValue("domainName");
-                        if (nameNode->getNodeType() == AST::String) {
-                            ValueNode *typeName = static_cast<ValueNode *>(nameNode.get());
-                            if (typeName->getStringValue() == domainName) {
-                                // FIXME We need to check the namespace of the domain!
-                                block->setRootScope(it->first);
-                                m_tree->addChild(block);
-                                fillDefaultPropertiesForNode(m_tree->getChildren().back());
-                                break;
-                            }
-                        }
-                    }
-                }
-            }
-        }
-    }
-    for (ASTNode relatedNode : domainStack) {
-        if (relatedNode->getNodeType() == AST::Declaration
-                || relatedNode->getNodeType() == AST::BundleDeclaration ) {
-            std::shared_ptr<DeclarationNode> block = static_pointer_cast<DeclarationNode>(relatedNode);
-            if (block) {
-                block->setDomainString(domainName);
-            }
-        } else if (relatedNode->getNodeType() == AST::Block
-                   || relatedNode->getNodeType() == AST::Bundle) {
-            std::shared_ptr<DeclarationNode> declaration = CodeValidator::findDeclaration(CodeValidator::streamMemberName(relatedNode, scopeStack, m_tree), scopeStack, m_tree);
-            if(declaration) {
-                declaration->setDomainString(domainName);
-            }
-        } else if (relatedNode->getNodeType() == AST::Function) {
-            std::shared_ptr<FunctionNode> func = static_pointer_cast<FunctionNode>(relatedNode);
-            if (func) {
-                func->setDomainString(domainName);
-            }
-        }  else if (relatedNode->getNodeType() == AST::List
-                    || relatedNode->getNodeType() == AST::Expression) {
-            for(ASTNode  member : relatedNode->getChildren()) {
-                if (member->getNodeType() == AST::Block) {
-                    string name = static_cast<BlockNode *>(member.get())->getName();
-                    std::shared_ptr<DeclarationNode> block =  CodeValidator::findDeclaration(QString::fromStdString(name), scopeStack, m_tree);
-                    if (block) {
-                        if (!block->getDomain() || block->getDomain()->getNodeType() == AST::None) {
-                            // Don't override expression member domains. Only set if domain is not there.
-                            block->setDomainString(domainName);
-                        }
-                    }
-                } else if (member->getNodeType() == AST::Bundle) {
-                    string name = static_cast<BundleNode *>(member.get())->getName();
-                    std::shared_ptr<DeclarationNode> block =  CodeValidator::findDeclaration(QString::fromStdString(name), scopeStack, m_tree);
-                    if (block) {
-                        if (!block->getDomain() || block->getDomain()->getNodeType() == AST::None) {
-                            // Don't override expression member domains. Only set if domain is not there.
-                            block->setDomainString(domainName);
-                        }
-                    }
-                } else if (member->getNodeType() == AST::Function) {
-                    std::shared_ptr<FunctionNode> func = static_pointer_cast<FunctionNode>(member);
-                    func->setDomainString(domainName);
-                }
-            }
+        for (string rootNamespace : builtinNamespaces(m_builtinDomains, domainName)) {
+            QVector<ASTNode> candidates = builtinCandidates(m_builtinDomains, domainName, rootNamespace, true);
+            // FIXME We need to check the namespace of the domain!
+            std::shared_ptr<DeclarationNode> block = static_pointer_cast<DeclarationNode>(candidates.front());
+            block->setRootScope(rootNamespace);
+            m_tree->addChild(block);
+            fillDefaultPropertiesForNode(m_tree->getChildren().back());
         }
     }
 }
@@ -2202,13 +2386,11 @@ void CodeResolver::processResetForNode(ASTNode thisScope, ASTNode streamScope, A
 void CodeResolver::propagateDomainsForNode(ASTNode node, QVector<ASTNode > scopeStack)
 {
     if (node->getNodeType() == AST::Stream) {
-        string contextDomain = getContextDomainName(scopeStack);
-        resolveDomainsForStream(static_pointer_cast<StreamNode>(node), scopeStack, QString::fromStdString(contextDomain));
+        inferStreamDomains(vector<ASTNode>{node}, scopeStack, getContextDomainName(scopeStack));
     } else if (node->getNodeType() == AST::Declaration) {
         std::shared_ptr<DeclarationNode> module = static_pointer_cast<DeclarationNode>(node);
         if (module->getObjectType() == "module" || module->getObjectType() == "reaction" || module->getObjectType() == "loop") {
             vector<ASTNode > streamsNode = getModuleStreams(module);
-            vector<ASTNode >::reverse_iterator streamIt = streamsNode.rbegin();
 
             vector<ASTNode > blocks = getModuleBlocks(module);
             ASTNode ports = module->getPropertyValue("ports");
@@ -2246,15 +2428,12 @@ void CodeResolver::propagateDomainsForNode(ASTNode node, QVector<ASTNode > scope
                                                                                                 scopeStack,
                                                                                                 m_tree);
 
-            while(streamIt != streamsNode.rend()) {
-                const ASTNode streamNode = *streamIt;
-                if (streamNode->getNodeType() == AST::Stream) {
-                    resolveDomainsForStream(static_pointer_cast<StreamNode>(streamNode), scopeStack, QString::fromStdString(contextDomainName));
-                } else {
+            for (const ASTNode streamNode : streamsNode) {
+                if (streamNode->getNodeType() != AST::Stream) {
                     qDebug() << "ERROR: Expecting stream.";
                 }
-                streamIt++;
             }
+            inferStreamDomains(streamsNode, scopeStack, contextDomainName);
 //            scopeStack << QVector<ASTNode>::fromStdVector(moduleBlocks);
             for (auto block: blocks) {
                 propagateDomainsForNode(block, scopeStack);
@@ -3064,3 +3243,233 @@ void CodeResolver::markConnectionForNode(ASTNode node, QVector<ASTNode > scopeSt
     }
 }
 
+
+std::vector<ASTNode> CodeResolver::findLiveStreams(std::vector<ASTNode> streams, std::set<string> &liveNames, QVector<ASTNode> scopeStack)
+{
+    // A stream is live if it has side effects or if it writes to a name read
+    // by a live stream. Iterate until no more streams are marked live.
+    std::vector<std::set<string>> writtenNames(streams.size());
+    std::vector<std::set<string>> referencedNames(streams.size());
+    std::vector<bool> live(streams.size(), false);
+    for (size_t i = 0; i < streams.size(); i++) {
+        collectWrittenNames(streams[i], writtenNames[i]);
+        collectReferencedNames(streams[i], referencedNames[i]);
+        if (nodeHasSideEffects(streams[i], scopeStack)) {
+            live[i] = true;
+            liveNames.insert(referencedNames[i].begin(), referencedNames[i].end());
+        }
+    }
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < streams.size(); i++) {
+            if (live[i]) {
+                continue;
+            }
+            for (string name: writtenNames[i]) {
+                if (liveNames.find(name) != liveNames.end()) {
+                    live[i] = true;
+                    liveNames.insert(referencedNames[i].begin(), referencedNames[i].end());
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+    std::vector<ASTNode> liveStreams;
+    for (size_t i = 0; i < streams.size(); i++) {
+        if (live[i]) {
+            liveStreams.push_back(streams[i]);
+        }
+    }
+    return liveStreams;
+}
+
+void CodeResolver::eliminateDeadModuleCode(std::shared_ptr<DeclarationNode> module)
+{
+    ASTNode blocks = module->getPropertyValue("blocks");
+    ASTNode ports = module->getPropertyValue("ports");
+    ASTNode streamsNode = module->getPropertyValue("streams");
+    if (!blocks || blocks->getNodeType() != AST::List
+            || !streamsNode || streamsNode->getNodeType() != AST::List) {
+        return;
+    }
+    QVector<ASTNode> moduleScope;
+    for (ASTNode block: blocks->getChildren()) {
+        moduleScope.push_back(block);
+    }
+    // Internal streams are live if they lead to an output port
+    std::set<string> liveNames;
+    std::set<string> portNames;
+    if (ports && ports->getNodeType() == AST::List) {
+        for (ASTNode port: ports->getChildren()) {
+            if (port->getNodeType() == AST::Declaration) {
+                std::shared_ptr<DeclarationNode> portDecl = static_pointer_cast<DeclarationNode>(port);
+                std::set<string> names;
+                collectReferencedNames(portDecl, names);
+                portNames.insert(names.begin(), names.end());
+                if (portDecl->getObjectType().find("Output") != string::npos) {
+                    liveNames.insert(names.begin(), names.end());
+                }
+            }
+        }
+    }
+    // Names used by internal reactions and loops are read as well
+    for (ASTNode block: blocks->getChildren()) {
+        if (block->getNodeType() == AST::Declaration) {
+            string type = static_pointer_cast<DeclarationNode>(block)->getObjectType();
+            if (type == "reaction" || type == "loop") {
+                collectReferencedNames(block, liveNames);
+            }
+        }
+    }
+    std::vector<ASTNode> liveStreams = findLiveStreams(getModuleStreams(module), liveNames, moduleScope);
+    streamsNode->setChildren(liveStreams);
+
+    // Remove internal signals that are no longer connected to anything
+    std::set<string> referencedNames = portNames;
+    for (ASTNode stream: liveStreams) {
+        collectReferencedNames(stream, referencedNames);
+    }
+    for (ASTNode block: blocks->getChildren()) {
+        if (block->getNodeType() != AST::Declaration) {
+            collectReferencedNames(block, referencedNames);
+            continue;
+        }
+        std::shared_ptr<DeclarationNode> decl = static_pointer_cast<DeclarationNode>(block);
+        string type = decl->getObjectType();
+        if (type != "signal" && type != "switch" && type != "trigger") {
+            collectReferencedNames(block, referencedNames);
+        }
+    }
+    std::vector<ASTNode> liveBlocks;
+    for (ASTNode block: blocks->getChildren()) {
+        if (block->getNodeType() == AST::Declaration) {
+            std::shared_ptr<DeclarationNode> decl = static_pointer_cast<DeclarationNode>(block);
+            string type = decl->getObjectType();
+            if ((type == "signal" || type == "switch" || type == "trigger")
+                    && referencedNames.find(decl->getName()) == referencedNames.end()) {
+                continue;
+            }
+        }
+        liveBlocks.push_back(block);
+    }
+    blocks->setChildren(liveBlocks);
+}
+
+bool CodeResolver::nodeHasSideEffects(ASTNode node, QVector<ASTNode> scopeStack)
+{
+    if (node->getNodeType() == AST::Function) {
+        std::shared_ptr<FunctionNode> func = static_pointer_cast<FunctionNode>(node);
+        std::shared_ptr<DeclarationNode> decl = CodeValidator::findDeclaration(QString::fromStdString(func->getName()), scopeStack, m_tree);
+        if (!decl || decl->getObjectType() != "module") {
+            return true; // Reactions, loops and platform modules are always kept
+        }
+        auto cached = m_moduleSideEffects.find(decl->getName());
+        if (cached == m_moduleSideEffects.end()) {
+            m_moduleSideEffects[decl->getName()] = false; // Guard against recursion
+            QVector<ASTNode> moduleScope;
+            ASTNode blocks = decl->getPropertyValue("blocks");
+            if (blocks) {
+                for (ASTNode block: blocks->getChildren()) {
+                    moduleScope.push_back(block);
+                }
+            }
+            bool sideEffects = false;
+            for (ASTNode stream: getModuleStreams(decl)) {
+                if (nodeHasSideEffects(stream, moduleScope)) {
+                    sideEffects = true;
+                    break;
+                }
+            }
+            m_moduleSideEffects[decl->getName()] = sideEffects;
+            if (sideEffects) {
+                return true;
+            }
+        } else if (cached->second) {
+            return true;
+        }
+    } else if (node->getNodeType() == AST::Block || node->getNodeType() == AST::Bundle) {
+        string name;
+        if (node->getNodeType() == AST::Block) {
+            name = static_pointer_cast<BlockNode>(node)->getName();
+        } else {
+            name = static_pointer_cast<BundleNode>(node)->getName();
+        }
+        std::shared_ptr<DeclarationNode> decl = CodeValidator::findDeclaration(QString::fromStdString(name), scopeStack, m_tree);
+        if (!decl) {
+            return true;
+        }
+        QList<LangError> errors;
+        std::shared_ptr<DeclarationNode> typeDecl = CodeValidator::findTypeDeclarationByName(decl->getObjectType(), scopeStack, m_tree, errors);
+        // Platform types that consume data without producing any are sinks
+        // (hardware outputs, OSC and serial out, printing)
+        if (typeDecl && typeDecl->getObjectType() == "platformType"
+                && typeDecl->getPropertyValue("inputs")
+                && !typeDecl->getPropertyValue("outputs")) {
+            return true;
+        }
+    }
+    for (ASTNode child: node->getChildren()) {
+        if (nodeHasSideEffects(child, scopeStack)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void CodeResolver::collectWrittenNames(ASTNode stream, std::set<string> &names)
+{
+    // Every member after the first one receives data from the stream
+    ASTNode member = stream;
+    bool first = true;
+    while (member) {
+        ASTNode current = member;
+        member = nullptr;
+        if (current->getNodeType() == AST::Stream) {
+            member = static_pointer_cast<StreamNode>(current)->getRight();
+            current = static_pointer_cast<StreamNode>(current)->getLeft();
+        }
+        if (!first) {
+            collectWrittenMemberNames(current, names);
+        }
+        first = false;
+    }
+}
+
+void CodeResolver::collectWrittenMemberNames(ASTNode member, std::set<string> &names)
+{
+    if (member->getNodeType() == AST::Block) {
+        names.insert(static_pointer_cast<BlockNode>(member)->getName());
+    } else if (member->getNodeType() == AST::Bundle) {
+        // The index takes part in the write, so its names count as well
+        collectReferencedNames(member, names);
+    } else if (member->getNodeType() == AST::PortProperty) {
+        names.insert(static_pointer_cast<PortPropertyNode>(member)->getPortName());
+    } else if (member->getNodeType() == AST::List) {
+        for (ASTNode element: member->getChildren()) {
+            collectWrittenMemberNames(element, names);
+        }
+    }
+}
+
+void CodeResolver::collectReferencedNames(ASTNode node, std::set<string> &names)
+{
+    if (node->getNodeType() == AST::Block) {
+        names.insert(static_pointer_cast<BlockNode>(node)->getName());
+    } else if (node->getNodeType() == AST::Bundle) {
+        names.insert(static_pointer_cast<BundleNode>(node)->getName());
+    } else if (node->getNodeType() == AST::Function) {
+        names.insert(static_pointer_cast<FunctionNode>(node)->getName());
+    } else if (node->getNodeType() == AST::PortProperty) {
+        names.insert(static_pointer_cast<PortPropertyNode>(node)->getPortName());
+    } else if (node->getNodeType() == AST::String) {
+        // Some properties (e.g. domains) refer to declarations by name
+        names.insert(static_pointer_cast<ValueNode>(node)->getStringValue());
+    } else if (node->getNodeType() == AST::Declaration || node->getNodeType() == AST::BundleDeclaration) {
+        names.insert(static_pointer_cast<DeclarationNode>(node)->getObjectType());
+    }
+    for (ASTNode child: node->getChildren()) {
+        collectReferencedNames(child, names);
+    }
+}
@@ -36,6 +36,8 @@
 #define CODERESOLVER_H
 
 
+#include <set>
+
 #include <QVector>
 #include <QSharedPointer>
 
@@ -51,6 +53,7 @@
 #include "rangenode.h"
 #include "valuenode.h"
 #include "systemconfiguration.hpp"
+#include "streamgraph.h"
 
 class CodeResolver
 {
@@ -60,6 +63,7 @@ public:
     ~CodeResolver();
 
     void preProcess();
+    void eliminateDeadCode();
 
 private:
     // Main processing functions
@@ -76,20 +80,62 @@ private:
     void analyzeConnections();
 
     // Sub functions
-    void resolveStreamRatesReverse(std::shared_ptr<StreamNode> stream);
-    void resolveStreamRates(std::shared_ptr<StreamNode> stream);
+    // Rate of a stream member. Blocks and bundles keep their rate in their
+    // declaration and functions in the node, so each of these is one cell
+    // shared by every member that refers to it. Lists and expressions
+    // combine the rates of their elements.
+    struct RateCell {
+        std::shared_ptr<DeclarationNode> declaration;
+        std::shared_ptr<FunctionNode> function;
+        double rate {-1};
+        bool writable {false};
+        bool changed {false};
+    };
+    struct RateTerm {
+        int cell {-1};
+        bool aggregate {false};
+        std::vector<RateTerm> elements;
+    };
+    RateTerm makeRateTerm(ASTNode node, std::vector<RateCell> &cells, std::map<void *, int> &cellIndex);
+    double getTermRate(const RateTerm &term, const std::vector<RateCell> &cells);
+    void setTermRate(const RateTerm &term, double rate, std::vector<RateCell> &cells, std::vector<int> &changedCells);
+    void collectTermCells(const RateTerm &term, std::vector<int> &termCells);
     void expandParallelStream(std::shared_ptr<StreamNode> stream, QVector<ASTNode> scopeStack, ASTNode tree);
 
     void expandStreamToSizes(std::shared_ptr<StreamNode> stream, QVector<int> &size, int previousOutSize, QVector<ASTNode > scopeStack);
     ASTNode expandFunctionFromProperties(std::shared_ptr<FunctionNode> func, QVector<ASTNode > scope, ASTNode tree);
     void fillDefaultPropertiesForNode(ASTNode node);
 
-    void insertDependentTypes(string typeName, map<string, vector<ASTNode>> &objects);
-    void insertBuiltinObjectsForNode(ASTNode node, map<string, vector<ASTNode> > &objects);
-
-    void resolveDomainsForStream(std::shared_ptr<StreamNode> func, QVector<ASTNode > scopeStack, QString contextDomain = "");
-    string processDomainsForNode(ASTNode node, QVector<ASTNode > scopeStack, QList<ASTNode > &domainStack);
-    void setDomainForStack(QList<ASTNode > domainStack, string domainName,  QVector<ASTNode > scopeStack);
+    // Library objects indexed by the name they are looked up with. Candidates
+    // keep the order of the library namespaces, and objects that have been
+    // moved into the tree are marked as inserted rather than erased.
+    struct BuiltinObject {
+        string rootNamespace;
+        std::shared_ptr<DeclarationNode> declaration;
+    };
+    typedef map<string, vector<BuiltinObject>> BuiltinIndex;
+    void indexBuiltinObjects(const map<string, vector<ASTNode>> &objects);
+    vector<string> builtinNamespaces(const BuiltinIndex &index, string key);
+    QVector<ASTNode> builtinCandidates(const BuiltinIndex &index, string key, string rootNamespace, bool includeInserted = false);
+    void insertDependentTypes(string typeName);
+    void insertBuiltinObjectsForNode(ASTNode node);
+
+    // Domain inference. Declarations, functions and stream positions that
+    // can have a domain are elements. An element without a domain of its own
+    // is linked to the element it takes its domain from, so the domain of
+    // every element is the domain of the root of its set.
+    struct DomainElement {
+        std::shared_ptr<DeclarationNode> declaration;
+        std::shared_ptr<FunctionNode> function;
+        string domain;
+        bool fixed {false};
+        int parent {-1};
+    };
+    void inferStreamDomains(vector<ASTNode> streams, QVector<ASTNode> scopeStack, string contextDomain);
+    int domainElementForNode(ASTNode node, QVector<ASTNode> scopeStack, vector<DomainElement> &elements, map<void *, int> &elementIndex);
+    int findDomainRoot(vector<DomainElement> &elements, int element);
+    void linkDomainElement(vector<DomainElement> &elements, int element, int target);
+    void insertDomainDeclaration(string domainName);
     std::shared_ptr<DeclarationNode> createDomainDeclaration(QString name);
     std::shared_ptr<DeclarationNode> createSignalDeclaration(QString name, int size, QVector<ASTNode> &scope);
     std::vector<ASTNode> declareUnknownName(std::shared_ptr<BlockNode> block, int size, QVector<ASTNode> localScope, ASTNode tree);
@@ -121,6 +167,13 @@ private:
     void checkStreamConnections(std::shared_ptr<StreamNode> stream, QVector<ASTNode > scopeStack, bool start = true);
     void markConnectionForNode(ASTNode node, QVector<ASTNode > scopeStack, bool start);
 
+    std::vector<ASTNode> findLiveStreams(std::vector<ASTNode> streams, std::set<string> &liveNames, QVector<ASTNode> scopeStack);
+    void eliminateDeadModuleCode(std::shared_ptr<DeclarationNode> module);
+    bool nodeHasSideEffects(ASTNode node, QVector<ASTNode> scopeStack);
+    void collectReferencedNames(ASTNode node, std::set<string> &names);
+    void collectWrittenNames(ASTNode stream, std::set<string> &names);
+    void collectWrittenMemberNames(ASTNode member, std::set<string> &names);
+
     // Operators
     std::shared_ptr<ValueNode>  multiply(std::shared_ptr<ValueNode>  left, std::shared_ptr<ValueNode>  right);
     std::shared_ptr<ValueNode>  divide(std::shared_ptr<ValueNode>  left, std::shared_ptr<ValueNode>  right);
@@ -148,6 +201,13 @@ private:
     ASTNode m_tree;
     int m_connectorCounter;
     std::vector<std::vector<string>> m_bridgeAliases; //< 1: bridge signal 2: original name 3: domain
+    std::map<string, bool> m_moduleSideEffects; //< Cache for nodeHasSideEffects() by module name
+    bool m_builtinsIndexed {false};
+    BuiltinIndex m_builtinsByName; //< Library declarations by declaration name
+    BuiltinIndex m_builtinTypes; //< Library type declarations by typeName
+    BuiltinIndex m_builtinDomains; //< Library _domainDefinition declarations by domainName
+    std::set<ASTNode> m_insertedBuiltins; //< Library objects already moved into the tree
+    std::set<string> m_resolvedTypes; //< Types whose dependencies have been inserted
 };
 
 #endif // CODERESOLVER_H
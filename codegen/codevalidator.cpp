@@ -32,13 +32,18 @@
     Authors: Andres Cabrera and Joseph Tilbian
 */
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
+#include <thread>
 
 #include <QVector>
 #include <QDebug>
 
 #include "codevalidator.h"
 #include "coderesolver.h"
+#include "typeregistry.h"
+#include "analysiscache.h"
 
 CodeValidator::CodeValidator(QString striderootDir, ASTNode tree, Options options,
                              SystemConfiguration systemConfig):
@@ -361,6 +366,15 @@ double CodeValidator::getDefaultForTypeAsDouble(string type, string port, QVecto
 
 ASTNode CodeValidator::getDefaultPortValueForType(string type, string portName, QVector<ASTNode > scope, ASTNode tree)
 {
+    if (canUseTypeRegistry(scope, tree)) {
+        for (ASTNode port : TypeRegistry::forTree(tree)->getPortsNamed(type, portName)) {
+            ASTNode platPortDefault = static_cast<DeclarationNode *>(port.get())->getPropertyValue("default");
+            if (platPortDefault) {
+                return platPortDefault;
+            }
+        }
+        return nullptr;
+    }
     QVector<ASTNode > ports = CodeValidator::getPortsForType(type, scope, tree);
     if (!ports.isEmpty()) {
         for (ASTNode port : ports) {
@@ -396,15 +410,36 @@ bool CodeValidator::scopesMatch(QStringList scopeList, ASTNode node)
 
 bool CodeValidator::nodeInScope(std::vector<string> scopeList, ASTNode node)
 {
-    if (node->getNamespaceList().size() == 0) {
+    if (node->getScopeLevels() == 0) {
         return true;
     }
-    if (scopeList.size() != node->getScopeLevels()) {
+    return scopeList == node->getNamespaceList();
+}
+
+bool CodeValidator::canUseTypeRegistry(const QVector<ASTNode> &scope, ASTNode tree)
+{
+    // Types declared in the scope hide the tree's types, so they are looked
+    // up without the registry.
+    if (!tree) {
         return false;
     }
-    for(size_t i = 0; i < node->getScopeLevels(); i++) {
-        if (scopeList.at(i) != node->getScopeAt(i)) {
-            return false;
+    for (ASTNode scopeNode : scope) {
+        if (!scopeNode) {
+            continue;
+        }
+        vector<ASTNode> members;
+        if (scopeNode->getNodeType() == AST::List) {
+            members = scopeNode->getChildren();
+        } else {
+            members.push_back(scopeNode);
+        }
+        for (ASTNode node : members) {
+            if (node->getNodeType() == AST::Declaration) {
+                string objectType = static_cast<DeclarationNode *>(node.get())->getObjectType();
+                if (objectType == "type" || objectType == "platformType") {
+                    return false;
+                }
+            }
         }
     }
     return true;
@@ -425,15 +460,7 @@ vector<StreamNode *> CodeValidator::getStreamsAtLine(ASTNode tree, int line)
 
 bool CodeValidator::scopesMatch(ASTNode node1, ASTNode node2)
 {
-    if (node1->getScopeLevels() != node2->getScopeLevels()) {
-        return false;
-    }
-    for(size_t i = 0; i < node1->getScopeLevels(); i++) {
-        if (node1->getScopeAt(i) != node2->getScopeAt(i)) {
-            return false;
-        }
-    }
-    return true;
+    return node1->getNamespaceId() == node2->getNamespaceId();
 }
 
 QList<LangError> CodeValidator::getErrors()
@@ -461,37 +488,115 @@ void CodeValidator::validate()
         CodeResolver resolver(m_system, m_tree, m_systemConfig);
         resolver.preProcess();
         validatePlatform(m_tree, QVector<ASTNode >());
-        validateTypes(m_tree, QVector<ASTNode >());
-        validateBundleIndeces(m_tree, QVector<ASTNode >());
-        validateBundleSizes(m_tree, QVector<ASTNode >());
-        validateSymbolUniqueness(QVector<ASTNode>::fromStdVector(m_tree->getChildren()));
-        validateListTypeConsistency(m_tree, QVector<ASTNode >());
-        validateStreamSizes(m_tree, QVector<ASTNode >());
-        validateRates(m_tree);
+        validateTopLevelNodes();
 
 //         TODO: validate expression type consistency
 //         TODO: validate expression list operations
 
+        // Dead code is only removed once the whole tree has been validated so
+        // errors are still reported for unused streams
+        if ((m_options & ELIMINATE_DEAD_CODE) && m_errors.isEmpty()) {
+            resolver.eliminateDeadCode();
+        }
 
     }
     sortErrors();
 }
 
-void CodeValidator::validateTypes(ASTNode node, QVector<ASTNode > scopeStack, vector<string> parentNamespace)
+void CodeValidator::validateTopLevelNodes()
+{
+    // The checks only read the resolved tree, so they are run for each top
+    // level node separately, several nodes at a time. Every check of every
+    // node gets its own error list and the lists are joined in the order the
+    // checks would have produced them running over the whole tree.
+    enum { Types, BundleIndeces, BundleSizes, SymbolUniqueness, ListTypeConsistency, StreamSizes, Rates, PassCount };
+    vector<ASTNode> children = m_tree->getChildren();
+    QVector<ASTNode> topScope = QVector<ASTNode>::fromStdVector(children);
+    // Bundle index validation sees the blocks of all previous siblings
+    vector<QVector<ASTNode>> indexScopes;
+    QVector<ASTNode> indexScope;
+    for (ASTNode child: children) {
+        indexScope << getBlocksInScope(child, indexScope, m_tree);
+        indexScopes.push_back(indexScope);
+    }
+
+    size_t jobCount = children.size() * PassCount;
+    vector<QList<LangError>> jobErrors(jobCount);
+    auto runJob = [&](size_t job) {
+        size_t index = job % children.size();
+        ASTNode node = children[index];
+        QList<LangError> &errors = jobErrors[job];
+        switch (job / children.size()) {
+        case Types:
+            validateTypes(node, QVector<ASTNode>(), errors);
+            break;
+        case BundleIndeces:
+            validateBundleIndeces(node, indexScopes[index], errors);
+            break;
+        case BundleSizes:
+            validateBundleSizes(node, topScope, errors);
+            break;
+        case SymbolUniqueness:
+            validateSymbolUniqueness(node, topScope, index + 1, errors);
+            break;
+        case ListTypeConsistency:
+            validateListTypeConsistency(node, topScope, errors);
+            break;
+        case StreamSizes:
+            validateStreamSizes(node, QVector<ASTNode>(), errors);
+            break;
+        case Rates:
+            if ((m_options & NO_RATE_VALIDATION) == 0) {
+                validateNodeRate(node, m_tree, errors);
+            }
+            break;
+        }
+    };
+
+    size_t threadCount = 1;
+    if ((m_options & SERIAL_VALIDATION) == 0) {
+        threadCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()),
+                                       (children.size() + 15) / 16);
+    }
+    if (threadCount <= 1) {
+        for (size_t job = 0; job < jobCount; job++) {
+            runJob(job);
+        }
+    } else {
+        std::atomic<size_t> nextJob(0);
+        vector<std::thread> threads;
+        for (size_t i = 0; i < threadCount; i++) {
+            threads.push_back(std::thread([&]() {
+                size_t job;
+                while ((job = nextJob++) < jobCount) {
+                    runJob(job);
+                }
+            }));
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+    }
+    for (const QList<LangError> &errors : jobErrors) {
+        m_errors << errors;
+    }
+}
+
+void CodeValidator::validateTypes(ASTNode node, QVector<ASTNode > scopeStack, QList<LangError> &errors, vector<string> parentNamespace)
 {
     if (node->getNodeType() == AST::BundleDeclaration
             || node->getNodeType() == AST::Declaration) {
         std::shared_ptr<DeclarationNode> block = static_pointer_cast<DeclarationNode>(node);
         QString blockType = QString::fromStdString(block->getObjectType());
-        QList<LangError> errors;
-        std::shared_ptr<DeclarationNode> declaration = CodeValidator::findTypeDeclaration(block.get(), scopeStack, m_tree, errors);
+        QList<LangError> typeErrors;
+        std::shared_ptr<DeclarationNode> declaration = CodeValidator::findTypeDeclaration(block.get(), scopeStack, m_tree, typeErrors);
         if (!declaration) { // Check if node type exists
             LangError error; // Not a valid type, then error
             error.type = LangError::UnknownType;
             error.lineNumber = block->getLine();
             error.errorTokens.push_back(block->getObjectType());
             error.filename = block->getFilename();
-            m_errors << error;
+            errors << error;
         } else {
             // Validate port names and types
             vector<std::shared_ptr<PropertyNode>> ports = block->getProperties();
@@ -507,7 +612,7 @@ void CodeValidator::validateTypes(ASTNode node, QVector<ASTNode > scopeStack, ve
                         error.errorTokens.push_back(blockType.toStdString());
                         error.errorTokens.push_back(portName.toStdString());
                         error.filename = port->getFilename();
-                        m_errors << error;
+                        errors << error;
                     } else {
                         // Then check type passed to port is valid
                         bool typeIsValid = false;
@@ -525,8 +630,8 @@ void CodeValidator::validateTypes(ASTNode node, QVector<ASTNode > scopeStack, ve
                                             break;
                                         }
                                     } else if (portValue->getNodeType() == AST::Block) {
-                                        QList<LangError> errors;
-                                        std::string validTypeName = CodeValidator::evaluateConstString(portValue, scopeStack, m_tree, errors);
+                                        QList<LangError> stringErrors;
+                                        std::string validTypeName = CodeValidator::evaluateConstString(portValue, scopeStack, m_tree, stringErrors);
                                         if (validTypeName == typeCode) {
                                             typeIsValid = true;
                                             break;
@@ -561,7 +666,7 @@ void CodeValidator::validateTypes(ASTNode node, QVector<ASTNode > scopeStack, ve
                                 error.errorTokens.push_back(typeName.toStdString());
                                 error.errorTokens.push_back(validTypeNames.join(",").toStdString());
                                 error.filename = port->getFilename();
-                                m_errors << error;
+                                errors << error;
                             }
                         }
                     }
@@ -579,11 +684,11 @@ void CodeValidator::validateTypes(ASTNode node, QVector<ASTNode > scopeStack, ve
         }
         // For BundleDeclarations in particular, we need to ignore the bundle when declaring types. The inner bundle has no scope set, and trying to find it will fail if the declaration is scoped....
         foreach(auto property, block->getProperties()) {
-            validateTypes(property->getValue(), scopeStack, block->getNamespaceList());
+            validateTypes(property->getValue(), scopeStack, errors, block->getNamespaceList());
         }
         return;
     } else if (node->getNodeType() == AST::Stream) {
-        validateStreamMembers(static_cast<StreamNode *>(node.get()), scopeStack);
+        validateStreamMembers(static_cast<StreamNode *>(node.get()), scopeStack, errors);
         return; // Children are validated when validating stream
     } else if (node->getNodeType() == AST::List) {
          // Children are checked automatically below
@@ -610,7 +715,7 @@ void CodeValidator::validateTypes(ASTNode node, QVector<ASTNode > scopeStack, ve
             }
             blockName += block->getName();
             error.errorTokens.push_back(blockName);
-            m_errors << error;
+            errors << error;
         }
 
     } else if (node->getNodeType() == AST::Bundle) {
@@ -636,7 +741,7 @@ void CodeValidator::validateTypes(ASTNode node, QVector<ASTNode > scopeStack, ve
             }
             bundleName += bundle->getName();
             error.errorTokens.push_back(bundleName);
-            m_errors << error;
+            errors << error;
         }
     } else if (node->getNodeType() == AST::Function) {
         FunctionNode *func = static_cast<FunctionNode *>(node.get());
@@ -659,7 +764,7 @@ void CodeValidator::validateTypes(ASTNode node, QVector<ASTNode > scopeStack, ve
             }
             funcName += func->getName();
             error.errorTokens.push_back(funcName);
-            m_errors << error;
+            errors << error;
         } else {
             for (std::shared_ptr<PropertyNode> property : func->getProperties()) {
                 string propertyName = property->getName();
@@ -672,25 +777,25 @@ void CodeValidator::validateTypes(ASTNode node, QVector<ASTNode > scopeStack, ve
                     error.errorTokens.push_back(func->getName());
                     error.errorTokens.push_back(propertyName);
                     error.filename = func->getFilename();
-                    m_errors << error;
+                    errors << error;
                 }
             }
         }
     }
 
     foreach(ASTNode childNode, node->getChildren()) {
-        validateTypes(childNode, scopeStack);
+        validateTypes(childNode, scopeStack, errors);
     }
 }
 
-void CodeValidator::validateStreamMembers(StreamNode *stream, QVector<ASTNode > scopeStack)
+void CodeValidator::validateStreamMembers(StreamNode *stream, QVector<ASTNode > scopeStack, QList<LangError> &errors)
 {
     ASTNode member = stream->getLeft();
     QString name;
     while (member) {
-        validateTypes(member, scopeStack);
+        validateTypes(member, scopeStack, errors);
         if (stream && stream->getRight()->getNodeType() == AST::Stream) {
-            validateStreamMembers(static_cast<StreamNode *>(stream->getRight().get()), scopeStack);
+            validateStreamMembers(static_cast<StreamNode *>(stream->getRight().get()), scopeStack, errors);
             return;
         } else {
             if (stream) {
@@ -703,7 +808,7 @@ void CodeValidator::validateStreamMembers(StreamNode *stream, QVector<ASTNode >
     }
 }
 
-void CodeValidator::validateBundleIndeces(ASTNode node, QVector<ASTNode > scope)
+void CodeValidator::validateBundleIndeces(ASTNode node, QVector<ASTNode > scope, QList<LangError> &errors)
 {
     if (node->getNodeType() == AST::Bundle) {
         BundleNode *bundle = static_cast<BundleNode *>(node.get());
@@ -714,24 +819,24 @@ void CodeValidator::validateBundleIndeces(ASTNode node, QVector<ASTNode > scope)
             error.lineNumber = bundle->getLine();
             error.errorTokens.push_back(bundle->getName());
             error.errorTokens.push_back(getPortTypeName(type).toStdString());
-            m_errors << error;
+            errors << error;
         }
     }
     for(ASTNode child: node->getChildren()) {
         QVector<ASTNode > subScope = getBlocksInScope(child, scope, m_tree);
         scope << subScope;
-        validateBundleIndeces(child, scope);
+        validateBundleIndeces(child, scope, errors);
     }
 }
 
-void CodeValidator::validateBundleSizes(ASTNode node, QVector<ASTNode > scope)
+void CodeValidator::validateBundleSizes(ASTNode node, QVector<ASTNode > scope, QList<LangError> &errors)
 {
     if (node->getNodeType() == AST::BundleDeclaration) {
-        QList<LangError> errors;
+        QList<LangError> sizeErrors;
         std::shared_ptr<DeclarationNode> block = static_pointer_cast<DeclarationNode>(node);
         // FIXME this needs to be rewritten looking at the port block size
-        int size = getBlockDeclaredSize(block, scope, m_tree, errors);
-        int datasize = getBlockDataSize(block, scope, errors);
+        int size = getBlockDeclaredSize(block, scope, m_tree, sizeErrors);
+        int datasize = getBlockDataSize(block, scope, sizeErrors);
         if(size != datasize && datasize > 1) {
             LangError error;
             error.type = LangError::BundleSizeMismatch;
@@ -739,60 +844,65 @@ void CodeValidator::validateBundleSizes(ASTNode node, QVector<ASTNode > scope)
             error.errorTokens.push_back(block->getBundle()->getName());
             error.errorTokens.push_back(QString::number(size).toStdString());
             error.errorTokens.push_back(QString::number(datasize).toStdString());
-            m_errors << error;
+            errors << error;
         }
 
         // TODO : use this pass to store the computed value of constant int?
-        m_errors << errors;
+        errors << sizeErrors;
     }
 
     QVector<ASTNode > children = QVector<ASTNode >::fromStdVector(node->getChildren());
     foreach(ASTNode node, children) {
-        validateBundleSizes(node, children);
+        validateBundleSizes(node, children, errors);
     }
 }
 
-void CodeValidator::validateSymbolUniqueness(QVector<ASTNode > scope)
+void CodeValidator::validateSymbolUniqueness(QVector<ASTNode > scope, QList<LangError> &errors)
 {
-    while (!scope.isEmpty()) {
-        auto node = scope.takeFirst();
-        for(ASTNode sibling: scope) {
-            QString nodeName, siblingName;
-            if (sibling->getNodeType() == AST::Declaration
-                    || sibling->getNodeType() == AST::BundleDeclaration) {
-                siblingName = QString::fromStdString(static_cast<DeclarationNode *>(sibling.get())->getName());
-            }
-            if (node->getNodeType() == AST::Declaration
-                    || node->getNodeType() == AST::BundleDeclaration) {
-                nodeName = QString::fromStdString(static_cast<DeclarationNode *>(node.get())->getName());
-            }
-            if (!nodeName.isEmpty() && !siblingName.isEmpty() && nodeName == siblingName) {
-                if (CodeValidator::scopesMatch(node, sibling)) {
-                    LangError error;
-                    error.type = LangError::DuplicateSymbol;
-                    error.lineNumber = sibling->getLine();
-                    error.filename = sibling->getFilename();
-                    error.errorTokens.push_back(nodeName.toStdString());
-                    error.errorTokens.push_back(node->getFilename());
-                    error.errorTokens.push_back(std::to_string(node->getLine()));
-                    m_errors << error;
-                }
-            }
+    for (int i = 0; i < scope.size(); i++) {
+        validateSymbolUniqueness(scope.at(i), scope, i + 1, errors);
+    }
+}
+
+void CodeValidator::validateSymbolUniqueness(ASTNode node, const QVector<ASTNode> &scope, int firstSibling, QList<LangError> &errors)
+{
+    for (int i = firstSibling; i < scope.size(); i++) {
+        ASTNode sibling = scope.at(i);
+        QString nodeName, siblingName;
+        if (sibling->getNodeType() == AST::Declaration
+                || sibling->getNodeType() == AST::BundleDeclaration) {
+            siblingName = QString::fromStdString(static_cast<DeclarationNode *>(sibling.get())->getName());
         }
-        if (node->getNodeType() == AST::Declaration) {
-            auto decl = std::static_pointer_cast<DeclarationNode>(node);
-            if (decl->getObjectType() == "module" || decl->getObjectType() == "reaction" ||decl->getObjectType() == "loop") {
-                auto blocks = decl->getPropertyValue("blocks");
-                auto ports = decl->getPropertyValue("ports");
-                QVector<ASTNode> scope;
-                scope << QVector<ASTNode >::fromStdVector(blocks->getChildren()) << QVector<ASTNode >::fromStdVector(ports->getChildren());
-                validateSymbolUniqueness(scope);
+        if (node->getNodeType() == AST::Declaration
+                || node->getNodeType() == AST::BundleDeclaration) {
+            nodeName = QString::fromStdString(static_cast<DeclarationNode *>(node.get())->getName());
+        }
+        if (!nodeName.isEmpty() && !siblingName.isEmpty() && nodeName == siblingName) {
+            if (CodeValidator::scopesMatch(node, sibling)) {
+                LangError error;
+                error.type = LangError::DuplicateSymbol;
+                error.lineNumber = sibling->getLine();
+                error.filename = sibling->getFilename();
+                error.errorTokens.push_back(nodeName.toStdString());
+                error.errorTokens.push_back(node->getFilename());
+                error.errorTokens.push_back(std::to_string(node->getLine()));
+                errors << error;
             }
         }
     }
+    if (node->getNodeType() == AST::Declaration) {
+        auto decl = std::static_pointer_cast<DeclarationNode>(node);
+        if (decl->getObjectType() == "module" || decl->getObjectType() == "reaction" ||decl->getObjectType() == "loop") {
+            auto blocks = decl->getPropertyValue("blocks");
+            auto ports = decl->getPropertyValue("ports");
+            QVector<ASTNode> scope;
+            scope << QVector<ASTNode >::fromStdVector(blocks->getChildren()) << QVector<ASTNode >::fromStdVector(ports->getChildren());
+            validateSymbolUniqueness(scope, errors);
+        }
+    }
 }
 
-void CodeValidator::validateListTypeConsistency(ASTNode node, QVector<ASTNode > scope)
+void CodeValidator::validateListTypeConsistency(ASTNode node, QVector<ASTNode > scope, QList<LangError> &errors)
 {
     // Lists don't have to be consistent.
 //    if (node->getNodeType() == AST::List) {
@@ -803,54 +913,43 @@ void CodeValidator::validateListTypeConsistency(ASTNode node, QVector<ASTNode >
 //            error.lineNumber = node->getLine();
 //            // TODO: provide more information on inconsistent list
 ////            error.errorTokens <<
-//            m_errors << error;
+//            errors << error;
 //        }
 //    }
 
 //    QVector<ASTNode > children = QVector<ASTNode >::fromStdVector(node->getChildren());
 //    foreach(ASTNode node, children) {
-//        validateListTypeConsistency(node, children);
+//        validateListTypeConsistency(node, children, errors);
 //    }
 }
 
-void CodeValidator::validateStreamSizes(ASTNode tree, QVector<ASTNode > scope)
+void CodeValidator::validateStreamSizes(ASTNode node, QVector<ASTNode > scope, QList<LangError> &errors)
 {
-    for(ASTNode node: tree->getChildren()) {
-        if(node->getNodeType() == AST::Stream) {
-            StreamNode *stream = static_cast<StreamNode *>(node.get());
-            validateStreamInputSize(stream, scope, m_errors);
-        } else if (node->getNodeType() == AST::Declaration) {
-            DeclarationNode *decl = static_cast<DeclarationNode *>(node.get());
-            if (decl) {
-                if (decl->getObjectType() == "module"
-                        || decl->getObjectType() == "reaction"
-                        || decl->getObjectType() == "loop") {
-                    QVector<ASTNode > scope = QVector<ASTNode>::fromStdVector(decl->getPropertyValue("blocks")->getChildren());
-                    auto streams = decl->getPropertyValue("streams")->getChildren();
-                    for (auto node: streams) {
-                        if (node->getNodeType() == AST::Stream) {
-                            auto stream = std::static_pointer_cast<StreamNode>(node);
-                            validateStreamInputSize(stream.get(), scope, m_errors);
-                        }
+    if(node->getNodeType() == AST::Stream) {
+        StreamNode *stream = static_cast<StreamNode *>(node.get());
+        validateStreamInputSize(stream, scope, errors);
+    } else if (node->getNodeType() == AST::Declaration) {
+        DeclarationNode *decl = static_cast<DeclarationNode *>(node.get());
+        if (decl) {
+            if (decl->getObjectType() == "module"
+                    || decl->getObjectType() == "reaction"
+                    || decl->getObjectType() == "loop") {
+                QVector<ASTNode > scope = QVector<ASTNode>::fromStdVector(decl->getPropertyValue("blocks")->getChildren());
+                auto streams = decl->getPropertyValue("streams")->getChildren();
+                for (auto node: streams) {
+                    if (node->getNodeType() == AST::Stream) {
+                        auto stream = std::static_pointer_cast<StreamNode>(node);
+                        validateStreamInputSize(stream.get(), scope, errors);
                     }
-
-                    // FIXME we need to validate streams recursively within modules and reactions
                 }
-            }
-        }
-    }
-}
 
-void CodeValidator::validateRates(ASTNode tree)
-{
-    if ((m_options & NO_RATE_VALIDATION) == 0) {
-        for(ASTNode node: tree->getChildren()) {
-            validateNodeRate(node, tree);
+                // FIXME we need to validate streams recursively within modules and reactions
+            }
         }
     }
 }
 
-void CodeValidator::validateNodeRate(ASTNode node, ASTNode tree)
+void CodeValidator::validateNodeRate(ASTNode node, ASTNode tree, QList<LangError> &errors)
 {
     if(node->getNodeType() == AST::Declaration
             || node->getNodeType() == AST::BundleDeclaration) {
@@ -862,20 +961,20 @@ void CodeValidator::validateNodeRate(ASTNode node, ASTNode tree)
 //                error.lineNumber = node->getLine();
 //                error.filename = node->getFilename();
 //                error.errorTokens.push_back(decl->getName());
-//                m_errors << error;
+//                errors << error;
 //            }
         }
     } else if(node->getNodeType() == AST::Stream) {
         StreamNode *stream = static_cast<StreamNode *>(node.get());
-        validateNodeRate(stream->getLeft(), tree);
-        validateNodeRate(stream->getRight(), tree);
+        validateNodeRate(stream->getLeft(), tree, errors);
+        validateNodeRate(stream->getRight(), tree, errors);
     } else if(node->getNodeType() == AST::Expression) {
         for(ASTNode child: node->getChildren()) {
-            validateNodeRate(child, tree);
+            validateNodeRate(child, tree, errors);
         }
     } else if(node->getNodeType() == AST::Function) {
         for(std::shared_ptr<PropertyNode> prop: static_cast<FunctionNode *>(node.get())->getProperties()) {
-            validateNodeRate(prop->getValue(), tree);
+            validateNodeRate(prop->getValue(), tree, errors);
         }
     }
     // TODO also need to validate rates within module and reaction streams
@@ -888,7 +987,7 @@ bool errorLineIsLower(const LangError &err1, const LangError &err2)
 
 void CodeValidator::sortErrors()
 {
-    std::sort(m_errors.begin(), m_errors.end(), errorLineIsLower);
+    std::stable_sort(m_errors.begin(), m_errors.end(), errorLineIsLower);
 }
 
 void CodeValidator::validateStreamInputSize(StreamNode *stream, QVector<ASTNode > scope, QList<LangError> &errors)
@@ -917,6 +1016,13 @@ void CodeValidator::validateStreamInputSize(StreamNode *stream, QVector<ASTNode
 }
 
 int CodeValidator::getBlockDeclaredSize(std::shared_ptr<DeclarationNode> block, QVector<ASTNode > scope, ASTNode tree, QList<LangError> &errors)
+{
+    return (int) AnalysisCache::memoize(AnalysisCache::BlockDeclaredSize, block, scope, tree, &errors, [&]() {
+        return (double) computeBlockDeclaredSize(block, scope, tree, errors);
+    });
+}
+
+int CodeValidator::computeBlockDeclaredSize(std::shared_ptr<DeclarationNode> block, QVector<ASTNode > scope, ASTNode tree, QList<LangError> &errors)
 {
     int size = -1;
     Q_ASSERT(block->getNodeType() == AST::BundleDeclaration);
@@ -1008,7 +1114,14 @@ int CodeValidator::getFunctionDataSize(std::shared_ptr<FunctionNode>func, QVecto
     return size;
 }
 
-int CodeValidator::getBundleSize(BundleNode *bundle, QVector<ASTNode> scope, ASTNode tree, QList<LangError> &errors)
+int CodeValidator::getBundleSize(std::shared_ptr<BundleNode> bundle, QVector<ASTNode> scope, ASTNode tree, QList<LangError> &errors)
+{
+    return (int) AnalysisCache::memoize(AnalysisCache::BundleSize, bundle, scope, tree, &errors, [&]() {
+        return (double) computeBundleSize(bundle.get(), scope, tree, errors);
+    });
+}
+
+int CodeValidator::computeBundleSize(BundleNode *bundle, QVector<ASTNode> scope, ASTNode tree, QList<LangError> &errors)
 {
     std::shared_ptr<ListNode> indexList = bundle->index();
     int size = 0;
@@ -1120,6 +1233,13 @@ ASTNode CodeValidator::getBlockSubScope(std::shared_ptr<DeclarationNode> block)
 }
 
 int CodeValidator::getNodeNumOutputs(ASTNode node, const QVector<ASTNode> &scope, ASTNode tree, QList<LangError> &errors)
+{
+    return (int) AnalysisCache::memoize(AnalysisCache::NumOutputs, node, scope, tree, &errors, [&]() {
+        return (double) computeNodeNumOutputs(node, scope, tree, errors);
+    });
+}
+
+int CodeValidator::computeNodeNumOutputs(ASTNode node, const QVector<ASTNode> &scope, ASTNode tree, QList<LangError> &errors)
 {
     if (node->getNodeType() == AST::List) {
         int size = 0;
@@ -1128,7 +1248,7 @@ int CodeValidator::getNodeNumOutputs(ASTNode node, const QVector<ASTNode> &scope
         }
         return size;
     } else if (node->getNodeType() == AST::Bundle) {
-        return getBundleSize(static_cast<BundleNode *>(node.get()), scope, tree, errors);
+        return getBundleSize(static_pointer_cast<BundleNode>(node), scope, tree, errors);
     } else if (node->getNodeType() == AST::Int
                || node->getNodeType() == AST::Real
                || node->getNodeType() == AST::String
@@ -1158,6 +1278,13 @@ int CodeValidator::getNodeNumOutputs(ASTNode node, const QVector<ASTNode> &scope
 }
 
 int CodeValidator::getNodeNumInputs(ASTNode node, const QVector<ASTNode > &scope, ASTNode tree, QList<LangError> &errors)
+{
+    return (int) AnalysisCache::memoize(AnalysisCache::NumInputs, node, scope, tree, &errors, [&]() {
+        return (double) computeNodeNumInputs(node, scope, tree, errors);
+    });
+}
+
+int CodeValidator::computeNodeNumInputs(ASTNode node, const QVector<ASTNode > &scope, ASTNode tree, QList<LangError> &errors)
 {
     if (node->getNodeType() == AST::Function) {
         std::shared_ptr<FunctionNode> func = static_pointer_cast<FunctionNode>(node);
@@ -1191,7 +1318,7 @@ int CodeValidator::getNodeNumInputs(ASTNode node, const QVector<ASTNode > &scope
             return -1;
         }
     } else if (node->getNodeType() == AST::Bundle) {
-        return getBundleSize(static_cast<BundleNode *>(node.get()), scope, tree, errors);
+        return getBundleSize(static_pointer_cast<BundleNode>(node), scope, tree, errors);
     } else if (node->getNodeType() == AST::List) {
         int size = 0;
         foreach(ASTNode member, node->getChildren()) {
@@ -1316,6 +1443,13 @@ int CodeValidator::getTypeNumInputs(std::shared_ptr<DeclarationNode> blockDeclar
 }
 
 std::shared_ptr<DeclarationNode> CodeValidator::findDeclaration(QString objectName, const QVector<ASTNode> &scopeStack, ASTNode tree, vector<string> scope, vector<string> defaultNamespaces)
+{
+    return AnalysisCache::findDeclaration(objectName.toStdString(), scopeStack, tree, scope, defaultNamespaces, [&]() {
+        return lookupDeclaration(objectName, scopeStack, tree, scope, defaultNamespaces);
+    });
+}
+
+std::shared_ptr<DeclarationNode> CodeValidator::lookupDeclaration(QString objectName, const QVector<ASTNode> &scopeStack, ASTNode tree, vector<string> scope, vector<string> defaultNamespaces)
 {
     QVector<ASTNode> globalAndLocal;
     for (ASTNode scope : scopeStack) {
@@ -1527,6 +1661,16 @@ PortType CodeValidator::resolvePortPropertyType(PortPropertyNode *portproperty,
 }
 
 int CodeValidator::evaluateConstInteger(ASTNode node, QVector<ASTNode > scope, ASTNode tree, QList<LangError> &errors)
+{
+    if (node->getNodeType() == AST::Int) {
+        return static_cast<ValueNode *>(node.get())->getIntValue();
+    }
+    return (int) AnalysisCache::memoize(AnalysisCache::ConstInteger, node, scope, tree, &errors, [&]() {
+        return (double) computeConstInteger(node, scope, tree, errors);
+    });
+}
+
+int CodeValidator::computeConstInteger(ASTNode node, QVector<ASTNode > scope, ASTNode tree, QList<LangError> &errors)
 {
     int result = 0;
     if (node->getNodeType() == AST::Int) {
@@ -1568,6 +1712,16 @@ int CodeValidator::evaluateConstInteger(ASTNode node, QVector<ASTNode > scope, A
 }
 
 double CodeValidator::evaluateConstReal(ASTNode node, QVector<ASTNode> scope, ASTNode tree, QList<LangError> &errors)
+{
+    if (node->getNodeType() == AST::Real || node->getNodeType() == AST::Int) {
+        return computeConstReal(node, scope, tree, errors);
+    }
+    return AnalysisCache::memoize(AnalysisCache::ConstReal, node, scope, tree, &errors, [&]() {
+        return computeConstReal(node, scope, tree, errors);
+    });
+}
+
+double CodeValidator::computeConstReal(ASTNode node, QVector<ASTNode> scope, ASTNode tree, QList<LangError> &errors)
 {
     double result = 0;
     if (node->getNodeType() == AST::Real) {
@@ -1755,7 +1909,12 @@ QVector<ASTNode > CodeValidator::validTypesForPort(std::shared_ptr<DeclarationNo
                                            QVector<ASTNode > scope, ASTNode tree)
 {
     QVector<ASTNode > validTypes;
-    QVector<ASTNode > portList = getPortsForTypeBlock(typeDeclaration, scope, tree);
+    QVector<ASTNode > portList;
+    if (canUseTypeRegistry(scope, tree)) {
+        portList = TypeRegistry::forTree(tree)->getPortsNamedForBlock(typeDeclaration, portName.toStdString());
+    } else {
+        portList = getPortsForTypeBlock(typeDeclaration, scope, tree);
+    }
     foreach(ASTNode node, portList) {
         DeclarationNode *portNode = static_cast<DeclarationNode *>(node.get());
         ValueNode *name = static_cast<ValueNode *>(portNode->getPropertyValue("name").get());
@@ -1775,6 +1934,9 @@ std::shared_ptr<DeclarationNode> CodeValidator::findTypeDeclarationByName(string
                                                           QList<LangError> &errors,
                                                           std::vector<string> namespaces)
 {
+    if (namespaces.empty() && canUseTypeRegistry(scopeStack, tree)) {
+        return TypeRegistry::forTree(tree)->findType(typeName);
+    }
     for(ASTNode scope: scopeStack) {
         if (scope) {
             vector<ASTNode > members;
@@ -1848,6 +2010,9 @@ std::shared_ptr<DeclarationNode> CodeValidator::findDomainDeclaration(string dom
 
 QVector<ASTNode> CodeValidator::getPortsForType(string typeName, QVector<ASTNode> scope, ASTNode tree)
 {
+    if (canUseTypeRegistry(scope, tree)) {
+        return TypeRegistry::forTree(tree)->getPortsForType(typeName);
+    }
     QVector<ASTNode> portList;
 
     // Check the scope first
@@ -1903,6 +2068,9 @@ QVector<ASTNode> CodeValidator::getPortsForType(string typeName, QVector<ASTNode
 
 QVector<ASTNode > CodeValidator::getInheritedPorts(std::shared_ptr<DeclarationNode> block, QVector<ASTNode > scope, ASTNode tree)
 {
+    if (canUseTypeRegistry(scope, tree)) {
+        return TypeRegistry::forTree(tree)->getInheritedPorts(block);
+    }
     QVector<ASTNode > inheritedProperties;
     vector<string> inheritedTypes = CodeValidator::getInheritedTypeNames(block, scope, tree);
     QStringList inheritedName;
@@ -1922,6 +2090,9 @@ QVector<ASTNode > CodeValidator::getInheritedPorts(std::shared_ptr<DeclarationNo
 
 vector<string> CodeValidator::getInheritedTypeNames(std::shared_ptr<DeclarationNode> block, QVector<ASTNode > scope, ASTNode tree)
 {
+    if (canUseTypeRegistry(scope, tree)) {
+        return TypeRegistry::forTree(tree)->getInheritedTypeNames(block);
+    }
     vector<string> inheritedTypes;
     ASTNode inherits = block->getPropertyValue("inherits");
     if (inherits) {
@@ -1987,6 +2158,9 @@ std::shared_ptr<DeclarationNode> CodeValidator::getMainInputPortBlock(std::share
 
 QVector<ASTNode> CodeValidator::getPortsForTypeBlock(std::shared_ptr<DeclarationNode> block, QVector<ASTNode> scope, ASTNode tree)
 {
+    if (canUseTypeRegistry(scope, tree)) {
+        return TypeRegistry::forTree(tree)->getPortsForTypeBlock(block);
+    }
     ASTNode portsValue = block->getPropertyValue("properties");
     QVector<ASTNode> outList;
     if (portsValue && portsValue->getNodeType() != AST::None) {
@@ -2076,13 +2250,21 @@ int CodeValidator::numParallelStreams(StreamNode *stream, StrideSystem &platform
 }
 
 int CodeValidator::getNodeSize(ASTNode node, const QVector<ASTNode> &scopeStack, ASTNode tree)
+{
+    return (int) AnalysisCache::memoize(AnalysisCache::NodeSize, node, scopeStack, tree, nullptr, [&]() {
+        return (double) computeNodeSize(node, scopeStack, tree);
+    });
+}
+
+int CodeValidator::computeNodeSize(ASTNode node, const QVector<ASTNode> &scopeStack, ASTNode tree)
 {
     int size = 1;
     if (node->getNodeType() == AST::Bundle) {
-        BundleNode *bundle = static_cast<BundleNode *>(node.get());
+        std::shared_ptr<BundleNode> bundle = static_pointer_cast<BundleNode>(node);
         QList<LangError> errors;
-        size = getBundleSize(bundle, QVector<ASTNode >::fromStdVector(tree->getChildren()),
-                             tree, errors);
+        // Top level declarations are found through the tree, they don't
+        // need to be passed as scope too
+        size = getBundleSize(bundle, QVector<ASTNode >(), tree, errors);
         if (errors.size() > 0) {
             return -1;
         }
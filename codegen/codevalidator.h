@@ -53,6 +53,8 @@ public:
         NO_OPTIONS = 0x00,
         NO_RATE_VALIDATION = 0x01,
         USE_TESTING = 0x02,
+        ELIMINATE_DEAD_CODE = 0x04,
+        SERIAL_VALIDATION = 0x08,
     } Options;
 
     CodeValidator(QString striderootDir, ASTNode tree = nullptr, Options options = NO_OPTIONS,
@@ -119,7 +121,7 @@ public:
     static int getLargestPropertySize(vector<std::shared_ptr<PropertyNode >> &properties, QVector<ASTNode > scope, ASTNode tree, QList<LangError> &errors);
 
     static ASTNode getBlockSubScope(std::shared_ptr<DeclarationNode> block);
-    static int getBundleSize(BundleNode *bundle, QVector<ASTNode> scope, ASTNode tree, QList<LangError> &errors);
+    static int getBundleSize(std::shared_ptr<BundleNode> bundle, QVector<ASTNode> scope, ASTNode tree, QList<LangError> &errors);
 
     static QString getPortTypeName(PortType type);
 
@@ -141,6 +143,8 @@ public:
     static bool scopesMatch(QStringList scopeList, ASTNode node);
     static bool scopesMatch(ASTNode node1, ASTNode node2);
     static bool nodeInScope(std::vector<string> scopeList, ASTNode node);
+    /// Whether type queries in scope can be answered by the tree's TypeRegistry
+    static bool canUseTypeRegistry(const QVector<ASTNode> &scope, ASTNode tree);
 
     static vector<StreamNode *> getStreamsAtLine(ASTNode tree, int line);
 
@@ -154,24 +158,36 @@ private:
     QVector<std::shared_ptr<SystemNode> > getPlatformNodes();
 
     void validatePlatform(ASTNode node, QVector<ASTNode > scopeStack);
-    void validateTypes(ASTNode node, QVector<ASTNode > scopeStack, vector<string> parentNamespace = vector<string>());
-    void validateStreamMembers(StreamNode *node, QVector<ASTNode > scopeStack);
-    void validateBundleIndeces(ASTNode node, QVector<ASTNode > scope);
-    void validateBundleSizes(ASTNode node, QVector<ASTNode > scope);
-    void validateSymbolUniqueness(QVector<ASTNode > scope);
-    void validateListTypeConsistency(ASTNode node, QVector<ASTNode > scope);
-    void validateStreamSizes(ASTNode tree, QVector<ASTNode > scope);
-    void validateRates(ASTNode tree);
+    void validateTopLevelNodes();
+    void validateTypes(ASTNode node, QVector<ASTNode > scopeStack, QList<LangError> &errors, vector<string> parentNamespace = vector<string>());
+    void validateStreamMembers(StreamNode *node, QVector<ASTNode > scopeStack, QList<LangError> &errors);
+    void validateBundleIndeces(ASTNode node, QVector<ASTNode > scope, QList<LangError> &errors);
+    void validateBundleSizes(ASTNode node, QVector<ASTNode > scope, QList<LangError> &errors);
+    void validateSymbolUniqueness(QVector<ASTNode > scope, QList<LangError> &errors);
+    void validateSymbolUniqueness(ASTNode node, const QVector<ASTNode> &scope, int firstSibling, QList<LangError> &errors);
+    void validateListTypeConsistency(ASTNode node, QVector<ASTNode > scope, QList<LangError> &errors);
+    void validateStreamSizes(ASTNode node, QVector<ASTNode > scope, QList<LangError> &errors);
 
     void sortErrors();
 
     void validateStreamInputSize(StreamNode *stream, QVector<ASTNode > scope, QList<LangError> &errors);
-    void validateNodeRate(ASTNode node, ASTNode tree);
+    void validateNodeRate(ASTNode node, ASTNode tree, QList<LangError> &errors);
 
     int getBlockDataSize(std::shared_ptr<DeclarationNode> block, QVector<ASTNode > scope, QList<LangError> &errors);
 
     QString getNodeText(ASTNode node);
 
+    // Uncached implementations of the queries memoized by AnalysisCache
+    static std::shared_ptr<DeclarationNode> lookupDeclaration(QString objectName, const QVector<ASTNode> &scopeStack, ASTNode tree,
+                                                              vector<string> scope, vector<string> defaultNamespaces);
+    static int computeConstInteger(ASTNode node, QVector<ASTNode> scope, ASTNode tree, QList<LangError> &errors);
+    static double computeConstReal(ASTNode node, QVector<ASTNode> scope, ASTNode tree, QList<LangError> &errors);
+    static int computeNodeSize(ASTNode node, const QVector<ASTNode> &scopeStack, ASTNode tree);
+    static int computeBundleSize(BundleNode *bundle, QVector<ASTNode> scope, ASTNode tree, QList<LangError> &errors);
+    static int computeBlockDeclaredSize(std::shared_ptr<DeclarationNode> block, QVector<ASTNode> scope, ASTNode tree, QList<LangError> &errors);
+    static int computeNodeNumOutputs(ASTNode node, const QVector<ASTNode> &scope, ASTNode tree, QList<LangError> &errors);
+    static int computeNodeNumInputs(ASTNode node, const QVector<ASTNode> &scope, ASTNode tree, QList<LangError> &errors);
+
     std::shared_ptr<StrideSystem> m_system;
     ASTNode m_tree;
     QList<LangError> m_errors;
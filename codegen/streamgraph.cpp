@@ -0,0 +1,103 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+#include "streamgraph.h"
+
+StreamGraph::StreamGraph(ASTNode tree)
+{
+    for (ASTNode node : tree->getChildren()) {
+        if (node->getNodeType() == AST::Stream) {
+            addStream(std::static_pointer_cast<StreamNode>(node));
+        }
+    }
+}
+
+StreamGraph::StreamGraph(std::vector<ASTNode> streams)
+{
+    for (ASTNode node : streams) {
+        if (node->getNodeType() == AST::Stream) {
+            addStream(std::static_pointer_cast<StreamNode>(node));
+        }
+    }
+}
+
+int StreamGraph::indexOf(ASTNode node) const
+{
+    auto it = m_memberIndex.find(node.get());
+    if (it == m_memberIndex.end()) {
+        return -1;
+    }
+    return (int) it->second;
+}
+
+void StreamGraph::addStream(std::shared_ptr<StreamNode> stream)
+{
+    m_streamMembers.push_back(std::vector<size_t>());
+    size_t left = addMember(stream->getLeft());
+    ASTNode right = stream->getRight();
+    while (right->getNodeType() == AST::Stream) {
+        std::shared_ptr<StreamNode> subStream = std::static_pointer_cast<StreamNode>(right);
+        size_t next = addMember(subStream->getLeft());
+        connect(left, next);
+        left = next;
+        right = subStream->getRight();
+    }
+    connect(left, addMember(right));
+}
+
+size_t StreamGraph::addMember(ASTNode node)
+{
+    auto it = m_memberIndex.find(node.get());
+    if (it != m_memberIndex.end()) {
+        m_streamMembers.back().push_back(it->second);
+        return it->second;
+    }
+    size_t index = m_members.size();
+    m_members.push_back(node);
+    m_memberIndex[node.get()] = index;
+    m_outgoing.push_back(std::vector<size_t>());
+    m_incoming.push_back(std::vector<size_t>());
+    m_streamMembers.back().push_back(index);
+    return index;
+}
+
+void StreamGraph::connect(size_t source, size_t destination)
+{
+    Connection connection;
+    connection.source = source;
+    connection.destination = destination;
+    connection.stream = m_streamMembers.size() - 1;
+    m_outgoing[source].push_back(m_connections.size());
+    m_incoming[destination].push_back(m_connections.size());
+    m_connections.push_back(connection);
+}
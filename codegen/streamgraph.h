@@ -0,0 +1,88 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+#ifndef STREAMGRAPH_H
+#define STREAMGRAPH_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "ast.h"
+#include "streamnode.h"
+
+/// Dataflow graph of a set of streams, by default the top level streams of a
+/// tree. Every member of a stream is a node and every ">>" between two
+/// members is a connection from the member on the left to the member on the
+/// right. The graph is built once and can then be walked in either direction
+/// by the resolver passes.
+class StreamGraph
+{
+public:
+    struct Connection {
+        size_t source;
+        size_t destination;
+        size_t stream; // Index of the stream the connection belongs to
+    };
+
+    StreamGraph(ASTNode tree);
+    StreamGraph(std::vector<ASTNode> streams);
+
+    size_t size() const { return m_members.size(); }
+    ASTNode member(size_t index) const { return m_members[index]; }
+    /// Index of node in the graph or -1 if node is not a stream member.
+    int indexOf(ASTNode node) const;
+
+    size_t streamCount() const { return m_streamMembers.size(); }
+    /// Members of a stream from left to right.
+    const std::vector<size_t> &streamMembers(size_t stream) const { return m_streamMembers[stream]; }
+
+    /// Connections in stream order (streams in tree order, members left to right).
+    const std::vector<Connection> &connections() const { return m_connections; }
+    /// Indices in connections() of the connections that leave or reach member.
+    const std::vector<size_t> &outgoing(size_t member) const { return m_outgoing[member]; }
+    const std::vector<size_t> &incoming(size_t member) const { return m_incoming[member]; }
+
+private:
+    void addStream(std::shared_ptr<StreamNode> stream);
+    size_t addMember(ASTNode node);
+    void connect(size_t source, size_t destination);
+
+    std::vector<ASTNode> m_members;
+    std::unordered_map<AST *, size_t> m_memberIndex;
+    std::vector<Connection> m_connections;
+    std::vector<std::vector<size_t>> m_outgoing;
+    std::vector<std::vector<size_t>> m_incoming;
+    std::vector<std::vector<size_t>> m_streamMembers;
+};
+
+#endif // STREAMGRAPH_H
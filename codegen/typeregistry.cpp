@@ -0,0 +1,313 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#include <algorithm>
+
+#include <QDebug>
+
+#include "typeregistry.h"
+#include "codevalidator.h"
+
+std::map<AST *, std::pair<std::weak_ptr<AST>, std::shared_ptr<TypeRegistry>>> TypeRegistry::m_registries;
+std::mutex TypeRegistry::m_registriesLock;
+
+TypeRegistry::TypeRegistry(ASTNode tree) :
+    m_tree(tree)
+{
+}
+
+std::shared_ptr<TypeRegistry> TypeRegistry::forTree(ASTNode tree)
+{
+    std::lock_guard<std::mutex> locker(m_registriesLock);
+    auto it = m_registries.find(tree.get());
+    if (it != m_registries.end() && it->second.first.lock() == tree) {
+        return it->second.second;
+    }
+    // Drop registries of trees that are gone before adding a new one
+    for (auto registry = m_registries.begin(); registry != m_registries.end();) {
+        if (registry->second.first.expired()) {
+            registry = m_registries.erase(registry);
+        } else {
+            ++registry;
+        }
+    }
+    auto registry = std::make_shared<TypeRegistry>(tree);
+    m_registries[tree.get()] = std::make_pair(std::weak_ptr<AST>(tree), registry);
+    return registry;
+}
+
+std::shared_ptr<DeclarationNode> TypeRegistry::findType(std::string typeName, bool unscopedOnly)
+{
+    std::lock_guard<std::recursive_mutex> locker(m_lock);
+    update();
+    auto &types = unscopedOnly ? m_firstUnscopedType : m_firstType;
+    auto it = types.find(typeName);
+    return it != types.end() ? it->second : nullptr;
+}
+
+QVector<ASTNode> TypeRegistry::getPortsForType(std::string typeName)
+{
+    std::lock_guard<std::recursive_mutex> locker(m_lock);
+    update();
+    return typeTable(typeName).ports;
+}
+
+QVector<ASTNode> TypeRegistry::getPortsForTypeBlock(std::shared_ptr<DeclarationNode> block)
+{
+    std::lock_guard<std::recursive_mutex> locker(m_lock);
+    update();
+    return blockTable(block).ports;
+}
+
+QVector<ASTNode> TypeRegistry::getInheritedPorts(std::shared_ptr<DeclarationNode> block)
+{
+    std::lock_guard<std::recursive_mutex> locker(m_lock);
+    update();
+    return inheritedTable(block).ports;
+}
+
+std::vector<std::string> TypeRegistry::getInheritedTypeNames(std::shared_ptr<DeclarationNode> block)
+{
+    std::lock_guard<std::recursive_mutex> locker(m_lock);
+    update();
+    std::vector<DeclarationNode *> visiting;
+    return inheritedTypeNames(block, visiting);
+}
+
+QVector<ASTNode> TypeRegistry::getPortsNamed(std::string typeName, std::string portName)
+{
+    std::lock_guard<std::recursive_mutex> locker(m_lock);
+    update();
+    const PortTable &table = typeTable(typeName);
+    auto it = table.portsByName.find(portName);
+    return it != table.portsByName.end() ? it->second : QVector<ASTNode>();
+}
+
+QVector<ASTNode> TypeRegistry::getPortsNamedForBlock(std::shared_ptr<DeclarationNode> block, std::string portName)
+{
+    std::lock_guard<std::recursive_mutex> locker(m_lock);
+    update();
+    const PortTable &table = blockTable(block);
+    auto it = table.portsByName.find(portName);
+    return it != table.portsByName.end() ? it->second : QVector<ASTNode>();
+}
+
+void TypeRegistry::update()
+{
+    ASTNode tree = m_tree.lock();
+    if (!tree) {
+        return;
+    }
+    bool typesChanged = false;
+    if (tree->getChildrenRevision() != m_childrenRevision || tree->getChildCount() < m_childCount) {
+        m_firstType.clear();
+        m_firstUnscopedType.clear();
+        for (ASTNode node: tree->getChildren()) {
+            addTypeDeclaration(node, typesChanged);
+        }
+        typesChanged = true;
+    } else if (tree->getChildCount() > m_childCount) {
+        // Declarations are usually appended, so only the new ones are read
+        vector<ASTNode> children = tree->getChildren();
+        for (size_t i = m_childCount; i < children.size(); i++) {
+            addTypeDeclaration(children[i], typesChanged);
+        }
+    }
+    m_childCount = tree->getChildCount();
+    m_childrenRevision = tree->getChildrenRevision();
+    if (typesChanged) {
+        m_blockTables.clear();
+        m_inheritedTables.clear();
+        m_typeTables.clear();
+    }
+}
+
+void TypeRegistry::addTypeDeclaration(ASTNode node, bool &typesChanged)
+{
+    if (node->getNodeType() != AST::Declaration) {
+        return;
+    }
+    std::shared_ptr<DeclarationNode> declaration = std::static_pointer_cast<DeclarationNode>(node);
+    if (declaration->getObjectType() != "type" && declaration->getObjectType() != "platformType") {
+        return;
+    }
+    ASTNode valueNode = declaration->getPropertyValue("typeName");
+    if (!valueNode || valueNode->getNodeType() != AST::String) {
+        qDebug() << "TypeRegistry: type missing typeName port.";
+        return;
+    }
+    // The first declaration of a name is the one used
+    std::string typeName = static_cast<ValueNode *>(valueNode.get())->getStringValue();
+    if (m_firstType.insert({typeName, declaration}).second) {
+        typesChanged = true;
+    }
+    if (CodeValidator::nodeInScope(std::vector<std::string>(), node)
+            && m_firstUnscopedType.insert({typeName, declaration}).second) {
+        typesChanged = true;
+    }
+}
+
+bool TypeRegistry::isCurrent(const PortTable &table)
+{
+    for (auto &source: table.sources) {
+        if (source.first->getPropertyValue("properties").get() != source.second.first
+                || source.first->getPropertyValue("inherits").get() != source.second.second) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TypeRegistry::addSource(TypeRegistry::PortTable &table, std::shared_ptr<DeclarationNode> block)
+{
+    table.sources.push_back({block, {block->getPropertyValue("properties").get(),
+                                     block->getPropertyValue("inherits").get()}});
+}
+
+void TypeRegistry::addPorts(TypeRegistry::PortTable &table, const QVector<ASTNode> &ports)
+{
+    for (ASTNode port: ports) {
+        if (!table.portSet.insert(port.get()).second) {
+            continue;
+        }
+        table.ports << port;
+        if (port->getNodeType() == AST::Declaration) {
+            ASTNode name = std::static_pointer_cast<DeclarationNode>(port)->getPropertyValue("name");
+            if (name && name->getNodeType() == AST::String) {
+                table.portsByName[static_cast<ValueNode *>(name.get())->getStringValue()] << port;
+            }
+        }
+    }
+}
+
+const TypeRegistry::PortTable &TypeRegistry::blockTable(std::shared_ptr<DeclarationNode> block)
+{
+    auto it = m_blockTables.find(block.get());
+    if (it != m_blockTables.end() && isCurrent(it->second)) {
+        return it->second;
+    }
+    PortTable table;
+    addSource(table, block);
+    QVector<ASTNode> ownPorts;
+    ASTNode portsValue = block->getPropertyValue("properties");
+    if (portsValue && portsValue->getNodeType() == AST::List) {
+        for (ASTNode port: portsValue->getChildren()) {
+            ownPorts << port;
+        }
+    }
+    addPorts(table, ownPorts);
+    const PortTable &inherited = inheritedTable(block);
+    addPorts(table, inherited.ports);
+    table.sources.insert(table.sources.end(), inherited.sources.begin(), inherited.sources.end());
+    return m_blockTables[block.get()] = std::move(table);
+}
+
+const TypeRegistry::PortTable &TypeRegistry::inheritedTable(std::shared_ptr<DeclarationNode> block)
+{
+    auto it = m_inheritedTables.find(block.get());
+    if (it != m_inheritedTables.end() && isCurrent(it->second)) {
+        return it->second;
+    }
+    PortTable table;
+    addSource(table, block);
+    std::vector<DeclarationNode *> visiting;
+    for (std::string typeName: inheritedTypeNames(block, visiting)) {
+        const PortTable &parent = typeTable(typeName);
+        addPorts(table, parent.ports);
+        table.sources.insert(table.sources.end(), parent.sources.begin(), parent.sources.end());
+    }
+    return m_inheritedTables[block.get()] = std::move(table);
+}
+
+const TypeRegistry::PortTable &TypeRegistry::typeTable(std::string typeName)
+{
+    auto it = m_typeTables.find(typeName);
+    if (it != m_typeTables.end() && isCurrent(it->second)) {
+        return it->second;
+    }
+    static const PortTable emptyTable;
+    if (std::find(m_typesInProgress.begin(), m_typesInProgress.end(), typeName) != m_typesInProgress.end()) {
+        qDebug() << "TypeRegistry: type inherits from itself: " << QString::fromStdString(typeName);
+        return emptyTable;
+    }
+    m_typesInProgress.push_back(typeName);
+    PortTable table;
+    auto declaration = m_firstType.find(typeName);
+    if (declaration != m_firstType.end()) {
+        const PortTable &ports = blockTable(declaration->second);
+        addPorts(table, ports.ports);
+        table.sources.insert(table.sources.end(), ports.sources.begin(), ports.sources.end());
+    }
+    declaration = m_firstUnscopedType.find(typeName);
+    if (declaration != m_firstUnscopedType.end()) {
+        const PortTable &inherited = inheritedTable(declaration->second);
+        addPorts(table, inherited.ports);
+        table.sources.insert(table.sources.end(), inherited.sources.begin(), inherited.sources.end());
+    }
+    m_typesInProgress.pop_back();
+    return m_typeTables[typeName] = std::move(table);
+}
+
+std::vector<std::string> TypeRegistry::inheritedTypeNames(std::shared_ptr<DeclarationNode> block,
+                                                          std::vector<DeclarationNode *> &visiting)
+{
+    std::vector<std::string> inheritedTypes;
+    if (std::find(visiting.begin(), visiting.end(), block.get()) != visiting.end()) {
+        return inheritedTypes;
+    }
+    ASTNode inherits = block->getPropertyValue("inherits");
+    if (!inherits || inherits->getNodeType() == AST::None) {
+        return inheritedTypes;
+    }
+    if (inherits->getNodeType() == AST::List) {
+        visiting.push_back(block.get());
+        for (ASTNode inheritsFromName: inherits->getChildren()) {
+            if (inheritsFromName->getNodeType() == AST::String) {
+                std::string inheritsName = static_cast<ValueNode *>(inheritsFromName.get())->getStringValue();
+                inheritedTypes.push_back(inheritsName);
+                auto inheritedDeclaration = m_firstUnscopedType.find(inheritsName);
+                if (inheritedDeclaration != m_firstUnscopedType.end()) {
+                    std::vector<std::string> parentTypes = inheritedTypeNames(inheritedDeclaration->second, visiting);
+                    inheritedTypes.insert(inheritedTypes.end(), parentTypes.begin(), parentTypes.end());
+                }
+            }
+        }
+        visiting.pop_back();
+    } else if (inherits->getNodeType() == AST::String) {
+        inheritedTypes.push_back(static_cast<ValueNode *>(inherits.get())->getStringValue());
+    } else {
+        qDebug() << "Unexpected type for inherits property";
+    }
+    return inheritedTypes;
+}
@@ -0,0 +1,118 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#ifndef TYPEREGISTRY_H
+#define TYPEREGISTRY_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <QVector>
+
+#include "ast.h"
+#include "declarationnode.h"
+
+/// Type declarations of a tree with their inheritance resolved and their
+/// ports flattened into one de-duplicated table per type. Tables are built
+/// the first time a type is queried and kept until the type declarations in
+/// the tree change. All functions can be called from several threads.
+class TypeRegistry
+{
+public:
+    TypeRegistry(ASTNode tree);
+
+    /// The registry for tree, shared by all users of the tree.
+    static std::shared_ptr<TypeRegistry> forTree(ASTNode tree);
+
+    /// First type declared with typeName. If unscopedOnly is set, types that
+    /// belong to a namespace are skipped.
+    std::shared_ptr<DeclarationNode> findType(std::string typeName, bool unscopedOnly = true);
+
+    /// Ports of the type, including inherited ports.
+    QVector<ASTNode> getPortsForType(std::string typeName);
+    /// Ports declared in block, including inherited ports.
+    QVector<ASTNode> getPortsForTypeBlock(std::shared_ptr<DeclarationNode> block);
+    QVector<ASTNode> getInheritedPorts(std::shared_ptr<DeclarationNode> block);
+    std::vector<std::string> getInheritedTypeNames(std::shared_ptr<DeclarationNode> block);
+
+    /// Ports of the type called portName, in declaration order.
+    QVector<ASTNode> getPortsNamed(std::string typeName, std::string portName);
+    QVector<ASTNode> getPortsNamedForBlock(std::shared_ptr<DeclarationNode> block, std::string portName);
+
+private:
+    struct PortTable {
+        QVector<ASTNode> ports;
+        std::unordered_set<AST *> portSet;
+        std::unordered_map<std::string, QVector<ASTNode>> portsByName;
+        // Declarations the table was built from with the values of their
+        // "properties" and "inherits" at the time
+        std::vector<std::pair<std::shared_ptr<DeclarationNode>, std::pair<AST *, AST *>>> sources;
+    };
+
+    void update();
+    void addTypeDeclaration(ASTNode node, bool &typesChanged);
+    bool isCurrent(const PortTable &table);
+    void addSource(PortTable &table, std::shared_ptr<DeclarationNode> block);
+    void addPorts(PortTable &table, const QVector<ASTNode> &ports);
+
+    const PortTable &blockTable(std::shared_ptr<DeclarationNode> block);
+    const PortTable &inheritedTable(std::shared_ptr<DeclarationNode> block);
+    const PortTable &typeTable(std::string typeName);
+    std::vector<std::string> inheritedTypeNames(std::shared_ptr<DeclarationNode> block,
+                                                std::vector<DeclarationNode *> &visiting);
+
+    std::weak_ptr<AST> m_tree;
+    size_t m_childCount {0};
+    unsigned int m_childrenRevision {0};
+
+    std::unordered_map<std::string, std::shared_ptr<DeclarationNode>> m_firstType;
+    std::unordered_map<std::string, std::shared_ptr<DeclarationNode>> m_firstUnscopedType;
+
+    std::unordered_map<DeclarationNode *, PortTable> m_blockTables;
+    std::unordered_map<DeclarationNode *, PortTable> m_inheritedTables;
+    std::unordered_map<std::string, PortTable> m_typeTables;
+    std::vector<std::string> m_typesInProgress;
+
+    std::recursive_mutex m_lock;
+
+    static std::map<AST *, std::pair<std::weak_ptr<AST>, std::shared_ptr<TypeRegistry>>> m_registries;
+    static std::mutex m_registriesLock;
+};
+
+#endif // TYPEREGISTRY_H
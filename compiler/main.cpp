@@ -60,6 +60,22 @@ int main(int argc, char *argv[])
                                              QCoreApplication::translate("main", "Path to strideroot directory"),
                                              QCoreApplication::translate("main", "directory"));
     parser.addOption(targetDirectoryOption);
+    QCommandLineOption keepDeadCodeOption(QStringList() << "k" << "keep-dead-code",
+                                          QCoreApplication::translate("main", "Generate code for streams that don't reach any output"));
+    parser.addOption(keepDeadCodeOption);
+    QCommandLineOption renderOption(QStringList() << "r" << "render",
+                                    QCoreApplication::translate("main", "Render offline instead of running: source [input] output"));
+    parser.addOption(renderOption);
+    QCommandLineOption nullDeviceOption(QStringList() << "n" << "null-device",
+                                        QCoreApplication::translate("main", "Run on a timer instead of an audio device and report real-time headroom"));
+    parser.addOption(nullDeviceOption);
+    QCommandLineOption loopbackOption(QStringList() << "loopback",
+                                      QCoreApplication::translate("main", "Feed the outputs of the null device back to its inputs and measure latency"));
+    parser.addOption(loopbackOption);
+    QCommandLineOption secondsOption(QStringList() << "seconds",
+                                     QCoreApplication::translate("main", "Duration to render or run. Defaults to the length of the input when rendering"),
+                                     QCoreApplication::translate("main", "seconds"));
+    parser.addOption(secondsOption);
     parser.process(app);
 
     const QStringList args = parser.positionalArguments();
@@ -71,6 +87,34 @@ int main(int argc, char *argv[])
     }
     QString fileName = args.at(0);
 
+    // Rendering reads and writes files instead of the audio device. Paths
+    // are made absolute as the renderer runs in the build directory.
+    QMap<QString, QVariant> configuration;
+    if (parser.isSet(renderOption)) {
+        if (args.size() < 2 || args.size() > 3) {
+            qDebug() << "Render needs an output file and an optional input file";
+            return -1;
+        }
+        if (args.size() == 2 && !parser.isSet(secondsOption)) {
+            qDebug() << "Render without input file needs --seconds";
+            return -1;
+        }
+        QMap<QString, QVariant> render;
+        if (args.size() == 3) {
+            render["input"] = QFileInfo(args.at(1)).absoluteFilePath();
+        }
+        render["output"] = QFileInfo(args.back()).absoluteFilePath();
+        render["seconds"] = parser.value(secondsOption).toDouble();
+        configuration["Render"] = render;
+    } else if (parser.isSet(nullDeviceOption)) {
+        QMap<QString, QVariant> nullDevice;
+        if (parser.isSet(secondsOption)) {
+            nullDevice["seconds"] = parser.value(secondsOption).toDouble();
+        }
+        nullDevice["loopback"] = parser.isSet(loopbackOption);
+        configuration["NullDevice"] = nullDevice;
+    }
+
     if (platformRootPath.isEmpty()) {
         platformRootPath = "/home/andres/Documents/src/Stride/Stride/strideroot"; // For my convenience :)
     }
@@ -83,7 +127,11 @@ int main(int argc, char *argv[])
 
     bool buildOK = true;
     if (tree) {
-        CodeValidator validator(platformRootPath, tree);
+        CodeValidator::Options options = CodeValidator::ELIMINATE_DEAD_CODE;
+        if (parser.isSet(keepDeadCodeOption)) {
+            options = CodeValidator::NO_OPTIONS;
+        }
+        CodeValidator validator(platformRootPath, tree, options);
 
         if (!validator.isValid()) {
             QList<LangError> errors = validator.getErrors();
@@ -110,8 +158,19 @@ int main(int argc, char *argv[])
         }
         vector<Builder *> builders = platform->createBuilders(dirName, usedFrameworks);
         for (auto builder: builders) {
+            if (!configuration.isEmpty()) {
+                builder->setConfiguration(configuration);
+            }
             if (builder->build(tree)) {
                 qDebug() << "Built in directory:" << dirName;
+                if (parser.isSet(renderOption) || parser.isSet(nullDeviceOption)) {
+                    if (!builder->run()) {
+                        qDebug() << "Run failed for " << fileName;
+                        buildOK = false;
+                    }
+                    qDebug() << builder->getStdOut();
+                    qDebug() << builder->getStdErr();
+                }
             } else {
                 qDebug() << "Build failed for " << fileName;
                 qDebug() << "Using framework: " << builder->getPlatformPath();
@@ -202,26 +202,16 @@ void CodeEditor::updateAutoCompleteMenu(QString currentWord)
 {
     m_autoCompleteMenu.clear();
     QAction *activeAction = nullptr;
+    QVector<SymbolIndex::Symbol> completions;
     if (currentWord[0].toUpper() == currentWord[0]) {
-        QStringList functions = m_codeModel->getFunctions();
-        foreach(QString functionName, functions) {
-            if (functionName.left(currentWord.size()) == currentWord) {
-                QString syntaxText = m_codeModel->getFunctionSyntax(functionName);
-                QAction *syntaxAction = m_autoCompleteMenu.addAction(functionName, this, SLOT(insertAutoComplete()));
-                syntaxAction->setData(syntaxText);
-                if (!activeAction) { activeAction = syntaxAction; }
-            }
-        }
+        completions = m_codeModel->getCompletions(currentWord, SymbolIndex::Function);
     } else if (currentWord[0].toLower() == currentWord[0]) {
-        QStringList types = m_codeModel->getTypes();
-        foreach(QString typeName, types) {
-            if (typeName.left(currentWord.size()) == currentWord) {
-                QString syntaxText = m_codeModel->getTypeSyntax(typeName);
-                QAction *syntaxAction = m_autoCompleteMenu.addAction(typeName, this, SLOT(insertAutoComplete()));
-                syntaxAction->setData(syntaxText);
-                if (!activeAction) { activeAction = syntaxAction; }
-            }
-        }
+        completions = m_codeModel->getCompletions(currentWord, SymbolIndex::Type);
+    }
+    for (const SymbolIndex::Symbol &symbol : completions) {
+        QAction *syntaxAction = m_autoCompleteMenu.addAction(symbol.name, this, SLOT(insertAutoComplete()));
+        syntaxAction->setData(symbol.syntax);
+        if (!activeAction) { activeAction = syntaxAction; }
     }
     if (activeAction) {
         m_autoCompleteMenu.setActiveAction(activeAction);
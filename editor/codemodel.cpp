@@ -47,18 +47,28 @@
 
 CodeModel::CodeModel(QObject *parent) :
     QObject(parent),
-    m_lastValidTree(nullptr)
+    m_snapshot(std::make_shared<Snapshot>()),
+    m_requestPending(false),
+    m_stopping(false),
+    m_requestGeneration(0)
 {
-
+    m_analysisThread = std::thread(&CodeModel::analysisLoop, this);
 }
 
 CodeModel::~CodeModel()
 {
+    m_requestLock.lock();
+    m_stopping = true;
+    m_requestGeneration++; // Abandon analysis in progress
+    m_requestReady.wakeAll();
+    m_requestLock.unlock();
+    m_analysisThread.join();
 }
 
 QString CodeModel::getHtmlDocumentation(QString symbol)
 {
-    if (!m_lastValidTree) {
+    std::shared_ptr<const Snapshot> current = snapshot();
+    if (!current->lastValidTree) {
         return tr("Parsing error. Can't update tree.");
     }
     QString header = R"(<head>
@@ -90,8 +100,7 @@ QString CodeModel::getHtmlDocumentation(QString symbol)
            </style></head>)";
     QList<LangError> errors;
     if (symbol[0].toLower() == symbol[0]) {
-        QMutexLocker locker(&m_validTreeLock);
-        std::shared_ptr<DeclarationNode> typeBlock = CodeValidator::findTypeDeclarationByName(symbol.toStdString(), QVector<ASTNode>(), m_lastValidTree, errors);
+        std::shared_ptr<DeclarationNode> typeBlock = CodeValidator::findTypeDeclarationByName(symbol.toStdString(), QVector<ASTNode>(), current->lastValidTree, errors);
         if (typeBlock) {
             AST *metaValue = typeBlock->getPropertyValue("meta").get();
             if (metaValue) {
@@ -102,7 +111,7 @@ QString CodeModel::getHtmlDocumentation(QString symbol)
                 vector<std::shared_ptr<PropertyNode> > properties = typeBlock->getProperties();
                 QString propertiesHtml = tr("<h2>Ports</h2>") + "\n";
                 QString propertiesTable = "<table><tr><td><b>Name</b></td><td><b>Types</b></td><td><b>Default</b></td><td><b>Direction</b></td></tr>";
-                QVector<ASTNode> ports = CodeValidator::getPortsForTypeBlock(typeBlock, QVector<ASTNode>(), m_lastValidTree);
+                QVector<ASTNode> ports = CodeValidator::getPortsForTypeBlock(typeBlock, QVector<ASTNode>(), current->lastValidTree);
                 for(ASTNode port : ports) {
                     DeclarationNode *portBlock = static_cast<DeclarationNode *>(port.get());
                     Q_ASSERT(portBlock->getNodeType() == AST::Declaration);
@@ -162,8 +171,7 @@ QString CodeModel::getHtmlDocumentation(QString symbol)
             }
         }
     } else if (symbol[0].toUpper() == symbol[0]) { // Check if it is a declared module
-        QMutexLocker locker(&m_validTreeLock);
-        std::shared_ptr<DeclarationNode> declaration = CodeValidator::findDeclaration(symbol, QVector<ASTNode>(), m_lastValidTree);
+        std::shared_ptr<DeclarationNode> declaration = CodeValidator::findDeclaration(symbol, QVector<ASTNode>(), current->lastValidTree);
         if (declaration) {
             AST *metaValue = declaration->getPropertyValue("meta").get();
             if (metaValue) {
@@ -253,10 +261,10 @@ QString CodeModel::getHtmlDocumentation(QString symbol)
 
 QString CodeModel::getTooltipText(QString symbol)
 {
+    std::shared_ptr<const Snapshot> current = snapshot();
     QString text;
     if (symbol[0].toUpper() == symbol[0]) { // Check if it is a declared module
-        QMutexLocker locker(&m_validTreeLock);
-        std::shared_ptr<DeclarationNode> declaration = CodeValidator::findDeclaration(symbol, QVector<ASTNode>(), m_lastValidTree);
+        std::shared_ptr<DeclarationNode> declaration = CodeValidator::findDeclaration(symbol, QVector<ASTNode>(), current->lastValidTree);
         if (declaration) {
 //            AST *metaValue = declaration->getPropertyValue("meta").get();
 //            if (metaValue) {
@@ -317,7 +325,7 @@ QString CodeModel::getTooltipText(QString symbol)
         }
     } else { // word starts with lower case letter
         QList<LangError> errors;
-        std::shared_ptr<DeclarationNode> typeBlock = CodeValidator::findTypeDeclarationByName(symbol.toStdString(), QVector<ASTNode>(), m_lastValidTree, errors);
+        std::shared_ptr<DeclarationNode> typeBlock = CodeValidator::findTypeDeclarationByName(symbol.toStdString(), QVector<ASTNode>(), current->lastValidTree, errors);
         if (typeBlock) {
             text = "type: " + symbol;
 //            AST *metaValue = typeBlock->getPropertyValue("meta").get();
@@ -331,13 +339,13 @@ QString CodeModel::getTooltipText(QString symbol)
 
 QPair<QString, int> CodeModel::getSymbolLocation(QString symbol)
 {
+    std::shared_ptr<const Snapshot> current = snapshot();
     QPair<QString, int> location;
-    if (!m_lastValidTree) {
+    if (!current->lastValidTree) {
         return location;
     }
 
-    QMutexLocker locker(&m_validTreeLock);
-    for(ASTNode node : m_lastValidTree->getChildren()) {
+    for(ASTNode node : current->lastValidTree->getChildren()) {
         if (node->getNodeType() == AST::Declaration ||
                 node->getNodeType() == AST::BundleDeclaration) {
             DeclarationNode *block = static_cast<DeclarationNode *>(node.get());
@@ -367,11 +375,11 @@ QPair<QString, int> CodeModel::getSymbolLocation(QString symbol)
 
 AST *CodeModel::getOptimizedTree()
 {
-    QMutexLocker locker(&m_validTreeLock);
+    std::shared_ptr<const Snapshot> current = snapshot();
     AST *optimizedTree = nullptr;
-    if (m_lastValidTree) {
+    if (current->lastValidTree) {
         optimizedTree = new AST;
-        for(ASTNode node : m_lastValidTree->getChildren()) {
+        for(ASTNode node : current->lastValidTree->getChildren()) {
             optimizedTree->addChild(node->deepCopy());
         }
     }
@@ -380,40 +388,51 @@ AST *CodeModel::getOptimizedTree()
 
 //Builder *CodeModel::createBuilder(QString projectDir)
 //{
-//    QMutexLocker locker(&m_validTreeLock);
-//    return m_platform->createBuilder(projectDir);
+////    return m_platform->createBuilder(projectDir);
 //}
 
+std::shared_ptr<StrideSystem> CodeModel::getSystem()
+{
+    return snapshot()->system;
+}
+
 QStringList CodeModel::getTypes()
 {
-    QMutexLocker locker(&m_validTreeLock);
-    return m_types;
+    return snapshot()->types;
 }
 
 QStringList CodeModel::getFunctions()
 {
-    QMutexLocker locker(&m_validTreeLock);
-    return m_funcs;
+    return snapshot()->funcs;
 }
 
 QStringList CodeModel::getObjectNames()
 {
-    QMutexLocker locker(&m_validTreeLock);
-    return m_objectNames;
+    return snapshot()->objectNames;
 }
 
 QString CodeModel::getFunctionSyntax(QString symbol)
 {
-    if (symbol.isEmpty()) {
-        return "";
-    }
+    std::shared_ptr<const Snapshot> current = snapshot();
+    const SymbolIndex::Symbol *indexed = current->symbols.findSymbol(symbol, SymbolIndex::Function);
+    return indexed ? indexed->syntax : QString();
+}
+
+QString CodeModel::getTypeSyntax(QString symbol)
+{
+    std::shared_ptr<const Snapshot> current = snapshot();
+    const SymbolIndex::Symbol *indexed = current->symbols.findSymbol(symbol, SymbolIndex::Type);
+    return indexed ? indexed->syntax : QString();
+}
+
+QVector<SymbolIndex::Symbol> CodeModel::getCompletions(QString prefix, SymbolIndex::Kind kind)
+{
+    return snapshot()->symbols.complete(prefix, kind);
+}
+
+QString CodeModel::functionSyntax(QString symbol, std::shared_ptr<DeclarationNode> declaration)
+{
     QString text;
-    QMutexLocker locker(&m_validTreeLock);
-    QVector<ASTNode> libraryNodes;
-    for (auto it = m_system->getBuiltinObjectsReference().begin(); it != m_system->getBuiltinObjectsReference().end(); it++ ) {
-        libraryNodes << QVector<ASTNode>::fromStdVector(it->second);
-    }
-    std::shared_ptr<DeclarationNode> declaration = CodeValidator::findDeclaration(symbol, libraryNodes, m_lastValidTree);
     if (declaration) {
         AST *metaValue = declaration->getPropertyValue("meta").get();
         Q_ASSERT(metaValue);
@@ -455,15 +474,9 @@ QString CodeModel::getFunctionSyntax(QString symbol)
     return text;
 }
 
-QString CodeModel::getTypeSyntax(QString symbol)
+QString CodeModel::typeSyntax(QString symbol, std::shared_ptr<DeclarationNode> declaration)
 {
-    if (symbol.isEmpty()) {
-        return "";
-    }
     QString text;
-    QMutexLocker locker(&m_validTreeLock);
-    QList<LangError> errors;
-    std::shared_ptr<DeclarationNode> declaration = CodeValidator::findTypeDeclarationByName(symbol.toStdString(), QVector<ASTNode>(), m_lastValidTree, errors);
     if (declaration) {
         AST *metaValue = declaration->getPropertyValue("meta").get();
         if (metaValue) {
@@ -502,47 +515,150 @@ QString CodeModel::getTypeSyntax(QString symbol)
 
 QList<LangError> CodeModel::getErrors()
 {
-    QMutexLocker locker(&m_validTreeLock);
-    return m_errors;
+    return snapshot()->errors;
+}
+
+void CodeModel::requestCodeAnalysis(QString code, QString platformRootPath, QString sourceFile, int revision)
+{
+    QMutexLocker locker(&m_requestLock);
+    m_pendingRequest.code = code;
+    m_pendingRequest.platformRootPath = platformRootPath;
+    m_pendingRequest.sourceFile = sourceFile;
+    m_pendingRequest.revision = revision;
+    m_pendingRequest.generation = ++m_requestGeneration;
+    m_requestPending = true;
+    m_requestReady.wakeAll();
+}
+
+QString CodeModel::getAnalysisSourceFile()
+{
+    return snapshot()->sourceFile;
+}
+
+int CodeModel::getAnalysisRevision()
+{
+    return snapshot()->revision;
+}
+
+std::shared_ptr<const CodeModel::Snapshot> CodeModel::snapshot() const
+{
+    return std::atomic_load(&m_snapshot);
+}
+
+void CodeModel::analysisLoop()
+{
+    while (true) {
+        m_requestLock.lock();
+        while (!m_requestPending && !m_stopping) {
+            m_requestReady.wait(&m_requestLock);
+        }
+        if (m_stopping) {
+            m_requestLock.unlock();
+            return;
+        }
+        AnalysisRequest request = m_pendingRequest;
+        m_requestPending = false;
+        m_requestLock.unlock();
+
+        std::shared_ptr<Snapshot> results = analyze(request);
+        if (results && !isSuperseded(request)) {
+            std::atomic_store(&m_snapshot, std::shared_ptr<const Snapshot>(results));
+            emit analysisUpdated();
+        }
+    }
 }
 
-void CodeModel::updateCodeAnalysis(QString code, QString platformRootPath, QString sourceFile)
+std::shared_ptr<CodeModel::Snapshot> CodeModel::analyze(const AnalysisRequest &request)
 {
-    QMutexLocker locker(&m_validTreeLock);
     QTemporaryFile tmpFile;
-    if (tmpFile.open()) {
-        tmpFile.write(code.toLocal8Bit());
-        tmpFile.close();
-        ASTNode tree;
-        tree = AST::parseFile(tmpFile.fileName().toLocal8Bit().constData(),
-                              sourceFile.toLocal8Bit().constData());
-
-        if (tree) {
-            CodeValidator validator(platformRootPath, tree);
-            m_system = validator.getSystem();
-            vector<ASTNode> objects;
-            if (m_system) {
-                m_types = m_system->getPlatformTypeNames();
-                m_funcs = m_system->getFunctionNames();
-                objects = m_system->getBuiltinObjectsReference()[""];
-            }
-            m_objectNames.clear();
-            for(ASTNode platObject : objects) {
-                if (platObject->getNodeType() == AST::Block) {
-                    m_objectNames << QString::fromStdString(static_cast<BlockNode *>(platObject.get())->getName());
-                }
-            }
-            m_errors = validator.getErrors();
+    if (!tmpFile.open()) {
+        return nullptr;
+    }
+    tmpFile.write(request.code.toLocal8Bit());
+    tmpFile.close();
+    ASTNode tree;
+    tree = AST::parseFile(tmpFile.fileName().toLocal8Bit().constData(),
+                          request.sourceFile.toLocal8Bit().constData());
+    if (isSuperseded(request)) {
+        return nullptr;
+    }
 
-            if(m_lastValidTree) {
+    // Symbols from the previous analysis are kept when the code doesn't parse
+    std::shared_ptr<Snapshot> results = std::make_shared<Snapshot>(*snapshot());
+    results->sourceFile = request.sourceFile;
+    results->revision = request.revision;
+    if (tree) {
+        CodeValidator validator(request.platformRootPath, tree);
+        results->system = validator.getSystem();
+        vector<ASTNode> objects;
+        if (results->system) {
+            results->types = results->system->getPlatformTypeNames();
+            results->funcs = results->system->getFunctionNames();
+            objects = results->system->getBuiltinObjectsReference()[""];
+        }
+        results->objectNames.clear();
+        for(ASTNode platObject : objects) {
+            if (platObject->getNodeType() == AST::Block) {
+                results->objectNames << QString::fromStdString(static_cast<BlockNode *>(platObject.get())->getName());
             }
-            m_lastValidTree = tree;
-        } else { // !tree
-            vector<LangError> syntaxErrors = AST::getParseErrors();
-            m_errors.clear();
-            for (unsigned int i = 0; i < syntaxErrors.size(); i++) {
-                m_errors << syntaxErrors[i];
+        }
+        results->errors = validator.getErrors();
+        results->lastValidTree = tree;
+        if (isSuperseded(request)) {
+            return nullptr;
+        }
+        results->symbols = buildSymbolIndex(results->system, tree, results->funcs, results->types);
+    } else { // !tree
+        vector<LangError> syntaxErrors = AST::getParseErrors();
+        results->errors.clear();
+        for (unsigned int i = 0; i < syntaxErrors.size(); i++) {
+            results->errors << syntaxErrors[i];
+        }
+    }
+    return results;
+}
+
+SymbolIndex CodeModel::buildSymbolIndex(std::shared_ptr<StrideSystem> system, ASTNode tree,
+                                        QStringList functionNames, QStringList typeNames)
+{
+    // Declarations of unqualified names in the order findDeclaration() looks
+    // for them: library namespaces first, then the tree.
+    QHash<QString, std::shared_ptr<DeclarationNode>> declarations;
+    vector<ASTNode> nodes;
+    if (system) {
+        map<string, vector<ASTNode>> objects = system->getBuiltinObjectsReference();
+        for (auto it = objects.begin(); it != objects.end(); it++ ) {
+            nodes.insert(nodes.end(), it->second.begin(), it->second.end());
+        }
+    }
+    vector<ASTNode> treeNodes = tree->getChildren();
+    nodes.insert(nodes.end(), treeNodes.begin(), treeNodes.end());
+    for (ASTNode node : nodes) {
+        if ((node->getNodeType() == AST::Declaration || node->getNodeType() == AST::BundleDeclaration)
+                && node->getScopeLevels() == 0) {
+            std::shared_ptr<DeclarationNode> declaration = static_pointer_cast<DeclarationNode>(node);
+            QString name = QString::fromStdString(declaration->getName());
+            if (!declarations.contains(name)) {
+                declarations[name] = declaration;
             }
         }
     }
+
+    SymbolIndex symbols;
+    for (QString functionName : functionNames) {
+        symbols.addSymbol(functionName, SymbolIndex::Function,
+                          functionSyntax(functionName, declarations.value(functionName)));
+    }
+    for (QString typeName : typeNames) {
+        QList<LangError> errors;
+        std::shared_ptr<DeclarationNode> declaration = CodeValidator::findTypeDeclarationByName(typeName.toStdString(), QVector<ASTNode>(), tree, errors);
+        symbols.addSymbol(typeName, SymbolIndex::Type, typeSyntax(typeName, declaration));
+    }
+    symbols.build();
+    return symbols;
+}
+
+bool CodeModel::isSuperseded(const AnalysisRequest &request) const
+{
+    return request.generation != m_requestGeneration;
 }
@@ -35,11 +35,18 @@
 #ifndef CODEMODEL_HPP
 #define CODEMODEL_HPP
 
+#include <atomic>
+#include <memory>
+#include <thread>
+
 #include <QObject>
 #include <QMutex>
+#include <QWaitCondition>
 
 #include "ast.h"
+#include "declarationnode.h"
 #include "stridesystem.hpp"
+#include "symbolindex.hpp"
 
 class CodeModel : public QObject
 {
@@ -53,7 +60,7 @@ public:
     QString getTooltipText(QString symbol);
     QPair<QString, int> getSymbolLocation(QString symbol);
 
-    std::shared_ptr<StrideSystem> getSystem() { return m_system; }
+    std::shared_ptr<StrideSystem> getSystem();
 
     // Copy of current tree, it is safe to use outside CodeModel
     // But the caller must clean it up.
@@ -66,22 +73,62 @@ public:
     QStringList getObjectNames();
     QString getFunctionSyntax(QString symbol);
     QString getTypeSyntax(QString symbol);
+    QVector<SymbolIndex::Symbol> getCompletions(QString prefix, SymbolIndex::Kind kind);
     QList<LangError> getErrors();
-    void updateCodeAnalysis(QString code, QString platformRootPath, QString sourceFile);
+
+    // Analysis runs in a background thread. A request replaces any request
+    // that has not started, and an analysis that is overtaken by a newer
+    // request is abandoned without publishing its results.
+    void requestCodeAnalysis(QString code, QString platformRootPath, QString sourceFile, int revision);
+    QString getAnalysisSourceFile();
+    int getAnalysisRevision();
 
 signals:
+    void analysisUpdated(); // Emitted from the analysis thread
 
 public slots:
 
 private:
+    // Results of one analysis. A snapshot is not modified once published, so
+    // readers take a reference to the current one and never wait for the
+    // analysis thread.
+    struct Snapshot {
+        QString sourceFile;
+        int revision {-1};
+        std::shared_ptr<StrideSystem> system;
+        QStringList types;
+        QStringList funcs;
+        QStringList objectNames;
+        QList<LangError> errors;
+        ASTNode lastValidTree;
+        SymbolIndex symbols;
+    };
+    struct AnalysisRequest {
+        QString code;
+        QString platformRootPath;
+        QString sourceFile;
+        int revision;
+        unsigned int generation;
+    };
+
+    std::shared_ptr<const Snapshot> snapshot() const;
+    void analysisLoop();
+    std::shared_ptr<Snapshot> analyze(const AnalysisRequest &request);
+    bool isSuperseded(const AnalysisRequest &request) const;
+    static SymbolIndex buildSymbolIndex(std::shared_ptr<StrideSystem> system, ASTNode tree,
+                                        QStringList functionNames, QStringList typeNames);
+    static QString functionSyntax(QString symbol, std::shared_ptr<DeclarationNode> declaration);
+    static QString typeSyntax(QString symbol, std::shared_ptr<DeclarationNode> declaration);
+
 //    QList<AST *> m_platformObjects;
-    std::shared_ptr<StrideSystem> m_system;
-    QStringList m_types;
-    QStringList m_funcs;
-    QStringList m_objectNames;
-    QList<LangError> m_errors;
-    QMutex m_validTreeLock;
-    ASTNode m_lastValidTree;
+    std::shared_ptr<const Snapshot> m_snapshot; //< Only accessed through std::atomic_load/atomic_store
+    QMutex m_requestLock;
+    QWaitCondition m_requestReady;
+    AnalysisRequest m_pendingRequest;
+    bool m_requestPending;
+    bool m_stopping;
+    std::atomic<unsigned int> m_requestGeneration;
+    std::thread m_analysisThread;
 };
 
 #endif // CODEMODEL_HPP
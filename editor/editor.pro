@@ -26,7 +26,8 @@ SOURCES += main.cpp\
     searchwidget.cpp \
     tooltip.cpp \
     codemodel.cpp \
-    autocompletemenu.cpp
+    autocompletemenu.cpp \
+    symbolindex.cpp
 
 HEADERS  += \
     projectwindow.h \
@@ -41,7 +42,8 @@ HEADERS  += \
     searchwidget.h \
     tooltip.hpp \
     codemodel.hpp \
-    autocompletemenu.hpp
+    autocompletemenu.hpp \
+    symbolindex.hpp
 
 FORMS    += \
     projectwindow.ui \
@@ -43,109 +43,91 @@ LanguageHighlighter::LanguageHighlighter(QObject *parent) :
     QSyntaxHighlighter(parent)
 {
     setFormatPreset(0);
-    m_keywords << "none" << "on" << "off" << "streamRate"
-               << "use" << "version" << "import";
+    // Keywords from lang_stride.l
+    m_keywords << "use" << "version" << "with" << "import" << "as" << "for"
+               << "none" << "on" << "off" << "and" << "or" << "not"
+               << "streamRate";
 }
 
 void LanguageHighlighter::highlightBlock(const QString &text)
 {
     QMutexLocker locker(&m_highlighterLock);
 
-    QRegExp expression;
-    QString pattern;
-    int index;
-
-    // Properties/ports
-    pattern ="(([a-z][a-zA-Z0-9_]*)[\\s]*:)";
-    expression.setPattern(pattern);
-    index = text.indexOf(expression);
-    while (index >= 0) {
-        int length = expression.matchedLength();
-        setFormat(index, length, m_formats["ports"]);
-        index = text.indexOf(expression, index + length);
+    // Single pass over the line following the token classes of the lexer
+    setCurrentBlockState(NoState);
+    int index = 0;
+    if (previousBlockState() == InDoubleQuotedString) {
+        index = highlightString(text, 0, '"', false);
+    } else if (previousBlockState() == InSingleQuotedString) {
+        index = highlightString(text, 0, '\'', false);
     }
-
-    foreach(QString keyword, m_keywords) {
-        pattern = QString("\\b%1\\b").arg(keyword);
-        expression.setPattern(pattern);
-        index = text.indexOf(expression);
-        while (index >= 0) {
-            int length = expression.matchedLength();
-            setFormat(index, length, m_formats["keywords"]);
-            index = text.indexOf(expression, index + length);
-        }
-    }
-
-    foreach(QString blockType, m_blockTypes) {
-        pattern = QString("\\b%1\\b").arg(blockType);
-        expression.setPattern(pattern);
-        index = text.indexOf(expression);
-        while (index >= 0) {
-            int length = expression.matchedLength();
-            setFormat(index, length, m_formats["type"]);
-            index = text.indexOf(expression, index + length);
+    while (index < text.size()) {
+        QChar c = text.at(index);
+        if (c == '#') {
+            setFormat(index, text.size() - index, m_formats["comments"]);
+            break;
+        } else if (c == '"' || c == '\'') {
+            index = highlightString(text, index, c, true);
+        } else if (c.isLetter() || c == '_') {
+            int start = index;
+            while (index < text.size()
+                   && (text.at(index).isLetterOrNumber() || text.at(index) == '_')) {
+                index++;
+            }
+            QTextCharFormat format = identifierFormat(text, start, index - start);
+            if (format.isValid()) {
+                setFormat(start, index - start, format);
+            }
+        } else if (c.isDigit()) {
+            // Skip numbers so their digits are not taken as identifiers
+            while (index < text.size()
+                   && (text.at(index).isLetterOrNumber() || text.at(index) == '_' || text.at(index) == '.')) {
+                index++;
+            }
+        } else if (c == '>' && index + 1 < text.size() && text.at(index + 1) == '>') {
+            setFormat(index, 2, m_formats["streamOp"]);
+            index += 2;
+        } else {
+            index++;
         }
     }
+}
 
-    foreach(QString objectName, m_builtinNames) {
-        pattern = QString("\\b%1\\b").arg(objectName);
-        expression.setPattern(pattern);
-        index = text.indexOf(expression);
-        while (index >= 0) {
-            int length = expression.matchedLength();
-            setFormat(index, length, m_formats["builtin"]);
-            index = text.indexOf(expression, index + length);
+QTextCharFormat LanguageHighlighter::identifierFormat(const QString &text, int start, int length)
+{
+    QString word = text.mid(start, length);
+    if (m_functionNames.contains(word)) {
+        return m_formats["function"];
+    } else if (m_builtinNames.contains(word)) {
+        return m_formats["builtin"];
+    } else if (m_blockTypes.contains(word)) {
+        return m_formats["type"];
+    } else if (m_keywords.contains(word)) {
+        return m_formats["keywords"];
+    } else if (word.at(0).isLower()) {
+        // Properties/ports
+        int next = start + length;
+        while (next < text.size() && text.at(next).isSpace()) {
+            next++;
         }
-    }
-
-    foreach(QString functionName, m_functionNames) {
-        pattern = QString("\\b%1\\b").arg(functionName);
-        expression.setPattern(pattern);
-        index = text.indexOf(expression);
-        while (index >= 0) {
-            int length = expression.matchedLength();
-            setFormat(index, length, m_formats["function"]);
-            index = text.indexOf(expression, index + length);
+        if (next < text.size() && text.at(next) == ':') {
+            return m_formats["ports"];
         }
     }
+    return QTextCharFormat();
+}
 
-    pattern = ">>";
-    expression.setPattern(pattern);
-    index = text.indexOf(expression);
-    while (index >= 0) {
-        int length = expression.matchedLength();
-        setFormat(index, length, m_formats["streamOp"]);
-        index = text.indexOf(expression, index + length);
-    }
-
-    pattern = "\\\"(\\.|[^\"])*\\\"";
-    expression.setPattern(pattern);
-    index = text.indexOf(expression);
-    while (index >= 0) {
-        int length = expression.matchedLength();
-        setFormat(index, length, m_formats["strings"]);
-        index = text.indexOf(expression, index + length);
-    }
-
-    pattern = "'(\\.|[^'])*'";
-    expression.setPattern(pattern);
-    index = text.indexOf(expression);
-    while (index >= 0) {
-        int length = expression.matchedLength();
-        setFormat(index, length, m_formats["strings"]);
-        index = text.indexOf(expression, index + length);
-    }
-
-
-    // Leave comments for last
-    pattern = "\\#.*";
-    expression.setPattern(pattern);
-    index = text.indexOf(expression);
-    while (index >= 0) {
-        int length = expression.matchedLength();
-        setFormat(index, length, m_formats["comments"]);
-        index = text.indexOf(expression, index + length);
+int LanguageHighlighter::highlightString(const QString &text, int start, QChar quote, bool opening)
+{
+    // Strings have no escapes, so they end at the next matching quote
+    int end = text.indexOf(quote, opening ? start + 1 : start);
+    if (end < 0) {
+        setFormat(start, text.size() - start, m_formats["strings"]);
+        setCurrentBlockState(quote == '"' ? InDoubleQuotedString : InSingleQuotedString);
+        return text.size();
     }
+    setFormat(start, end + 1 - start, m_formats["strings"]);
+    return end + 1;
 }
 
 QMap<QString, QTextCharFormat> LanguageHighlighter::formats()
@@ -164,27 +146,38 @@ void LanguageHighlighter::setFormats(const QMap<QString, QTextCharFormat> &forma
 
 void LanguageHighlighter::setBlockTypes(QStringList blockTypes)
 {
+    QSet<QString> names = QSet<QString>::fromList(blockTypes);
     m_highlighterLock.lock();
-    m_blockTypes = blockTypes;
+    bool changed = names != m_blockTypes;
+    m_blockTypes = names;
     m_highlighterLock.unlock();
-    rehighlight();
+    if (changed) { // Every analysis sets the names again
+        rehighlight();
+    }
 }
 
 void LanguageHighlighter::setFunctions(QStringList functionNames)
 {
+    QSet<QString> names = QSet<QString>::fromList(functionNames);
     m_highlighterLock.lock();
-    m_functionNames = functionNames;
+    bool changed = names != m_functionNames;
+    m_functionNames = names;
     m_highlighterLock.unlock();
-    rehighlight();
-
+    if (changed) {
+        rehighlight();
+    }
 }
 
 void LanguageHighlighter::setBuiltinObjects(QStringList builtinNames)
 {
+    QSet<QString> names = QSet<QString>::fromList(builtinNames);
     m_highlighterLock.lock();
-    m_builtinNames = builtinNames;
+    bool changed = names != m_builtinNames;
+    m_builtinNames = names;
     m_highlighterLock.unlock();
-    rehighlight();
+    if (changed) {
+        rehighlight();
+    }
 }
 
 void LanguageHighlighter::setFormatPreset(int index)
@@ -37,6 +37,7 @@
 
 #include <QSyntaxHighlighter>
 #include <QMap>
+#include <QSet>
 #include <QMutex>
 
 class LanguageHighlighter : public QSyntaxHighlighter
@@ -63,11 +64,21 @@ signals:
 public slots:
 
 private:
+    // Block states. Strings can span several lines.
+    enum {
+        NoState = -1,
+        InDoubleQuotedString = 1,
+        InSingleQuotedString = 2
+    };
+
+    QTextCharFormat identifierFormat(const QString &text, int start, int length);
+    int highlightString(const QString &text, int start, QChar quote, bool opening);
+
     QMap<QString, QTextCharFormat> m_formats;
-    QStringList m_keywords;
-    QStringList m_blockTypes;
-    QStringList m_functionNames;
-    QStringList m_builtinNames;
+    QSet<QString> m_keywords;
+    QSet<QString> m_blockTypes;
+    QSet<QString> m_functionNames;
+    QSet<QString> m_builtinNames;
     QMutex m_highlighterLock;
 };
 
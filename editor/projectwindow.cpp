@@ -79,6 +79,7 @@ ProjectWindow::ProjectWindow(QWidget *parent) :
     setWindowTitle("StrideIDE");
     updateMenus();
     m_highlighter = new LanguageHighlighter(this);
+    connect(&m_codeModel, SIGNAL(analysisUpdated()), this, SLOT(applyCodeAnalysis()));
 
     readSettings();
 
@@ -154,7 +155,7 @@ bool ProjectWindow::build()
     if (tree) {
         SystemConfiguration systemConfig = readProjectConfiguration();
         CodeValidator validator(m_environment["platformRootPath"].toString(), tree,
-                CodeValidator::NO_OPTIONS, systemConfig);
+                CodeValidator::ELIMINATE_DEAD_CODE, systemConfig);
         errors << validator.getErrors();
 
         if (errors.size() > 0) {
@@ -895,14 +896,9 @@ void ProjectWindow::updateCodeAnalysis(bool force)
     if ((QApplication::activeWindow() == this  && editor->changedSinceParse())
             || m_startingUp || force) {
         editor->markParsed();
-        m_codeModel.updateCodeAnalysis(editor->document()->toPlainText(),
-                                       m_environment["platformRootPath"].toString(),
-                editor->filename());
-        m_highlighter->setBlockTypes(m_codeModel.getTypes());
-        m_highlighter->setFunctions(m_codeModel.getFunctions());
-        m_highlighter->setBuiltinObjects(m_codeModel.getObjectNames());
-        editor->setErrors(m_codeModel.getErrors());
-        fillInspectorTree();
+        m_codeModel.requestCodeAnalysis(editor->document()->toPlainText(),
+                                        m_environment["platformRootPath"].toString(),
+                editor->filename(), editor->document()->revision());
     }
     QPoint position = editor->mapFromGlobal(QCursor::pos());
     position.rx() -= editor->lineNumberAreaWidth();
@@ -914,6 +910,23 @@ void ProjectWindow::updateCodeAnalysis(bool force)
     m_codeModelTimer.start();
 }
 
+void ProjectWindow::applyCodeAnalysis()
+{
+    CodeEditor *editor = static_cast<CodeEditor *>(ui->tabWidget->currentWidget());
+    if (!editor || m_codeModel.getAnalysisSourceFile() != editor->filename()) {
+        return; // Analysis of a tab that is no longer current
+    }
+    m_highlighter->setBlockTypes(m_codeModel.getTypes());
+    m_highlighter->setFunctions(m_codeModel.getFunctions());
+    m_highlighter->setBuiltinObjects(m_codeModel.getObjectNames());
+    // Error lines are only valid for the text that was analyzed. If the text
+    // has changed since, the next analysis will update them.
+    if (m_codeModel.getAnalysisRevision() == editor->document()->revision()) {
+        editor->setErrors(m_codeModel.getErrors());
+    }
+    fillInspectorTree();
+}
+
 void ProjectWindow::connectActions()
 {
 
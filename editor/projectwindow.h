@@ -71,6 +71,7 @@ public slots:
     void openGeneratedDir();
     void cleanProject();
     void updateCodeAnalysis(bool force = false);
+    void applyCodeAnalysis();
     void newFile();
     void markModified();
     void configureSystem();
@@ -0,0 +1,122 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#include <algorithm>
+
+#include "symbolindex.hpp"
+
+void SymbolIndex::addSymbol(QString name, Kind kind, QString syntax)
+{
+    m_symbols.append(Symbol{name, kind, syntax});
+}
+
+void SymbolIndex::build()
+{
+    std::stable_sort(m_symbols.begin(), m_symbols.end(), [](const Symbol &a, const Symbol &b) {
+        return a.name < b.name;
+    });
+    m_trigrams.clear();
+    for (int i = 0; i < m_symbols.size(); i++) {
+        QString name = m_symbols[i].name.toLower();
+        for (int start = 0; start + 3 <= name.size(); start++) {
+            QVector<int> &postings = m_trigrams[name.mid(start, 3)];
+            if (postings.isEmpty() || postings.back() != i) {
+                postings.append(i);
+            }
+        }
+    }
+}
+
+const SymbolIndex::Symbol *SymbolIndex::findSymbol(QString name, Kind kind) const
+{
+    auto it = std::lower_bound(m_symbols.begin(), m_symbols.end(), name, [](const Symbol &symbol, const QString &name) {
+        return symbol.name < name;
+    });
+    for (; it != m_symbols.end() && it->name == name; it++) {
+        if (it->kind == kind) {
+            return &(*it);
+        }
+    }
+    return nullptr;
+}
+
+QVector<SymbolIndex::Symbol> SymbolIndex::complete(QString prefix, Kind kind, int maxResults) const
+{
+    QVector<Symbol> matches;
+    if (prefix.isEmpty()) {
+        return matches;
+    }
+    auto first = std::lower_bound(m_symbols.begin(), m_symbols.end(), prefix, [](const Symbol &symbol, const QString &prefix) {
+        return symbol.name < prefix;
+    });
+    for (auto it = first; it != m_symbols.end() && it->name.startsWith(prefix)
+         && matches.size() < maxResults; it++) {
+        addMatch(it - m_symbols.begin(), kind, matches, maxResults);
+    }
+
+    // Names containing the query. Candidates come from the rarest trigram of
+    // the query and are then checked in full. Shorter queries have no
+    // trigram and only complete prefixes.
+    QString query = prefix.toLower();
+    if (query.size() < 3) {
+        return matches;
+    }
+    const QVector<int> *candidates = nullptr;
+    for (int start = 0; start + 3 <= query.size(); start++) {
+        auto postings = m_trigrams.constFind(query.mid(start, 3));
+        if (postings == m_trigrams.constEnd()) {
+            return matches; // No name has this trigram
+        }
+        if (!candidates || postings->size() < candidates->size()) {
+            candidates = &postings.value();
+        }
+    }
+    for (int i : *candidates) {
+        if (matches.size() >= maxResults) {
+            break;
+        }
+        if (m_symbols[i].name.contains(query, Qt::CaseInsensitive)
+                && !m_symbols[i].name.startsWith(prefix)) {
+            addMatch(i, kind, matches, maxResults);
+        }
+    }
+    return matches;
+}
+
+void SymbolIndex::addMatch(int symbolIndex, Kind kind, QVector<Symbol> &matches, int maxResults) const
+{
+    if (matches.size() < maxResults && m_symbols[symbolIndex].kind == kind) {
+        matches.append(m_symbols[symbolIndex]);
+    }
+}
@@ -0,0 +1,75 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#ifndef SYMBOLINDEX_HPP
+#define SYMBOLINDEX_HPP
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+
+// Index of the symbols offered by autocomplete. Symbols are kept sorted by
+// name so prefix queries are a binary search, and the trigrams of their
+// lower case names are indexed to find names containing a query.
+class SymbolIndex
+{
+public:
+    typedef enum {
+        Function,
+        Type
+    } Kind;
+
+    struct Symbol {
+        QString name;
+        Kind kind;
+        QString syntax; // Text inserted when completing
+    };
+
+    void addSymbol(QString name, Kind kind, QString syntax);
+    // Must be called after adding symbols and before querying
+    void build();
+
+    const Symbol *findSymbol(QString name, Kind kind) const;
+    // Symbols that start with prefix, followed by symbols that contain it
+    // ignoring case when prefix has at least 3 characters.
+    QVector<Symbol> complete(QString prefix, Kind kind, int maxResults = 50) const;
+
+private:
+    void addMatch(int symbolIndex, Kind kind, QVector<Symbol> &matches, int maxResults) const;
+
+    QVector<Symbol> m_symbols;
+    QHash<QString, QVector<int>> m_trigrams;
+};
+
+#endif // SYMBOLINDEX_HPP
@@ -33,24 +33,75 @@
 */
 
 #include <cassert>
+#include <map>
+#include <mutex>
+#include <unordered_map>
 
 #include "ast.h"
 
 extern AST *parse(const char* fileName, const char* sourceFilename);
 extern std::vector<LangError> getErrors();
 
+namespace {
+
+std::mutex &internMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+// Entries for nodes without a file or namespace. Kept so these nodes, which
+// include every copy before copyLocation(), don't need the tables' lock.
+const ASTSourceFile *noSourceFile()
+{
+    static const ASTSourceFile *file = AST::internSourceFile(string());
+    return file;
+}
+
+const ASTNamespace *noNamespace()
+{
+    static const ASTNamespace *path = AST::internNamespace(vector<string>());
+    return path;
+}
+
+} // namespace
+
+const ASTSourceFile *AST::internSourceFile(const string &filename)
+{
+    static std::unordered_map<string, std::unique_ptr<ASTSourceFile>> files;
+    std::lock_guard<std::mutex> locker(internMutex());
+    std::unique_ptr<ASTSourceFile> &file = files[filename];
+    if (!file) {
+        file.reset(new ASTSourceFile{(unsigned int) files.size() - 1, filename});
+    }
+    return file.get();
+}
+
+const ASTNamespace *AST::internNamespace(const vector<string> &names)
+{
+    static std::map<vector<string>, std::unique_ptr<ASTNamespace>> namespaces;
+    std::lock_guard<std::mutex> locker(internMutex());
+    std::unique_ptr<ASTNamespace> &path = namespaces[names];
+    if (!path) {
+        path.reset(new ASTNamespace{(unsigned int) namespaces.size() - 1, names});
+    }
+    return path.get();
+}
+
 AST::AST()
 {
     m_token = AST::None;
     m_line = -1;
+    m_file = noSourceFile();
+    m_scope = noNamespace();
 }
 
 AST::AST(Token token, const char *filename, int line, vector<string> scope)
 {
     m_token = token;
-    m_filename.append(filename);
     m_line = line;
-    m_scope = scope;
+    m_file = filename && filename[0] ? internSourceFile(filename) : noSourceFile();
+    m_scope = scope.size() > 0 ? internNamespace(scope) : noNamespace();
 }
 
 AST::~AST()
@@ -74,6 +125,7 @@ void AST::setChildren(vector<ASTNode> &newChildren)
 {
 //    deleteChildren();
     m_children = newChildren;
+    m_childrenRevision++;
 }
 
 //void AST::deleteChildren()
@@ -87,7 +139,8 @@ void AST::setChildren(vector<ASTNode> &newChildren)
 
 ASTNode AST::deepCopy()
 {
-    ASTNode newNode = std::make_shared<AST>(AST::None, m_filename.data(), m_line, m_scope);
+    std::shared_ptr<AST> newNode = std::make_shared<AST>(AST::None, nullptr, m_line);
+    newNode->copyLocation(*this);
     for(unsigned int i = 0; i < m_children.size(); i++) {
         newNode->addChild(m_children.at(i)->deepCopy());
     }
@@ -96,6 +149,10 @@ ASTNode AST::deepCopy()
 
 ASTNode AST::parseFile(const char *fileName, const char* sourceFilename)
 {
+    // The generated parser is not reentrant. Errors are kept per thread, so
+    // getParseErrors() returns the errors of the caller's last parse.
+    static std::mutex parserMutex;
+    std::lock_guard<std::mutex> locker(parserMutex);
     return std::shared_ptr<AST>(parse(fileName, sourceFilename));
 }
 
@@ -104,14 +161,9 @@ vector<LangError> AST::getParseErrors()
     return getErrors();
 }
 
-string AST::getFilename() const
-{
-    return m_filename;
-}
-
 void AST::setFilename(const string &filename)
 {
-    m_filename = filename;
+    m_file = internSourceFile(filename);
 }
 
 void AST::resolveScope(ASTNode scope)
@@ -122,35 +174,29 @@ void AST::resolveScope(ASTNode scope)
 
 void AST::addScope(string newScope)
 {
-    m_scope.push_back(newScope);
+    vector<string> names = m_scope->names;
+    names.push_back(newScope);
+    m_scope = internNamespace(names);
 }
 
 void AST::setRootScope(string scopeName)
 {
     if (scopeName != "") {
-        if (m_scope.size() == 0 || m_scope.at(0) != scopeName) {
-            m_scope.insert(m_scope.begin(), scopeName);
+        if (m_scope->names.size() == 0 || m_scope->names.at(0) != scopeName) {
+            vector<string> names = m_scope->names;
+            names.insert(names.begin(), scopeName);
+            m_scope = internNamespace(names);
         }
     }
 }
 
-
-size_t AST::getScopeLevels()
-{
-    return m_scope.size();
-}
-
-string AST::getScopeAt(unsigned int scopeLevel)
-{
-    return m_scope.at(scopeLevel);
-}
-
-vector<string> AST::getNamespaceList()
+void AST::setNamespaceList(vector<string> list)
 {
-    return m_scope;
+    m_scope = internNamespace(list);
 }
 
-void AST::setNamespaceList(vector<string> list)
+void AST::copyLocation(const AST &other)
 {
-    m_scope = list;
+    m_file = other.m_file;
+    m_scope = other.m_scope;
 }
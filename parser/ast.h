@@ -36,6 +36,8 @@
 #define AST_H
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "langerror.h"
 
@@ -45,6 +47,20 @@ class AST;
 
 typedef shared_ptr<AST> ASTNode;
 
+// Source files and namespace paths are interned in tables shared by all
+// nodes. Entries are never removed or modified, so nodes can keep pointers
+// to them and two nodes are in the same file or namespace when they point
+// to the same entry.
+struct ASTSourceFile {
+    unsigned int id;
+    string name;
+};
+
+struct ASTNamespace {
+    unsigned int id;
+    vector<string> names;
+};
+
 class AST
 {
 public:
@@ -80,6 +96,8 @@ public:
         Invalid
     } Token;
 
+    /// filename can be nullptr for nodes that get their location from
+    /// copyLocation().
     AST(Token token, const char *filename, int line = -1, vector<string> scope = vector<string>());
     virtual ~AST();
 
@@ -89,7 +107,11 @@ public:
     bool isNil() { return m_token == AST::None; }
 
     vector<ASTNode> getChildren() const {return m_children;}
+    size_t getChildCount() const {return m_children.size();}
     virtual void setChildren(vector<ASTNode> &newChildren);
+    /// Changes every time the children are replaced. Appending children
+    /// with addChild() only changes getChildCount().
+    unsigned int getChildrenRevision() const {return m_childrenRevision;}
 
     int getLine() const {return m_line;}
 
@@ -101,25 +123,34 @@ public:
     static ASTNode parseFile(const char *fileName, const char* sourceFilename = nullptr);
     static vector<LangError> getParseErrors();
 
-    string getFilename() const;
+    const string &getFilename() const { return m_file->name; }
     void setFilename(const string &filename);
+    unsigned int getFileId() const { return m_file->id; }
 
     void addScope(string newScope);
     void setRootScope(string scopeName);
-    size_t getScopeLevels();
-    string getScopeAt(unsigned int scopeLevel);
+    size_t getScopeLevels() const { return m_scope->names.size(); }
+    const string &getScopeAt(unsigned int scopeLevel) const { return m_scope->names.at(scopeLevel); }
 
-    vector<string> getNamespaceList();
+    const vector<string> &getNamespaceList() const { return m_scope->names; }
     void setNamespaceList(vector<string> list);
+    /// Nodes with the same namespace id have the same namespace list.
+    unsigned int getNamespaceId() const { return m_scope->id; }
+
+    static const ASTSourceFile *internSourceFile(const string &filename);
+    static const ASTNamespace *internNamespace(const vector<string> &names);
 
 protected:
     virtual void resolveScope(ASTNode scope);
+    /// Shares the file and namespace entries of other, for copies.
+    void copyLocation(const AST &other);
 
     Token m_token; // From which token did we create node?
-    vector<ASTNode> m_children; // normalized list of children
-    string m_filename; // file where the node was generated
     int m_line;
-    vector<string> m_scope;
+    vector<ASTNode> m_children; // normalized list of children
+    const ASTSourceFile *m_file; // file where the node was generated
+    const ASTNamespace *m_scope;
+    unsigned int m_childrenRevision {0};
 };
 
 #endif // AST_H
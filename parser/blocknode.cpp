@@ -60,13 +60,14 @@ void BlockNode::resolveScope(ASTNode scope)
     if (scope) {
         for (unsigned int i = 0; i < scope->getChildren().size(); i++) {
             assert(scope->getChildren().at(i)->getNodeType() == AST::Scope);
-            m_scope.push_back((static_cast<ScopeNode *>(scope->getChildren().at(i).get()))->getName());
+            addScope((static_cast<ScopeNode *>(scope->getChildren().at(i).get()))->getName());
         }
     }
 }
 
 ASTNode BlockNode::deepCopy()
 {
-    std::shared_ptr<BlockNode> newNode = std::make_shared<BlockNode>(m_name, m_filename.data(), m_line, m_scope);
+    std::shared_ptr<BlockNode> newNode = std::make_shared<BlockNode>(m_name, nullptr, m_line);
+    newNode->copyLocation(*this);
     return newNode;
 }
@@ -77,7 +77,7 @@ void BundleNode::resolveScope(ASTNode scope)
     if (scope) {
         for (unsigned int i = 0; i < scope->getChildren().size(); i++) {
             assert(scope->getChildren().at(i)->getNodeType() == AST::Scope);
-            m_scope.push_back((static_cast<ScopeNode *>(scope->getChildren().at(i).get()))->getName());
+            addScope((static_cast<ScopeNode *>(scope->getChildren().at(i).get()))->getName());
         }
     }
 }
@@ -86,10 +86,8 @@ ASTNode BundleNode::deepCopy()
 {
     assert(getNodeType() == AST::Bundle);
     if(getNodeType() == AST::Bundle) {
-        std::shared_ptr<BundleNode> newBundle = std::make_shared<BundleNode>(m_name, static_pointer_cast<ListNode>(index()->deepCopy()), m_filename.data(), m_line);
-        for (unsigned int i = 0; i < this->getScopeLevels(); i++) {
-            newBundle->addScope(this->getScopeAt(i));
-        }
+        std::shared_ptr<BundleNode> newBundle = std::make_shared<BundleNode>(m_name, static_pointer_cast<ListNode>(index()->deepCopy()), nullptr, m_line);
+        newBundle->copyLocation(*this);
         return newBundle;
     }
     assert(0 == 1);
@@ -165,17 +165,18 @@ string DeclarationNode::getObjectType() const
 ASTNode DeclarationNode::deepCopy()
 {
     ASTNode newProps = std::make_shared<AST>();
-    ASTNode node = nullptr;
+    std::shared_ptr<DeclarationNode> node = nullptr;
     for(unsigned int i = 0; i< m_properties.size(); i++) {
         newProps->addChild(m_properties[i]->deepCopy());
     }
     if (getNodeType() == AST::BundleDeclaration) {
         node = std::make_shared<DeclarationNode>(static_pointer_cast<BundleNode>(getBundle()->deepCopy()),
-                             m_objectType, newProps, m_filename.data(), m_line, m_scope);
+                             m_objectType, newProps, nullptr, m_line);
     } else if (getNodeType() == AST::Declaration) {
-        node = std::make_shared<DeclarationNode>(m_name, m_objectType, newProps, m_filename.data(), m_line, m_scope);
+        node = std::make_shared<DeclarationNode>(m_name, m_objectType, newProps, nullptr, m_line);
     }
     assert(node);
+    node->copyLocation(*this);
 //    newProps.reset();
     return node;
 }
@@ -144,11 +144,14 @@ string ExpressionNode::getExpressionTypeString() const
 
 ASTNode ExpressionNode::deepCopy()
 {
+    std::shared_ptr<ExpressionNode> newExpression;
     if (m_type == ExpressionNode::UnaryMinus || m_type == ExpressionNode::LogicalNot) {
-        return std::make_shared<ExpressionNode>(m_type, m_children.at(0)->deepCopy(), m_filename.data(), m_line);
+        newExpression = std::make_shared<ExpressionNode>(m_type, m_children.at(0)->deepCopy(), nullptr, m_line);
     } else {
-        return std::make_shared<ExpressionNode>(m_type, m_children.at(0)->deepCopy(), m_children.at(1)->deepCopy(), m_filename.data(), m_line);
+        newExpression = std::make_shared<ExpressionNode>(m_type, m_children.at(0)->deepCopy(), m_children.at(1)->deepCopy(), nullptr, m_line);
     }
+    newExpression->copyLocation(*this);
+    return newExpression;
 }
 
 
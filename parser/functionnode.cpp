@@ -164,7 +164,7 @@ void FunctionNode::resolveScope(ASTNode scope)
     if (scope) {
         for (unsigned int i = 0; i < scope->getChildren().size(); i++) {
             assert(scope->getChildren().at(i)->getNodeType() == AST::Scope);
-            m_scope.push_back((static_pointer_cast<ScopeNode>(scope->getChildren().at(i)))->getName());
+            addScope((static_pointer_cast<ScopeNode>(scope->getChildren().at(i)))->getName());
         }
     }
 }
@@ -176,10 +176,8 @@ ASTNode FunctionNode::deepCopy()
         newProps->addChild(m_properties[i]->deepCopy());
     }
     std::shared_ptr<FunctionNode> newFunctionNode
-            = std::make_shared<FunctionNode>(m_name, std::shared_ptr<AST>(newProps), m_filename.data(), m_line);
-    for (unsigned int i = 0; i < this->getScopeLevels(); i++) {
-        newFunctionNode->addScope(this->getScopeAt(i));
-    }
+            = std::make_shared<FunctionNode>(m_name, std::shared_ptr<AST>(newProps), nullptr, m_line);
+    newFunctionNode->copyLocation(*this);
     newFunctionNode->setRate(getRate());
     return newFunctionNode;
 }
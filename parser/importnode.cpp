@@ -76,17 +76,15 @@ void ImportNode::resolveScope(ASTNode scope)
     if (scope) {
         for (unsigned int i = 0; i < scope->getChildren().size(); i++) {
             assert(scope->getChildren().at(i)->getNodeType() == AST::Scope);
-            m_scope.push_back((static_cast<ScopeNode *>(scope->getChildren().at(i).get()))->getName());
+            addScope((static_cast<ScopeNode *>(scope->getChildren().at(i).get()))->getName());
         }
     }
 }
 
 ASTNode ImportNode::deepCopy()
 {
-    ASTNode newImportNode = std::make_shared<ImportNode>(m_importName, m_filename.data(), getLine(), m_importAlias);
-    for (unsigned int i = 0; i < this->getScopeLevels(); i++) {
-        newImportNode->addScope(this->getScopeAt(i));
-    }
+    std::shared_ptr<ImportNode> newImportNode = std::make_shared<ImportNode>(m_importName, nullptr, getLine(), m_importAlias);
+    newImportNode->copyLocation(*this);
     return newImportNode;
 }
 
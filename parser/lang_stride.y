@@ -27,7 +27,7 @@ using namespace std;
 
 extern void yyrestart (FILE *input_file );
 
-std::vector<LangError> parseErrors;
+thread_local std::vector<LangError> parseErrors; // Errors from the last parse on this thread
 
 void yyerror(const char *s);
 
@@ -87,6 +87,7 @@ void ListNode::replaceMember(ASTNode replacement, ASTNode member)
     for(unsigned int i = 0; i < m_children.size(); i++) {
         if (m_children.at(i) == member) {
             m_children.at(i) = replacement;
+            m_childrenRevision++;
 //            member->deleteChildren();
 //            member.reset();
             return;
@@ -99,13 +100,14 @@ ASTNode ListNode::deepCopy()
     vector<ASTNode> children = getChildren();
     std::shared_ptr<ListNode> newList;
     if (children.size() > 0) {
-        newList = std::make_shared<ListNode>(children.at(0)->deepCopy(), m_filename.data(), m_line);
+        newList = std::make_shared<ListNode>(children.at(0)->deepCopy(), nullptr, m_line);
         for(unsigned int i = 1; i < children.size(); i++) {
             newList->addChild(children.at(i)->deepCopy());
         }
     } else {
-        newList = std::make_shared<ListNode>(nullptr, m_filename.data(), m_line);
+        newList = std::make_shared<ListNode>(nullptr, nullptr, m_line);
     }
+    newList->copyLocation(*this);
     return newList;
 }
 
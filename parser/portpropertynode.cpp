@@ -48,6 +48,7 @@ PortPropertyNode::~PortPropertyNode()
 
 ASTNode PortPropertyNode::deepCopy()
 {
-    std::shared_ptr<PortPropertyNode> newPortPropertyNode = make_shared<PortPropertyNode>(m_name, m_port, m_filename.data(), m_line);
+    std::shared_ptr<PortPropertyNode> newPortPropertyNode = make_shared<PortPropertyNode>(m_name, m_port, nullptr, m_line);
+    newPortPropertyNode->copyLocation(*this);
     return newPortPropertyNode;
 }
@@ -60,6 +60,8 @@ void PropertyNode::replaceValue(ASTNode newValue)
 
 ASTNode PropertyNode::deepCopy()
 {
-    return std::make_shared<PropertyNode>(m_name, m_children.at(0)->deepCopy(), m_filename.data(), m_line);
+    std::shared_ptr<PropertyNode> newProperty = std::make_shared<PropertyNode>(m_name, m_children.at(0)->deepCopy(), nullptr, m_line);
+    newProperty->copyLocation(*this);
+    return newProperty;
 }
 
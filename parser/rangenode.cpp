@@ -55,8 +55,9 @@ ASTNode RangeNode::endIndex() const
 
 ASTNode RangeNode::deepCopy()
 {
-    ASTNode newRangeNode = std::make_shared<RangeNode>(startIndex(), endIndex(),
-                                         m_filename.data(), m_line);
+    std::shared_ptr<RangeNode> newRangeNode = std::make_shared<RangeNode>(startIndex(), endIndex(),
+                                         nullptr, m_line);
+    newRangeNode->copyLocation(*this);
     return newRangeNode;
 }
 
@@ -135,19 +135,23 @@ bool ValueNode::getSwitchValue() const
 
 ASTNode ValueNode::deepCopy()
 {
+    std::shared_ptr<ValueNode> newValue;
     if (getNodeType() == AST::Int) {
-        return std::make_shared<ValueNode>(getIntValue(), m_filename.c_str(), getLine());
+        newValue = std::make_shared<ValueNode>(getIntValue(), nullptr, getLine());
     } else if (getNodeType() == AST::Real) {
-        return std::make_shared<ValueNode>(getRealValue(), m_filename.c_str(), getLine());
+        newValue = std::make_shared<ValueNode>(getRealValue(), nullptr, getLine());
     } else if (getNodeType() == AST::String) {
-        return std::make_shared<ValueNode>(getStringValue(), m_filename.c_str(), getLine());
+        newValue = std::make_shared<ValueNode>(getStringValue(), nullptr, getLine());
     } else if (getNodeType() == AST::Switch) {
-        return std::make_shared<ValueNode>(getSwitchValue(), m_filename.c_str(), getLine());
+        newValue = std::make_shared<ValueNode>(getSwitchValue(), nullptr, getLine());
     } else if (getNodeType() == AST::None) {
-        return std::make_shared<ValueNode>(m_filename.data(), getLine());
+        newValue = std::make_shared<ValueNode>((const char *) nullptr, getLine());
     }  else {
         assert(0); // Invalid type
+        return nullptr;
     }
+    newValue->copyLocation(*this);
+    return newValue;
 }
 
 
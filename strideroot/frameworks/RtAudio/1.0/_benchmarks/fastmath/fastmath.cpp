@@ -0,0 +1,164 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+// Accuracy and throughput of the StrideMath.h kernels against libm.
+// Build and run from this directory with:
+//   g++ -O3 -fno-trapping-math -std=c++11 -I../../include fastmath.cpp -o fastmath && ./fastmath
+// Results at -O2 are not representative, see StrideMath.h.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "StrideMath.h"
+
+namespace {
+
+const int kBufferSize = 512;
+const int kIterations = 20000;
+
+std::vector<float> make_inputs(double low, double high, int count) {
+    std::vector<float> values(count);
+    for (int i = 0; i < count; i++) {
+        values[i] = static_cast<float>(low + (high - low) * i / (count - 1));
+    }
+    return values;
+}
+
+template<typename Approx, typename Exact>
+double max_error(const std::vector<float> &inputs, Approx approx, Exact exact, bool relative) {
+    double worst = 0.0;
+    for (float x : inputs) {
+        double expected = exact(x);
+        double error = std::fabs(approx(x) - expected);
+        if (relative && expected != 0.0) {
+            error /= std::fabs(expected);
+        }
+        if (error > worst) {
+            worst = error;
+        }
+    }
+    return worst;
+}
+
+// Returns nanoseconds per value
+template<typename Function>
+double time_per_value(const std::vector<float> &inputs, Function function) {
+    std::vector<float> out(kBufferSize);
+    volatile float sink = 0.0f;
+    auto start = std::chrono::steady_clock::now();
+    for (int it = 0; it < kIterations; it++) {
+        function(inputs.data(), out.data(), kBufferSize);
+        sink = sink + out[it % kBufferSize];
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    return ns / (double(kIterations) * kBufferSize);
+}
+
+void report(const char *name, double error, bool relative, double ns, double libm_ns) {
+    std::printf("%-10s max %s error %.3g  %6.2f ns/value  (libm %6.2f ns, x%.1f)\n",
+                name, relative ? "rel" : "abs", error, ns, libm_ns, libm_ns / ns);
+}
+
+} // namespace
+
+int main() {
+    stride_math::init();
+
+    std::vector<float> angles = make_inputs(-1000.0, 1000.0, 2000001);
+    std::vector<float> tan_angles = make_inputs(-1.5, 1.5, 200001);
+    std::vector<float> exponents = make_inputs(-80.0, 80.0, 2000001);
+    std::vector<float> bases = make_inputs(0.001, 1000.0, 2001);
+    std::vector<float> powers = make_inputs(-8.0, 8.0, 1001);
+
+    auto sin_exact = [](float x) { return std::sin(double(x)); };
+    auto cos_exact = [](float x) { return std::cos(double(x)); };
+    auto tan_exact = [](float x) { return std::tan(double(x)); };
+    auto exp_exact = [](float x) { return std::exp(double(x)); };
+
+    double pow_error = 0.0;
+    for (float a : bases) {
+        for (float b : powers) {
+            double expected = std::pow(double(a), double(b));
+            double error = std::fabs(stride_math::pow_checked(a, b) - expected) / expected;
+            if (error > pow_error) {
+                pow_error = error;
+            }
+        }
+    }
+
+    std::vector<float> block = make_inputs(-10.0, 10.0, kBufferSize);
+    double libm_sin = time_per_value(block, [](const float *in, float *out, int n) {
+        for (int i = 0; i < n; i++) out[i] = std::sin(in[i]);
+    });
+    double libm_cos = time_per_value(block, [](const float *in, float *out, int n) {
+        for (int i = 0; i < n; i++) out[i] = std::cos(in[i]);
+    });
+    double libm_tan = time_per_value(block, [](const float *in, float *out, int n) {
+        for (int i = 0; i < n; i++) out[i] = std::tan(in[i]);
+    });
+    double libm_exp = time_per_value(block, [](const float *in, float *out, int n) {
+        for (int i = 0; i < n; i++) out[i] = std::exp(in[i]);
+    });
+    double libm_pow = time_per_value(block, [](const float *in, float *out, int n) {
+        for (int i = 0; i < n; i++) out[i] = std::pow(std::fabs(in[i]) + 0.5f, 2.5f);
+    });
+
+    report("sin_poly", max_error(angles, stride_math::sin_poly, sin_exact, false), false,
+           time_per_value(block, stride_math::sin_poly_n), libm_sin);
+    report("cos_poly", max_error(angles, stride_math::cos_poly, cos_exact, false), false,
+           time_per_value(block, stride_math::cos_poly_n), libm_cos);
+    report("sin_table", max_error(angles, stride_math::sin_table, sin_exact, false), false,
+           time_per_value(block, stride_math::sin_table_n), libm_sin);
+    report("cos_table", max_error(angles, stride_math::cos_table, cos_exact, false), false,
+           time_per_value(block, [](const float *in, float *out, int n) {
+               for (int i = 0; i < n; i++) out[i] = stride_math::cos_table(in[i]);
+           }), libm_cos);
+    report("tan_poly", max_error(tan_angles, stride_math::tan_poly, tan_exact, true), true,
+           time_per_value(block, [](const float *in, float *out, int n) {
+               for (int i = 0; i < n; i++) out[i] = stride_math::tan_poly(in[i]);
+           }), libm_tan);
+    report("exp_poly", max_error(exponents, stride_math::exp_poly, exp_exact, true), true,
+           time_per_value(block, stride_math::exp_poly_n), libm_exp);
+    report("pow_poly", pow_error, true,
+           time_per_value(block, [](const float *in, float *out, int n) {
+               static const std::vector<float> exponents(kBufferSize, 2.5f);
+               float bases[kBufferSize];
+               for (int i = 0; i < n; i++) bases[i] = std::fabs(in[i]) + 0.5f;
+               stride_math::pow_poly_n(bases, exponents.data(), out, n);
+           }), libm_pow);
+    return 0;
+}
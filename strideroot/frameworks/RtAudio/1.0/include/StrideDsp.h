@@ -0,0 +1,259 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#ifndef STRIDEDSP_H
+#define STRIDEDSP_H
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+// Interface for generated code built as a reloadable shared library
+// ("HotReload" in the project configuration). The library exports the C
+// functions below. A persistent host owns the audio device, loads new
+// builds and swaps them in between blocks, carrying state that has the same
+// declaration name and signature across.
+
+#define STRIDE_DSP_ABI_VERSION 1
+
+#define STRIDE_DSP_EXPORT extern "C" __attribute__((visibility("default")))
+
+extern "C" {
+
+typedef struct {
+    const char *name;      // Declaration name
+    const char *signature; // Changes when the declaration's type or layout changes
+    void *data;            // Null if the state can't be copied
+    unsigned long size;
+} StrideDspState;
+
+typedef int (*StrideDspAbiVersionFunction)();
+typedef void (*StrideDspInitFunction)();
+typedef void (*StrideDspProcessFunction)(float *in, float *out, unsigned int nBufferFrames);
+typedef void (*StrideDspCleanupFunction)();
+typedef int (*StrideDspStateSizeFunction)();
+typedef const StrideDspState *(*StrideDspStateFunction)();
+typedef int (*StrideDspMigrateFunction)(const StrideDspState *state, int count);
+
+}
+
+// Entry for a global declaration in the library's state table. Only
+// trivially copyable state is carried across, anything else starts fresh.
+#define STRIDE_DSP_STATE(name, signature) \
+    {#name, signature, std::is_trivially_copyable<decltype(name)>::value ? (void *) &name : nullptr, sizeof(name)}
+
+namespace stride_dsp {
+
+// Copies every entry of 'from' into the entry of 'to' with the same name,
+// signature and size. Returns the number of entries copied.
+inline int migrate(const StrideDspState *to, int toCount,
+                   const StrideDspState *from, int fromCount) {
+    int copied = 0;
+    for (int i = 0; i < toCount; i++) {
+        if (!to[i].data) {
+            continue;
+        }
+        for (int j = 0; j < fromCount; j++) {
+            if (from[j].data && from[j].size == to[i].size
+                    && strcmp(from[j].name, to[i].name) == 0
+                    && strcmp(from[j].signature, to[i].signature) == 0) {
+                memcpy(to[i].data, from[j].data, to[i].size);
+                copied++;
+                break;
+            }
+        }
+    }
+    return copied;
+}
+
+} // namespace stride_dsp
+
+#ifndef STRIDE_DSP_LIBRARY
+#include <dlfcn.h>
+#include <sys/stat.h>
+
+namespace stride_dsp {
+
+// A loaded build of the library
+struct Library {
+    void *handle {nullptr};
+    std::string path;
+    StrideDspInitFunction init {nullptr};
+    StrideDspProcessFunction process {nullptr};
+    StrideDspCleanupFunction cleanup {nullptr};
+    StrideDspStateSizeFunction stateSize {nullptr};
+    StrideDspStateFunction state {nullptr};
+    StrideDspMigrateFunction migrate {nullptr};
+};
+
+// Owned by the host. Reloads are started from the host's main thread with
+// poll(), the swap itself happens in the audio callback between blocks.
+class Host {
+public:
+    Host(const std::string &path) : m_path(path) {}
+    ~Host() {
+        Library *library = m_current.exchange(nullptr);
+        unload(library);
+        unload(m_pending.exchange(nullptr));
+        unload(m_retired.exchange(nullptr));
+    }
+
+    // Called from the audio callback. Swaps in a pending build first, so
+    // state is copied while neither build is processing.
+    void process(float *in, float *out, unsigned int nBufferFrames, unsigned int numOutChannels) {
+        Library *pending = m_pending.exchange(nullptr, std::memory_order_acq_rel);
+        if (pending) {
+            Library *current = m_current.load(std::memory_order_relaxed);
+            if (current) {
+                pending->migrate(current->state(), current->stateSize());
+            }
+            m_current.store(pending, std::memory_order_release);
+            m_retired.store(current, std::memory_order_release);
+        }
+        Library *current = m_current.load(std::memory_order_acquire);
+        if (current) {
+            current->process(in, out, nBufferFrames);
+        } else {
+            memset(out, 0, nBufferFrames * numOutChannels * sizeof(float));
+        }
+    }
+
+    // Called periodically from the main thread. Loads the library again if
+    // it has changed and releases builds that have been swapped out.
+    bool poll() {
+        unload(m_retired.exchange(nullptr, std::memory_order_acq_rel));
+        struct stat info;
+        // New builds are renamed into place, so the inode changes even when
+        // two builds land within the same second
+        if (stat(m_path.c_str(), &info) != 0
+                || (info.st_mtime == m_modified && info.st_ino == m_inode)
+                || m_pending.load(std::memory_order_acquire)) {
+            return false;
+        }
+        m_modified = info.st_mtime;
+        m_inode = info.st_ino;
+        Library *library = load();
+        if (!library) {
+            return false;
+        }
+        library->init();
+        if (!m_current.load(std::memory_order_acquire)) {
+            m_current.store(library, std::memory_order_release);
+        } else {
+            m_pending.store(library, std::memory_order_release);
+        }
+        return true;
+    }
+
+private:
+    Library *load() {
+        // dlopen() returns the already loaded build for a path it has seen,
+        // so each build is loaded from its own copy
+        std::string path = m_path + "." + std::to_string(++m_generation);
+        if (!copyFile(m_path, path)) {
+            fprintf(stderr, "Could not copy %s\n", m_path.c_str());
+            return nullptr;
+        }
+        Library *library = new Library;
+        library->path = path;
+        library->handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (!library->handle) {
+            fprintf(stderr, "Could not load %s: %s\n", path.c_str(), dlerror());
+            remove(path.c_str());
+            delete library;
+            return nullptr;
+        }
+        StrideDspAbiVersionFunction abiVersion = (StrideDspAbiVersionFunction) dlsym(library->handle, "stride_dsp_abi_version");
+        library->init = (StrideDspInitFunction) dlsym(library->handle, "stride_dsp_init");
+        library->process = (StrideDspProcessFunction) dlsym(library->handle, "stride_dsp_process");
+        library->cleanup = (StrideDspCleanupFunction) dlsym(library->handle, "stride_dsp_cleanup");
+        library->stateSize = (StrideDspStateSizeFunction) dlsym(library->handle, "stride_dsp_state_size");
+        library->state = (StrideDspStateFunction) dlsym(library->handle, "stride_dsp_state");
+        library->migrate = (StrideDspMigrateFunction) dlsym(library->handle, "stride_dsp_migrate");
+        if (!abiVersion || abiVersion() != STRIDE_DSP_ABI_VERSION || !library->init
+                || !library->process || !library->cleanup || !library->stateSize
+                || !library->state || !library->migrate) {
+            fprintf(stderr, "Incompatible DSP library %s\n", m_path.c_str());
+            dlclose(library->handle);
+            remove(path.c_str());
+            delete library;
+            return nullptr;
+        }
+        return library;
+    }
+
+    void unload(Library *library) {
+        if (library) {
+            library->cleanup();
+            dlclose(library->handle);
+            remove(library->path.c_str());
+            delete library;
+        }
+    }
+
+    static bool copyFile(const std::string &from, const std::string &to) {
+        FILE *in = fopen(from.c_str(), "rb");
+        if (!in) {
+            return false;
+        }
+        FILE *out = fopen(to.c_str(), "wb");
+        if (!out) {
+            fclose(in);
+            return false;
+        }
+        char buffer[4096];
+        size_t count;
+        while ((count = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+            fwrite(buffer, 1, count, out);
+        }
+        fclose(in);
+        return fclose(out) == 0;
+    }
+
+    const std::string m_path;
+    time_t m_modified {0};
+    ino_t m_inode {0};
+    unsigned int m_generation {0};
+    std::atomic<Library *> m_current {nullptr};
+    std::atomic<Library *> m_pending {nullptr};
+    std::atomic<Library *> m_retired {nullptr};
+};
+
+} // namespace stride_dsp
+
+#endif // STRIDE_DSP_LIBRARY
+
+#endif // STRIDEDSP_H
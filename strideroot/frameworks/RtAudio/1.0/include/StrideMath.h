@@ -0,0 +1,317 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#ifndef STRIDEMATH_H
+#define STRIDEMATH_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+// Math kernels used by the RtAudio platform types.
+//
+// STRIDE_FAST_MATH selects the implementation behind stride_math::sin() and
+// friends. It is set from the "FastMath" entry in the project configuration:
+//   STRIDE_FAST_MATH_OFF   (default) std:: functions, full libm precision.
+//   STRIDE_FAST_MATH_POLY  polynomial kernels for every function.
+//   STRIDE_FAST_MATH_TABLE interpolated table for sin/cos, polynomials for
+//                          the rest.
+//
+// Maximum errors measured against double precision libm by
+// _benchmarks/fastmath:
+//   sin_poly, cos_poly   1.3e-7 absolute for |x| < 1000
+//   sin_table, cos_table 8.0e-7 absolute for |x| < 1000
+//   tan_poly             2.1e-7 relative for |x| < 1.5
+//   exp_poly             1.1e-7 relative for -80 < x < 80
+//   pow_poly             5.4e-6 relative for 0.001 < a < 1000, |b| < 8
+//
+// Outside those ranges the kernels fall back to libm or lose precision
+// gradually. The *_n() versions process whole buffers with branch free
+// loops that compilers vectorize when floating point traps are disabled
+// (-fno-trapping-math).
+//
+// The kernels are only faster than libm when built with -O3: at -O2 the
+// range checks are not vectorized and exp_poly and pow_poly run at about
+// half the speed of libm. The generator adds -O3 -fno-trapping-math to
+// every compiled file when FastMath is set.
+
+#define STRIDE_FAST_MATH_OFF 0
+#define STRIDE_FAST_MATH_POLY 1
+#define STRIDE_FAST_MATH_TABLE 2
+
+#ifndef STRIDE_FAST_MATH
+#define STRIDE_FAST_MATH STRIDE_FAST_MATH_OFF
+#endif
+
+namespace stride_math {
+
+const float kPi = 3.14159265358979323846f;
+const float kTwoPi = 6.28318530717958647692f;
+const float kLog2e = 1.44269504088896340736f;
+
+// Polynomial kernels ---------------------------------------------------------
+
+// Round to nearest without calling into libm. Valid for |x| < 2^22.
+inline float round_fast(float x) {
+    return (x + 12582912.0f) - 12582912.0f;
+}
+
+// sin(r) for r in [-pi/2, pi/2]. Odd polynomial from Abramowitz and
+// Stegun 4.3.97.
+inline float sin_reduced(float r) {
+    float r2 = r * r;
+    float p = -2.39e-8f;
+    p = p * r2 + 2.7526e-6f;
+    p = p * r2 - 1.98409e-4f;
+    p = p * r2 + 8.3333315e-3f;
+    p = p * r2 - 1.666666664e-1f;
+    return r + r * r2 * p;
+}
+
+// r = x - k * pi in two steps (Cody-Waite) to keep the precision of x
+inline float reduce_pi(float x, float k) {
+    return (x - k * 3.140625f) - k * 9.67653589793e-4f;
+}
+
+inline float sin_poly(float x) {
+    float k = round_fast(x * (1.0f / kPi));
+    float p = sin_reduced(reduce_pi(x, k));
+    // Odd multiples of pi flip the sign
+    return (static_cast<int32_t>(k) & 1) ? -p : p;
+}
+
+// cos(x) = -sin(x - (k + 1/2) * pi) for odd k, sin() for even k
+inline float cos_poly(float x) {
+    float k = round_fast(x * (1.0f / kPi) - 0.5f);
+    float p = sin_reduced(reduce_pi(x, k + 0.5f));
+    return (static_cast<int32_t>(k) & 1) ? p : -p;
+}
+
+inline float tan_poly(float x) {
+    return sin_poly(x) / cos_poly(x);
+}
+
+// Builds 2^n for integer n in [-126, 127]
+inline float exp2_int(int32_t n) {
+    int32_t bits = (n + 127) << 23;
+    float result;
+    std::memcpy(&result, &bits, sizeof(float));
+    return result;
+}
+
+// exp(r) for |r| <= ln(2)/2 from its Taylor series
+inline float exp_reduced(float r) {
+    float p = 1.0f / 5040.0f;
+    p = p * r + 1.0f / 720.0f;
+    p = p * r + 1.0f / 120.0f;
+    p = p * r + 1.0f / 24.0f;
+    p = p * r + 1.0f / 6.0f;
+    p = p * r + 0.5f;
+    p = p * r + 1.0f;
+    return p * r + 1.0f;
+}
+
+// p * 2^n for n in [-252, 254]. Split so both factors stay normal and
+// results in the denormal range come out right.
+inline float scale_exp2(float p, float n) {
+    int32_t n1 = static_cast<int32_t>(n) / 2;
+    int32_t n2 = static_cast<int32_t>(n) - n1;
+    return p * exp2_int(n1) * exp2_int(n2);
+}
+
+// exp(x) = 2^n * exp(r). Written without branches into libm so loops over
+// it vectorize.
+inline float exp_poly(float x) {
+    float c = x > 89.0f ? 89.0f : (x < -104.0f ? -104.0f : x);
+    float n = round_fast(c * kLog2e);
+    float r = (c - n * 0.693145751953125f) - n * 1.428606820309417e-6f;
+    float result = scale_exp2(exp_reduced(r), n);
+    return x > 88.7228391f ? std::numeric_limits<float>::infinity() : result;
+}
+
+// 2^x = 2^n * exp((x - n) * ln(2))
+inline float exp2_poly(float x) {
+    float c = x > 128.0f ? 128.0f : (x < -150.0f ? -150.0f : x);
+    float n = round_fast(c);
+    float result = scale_exp2(exp_reduced((c - n) * 0.693147180559945309f), n);
+    return x >= 128.0f ? std::numeric_limits<float>::infinity() : result;
+}
+
+// log2(x) for normal positive x. The mantissa is reduced to
+// [sqrt(1/2), sqrt(2)) and log2(1 + t) approximated by t * q(t), with q a
+// degree 8 least squares fit (absolute error below 1.4e-8).
+inline float log2_poly(float x) {
+    int32_t bits;
+    std::memcpy(&bits, &x, sizeof(float));
+    // Offsetting by sqrt(1/2) moves the mantissa range to [sqrt(1/2), sqrt(2))
+    int32_t offset = bits - 0x3f3504f3;
+    int32_t exponent = offset >> 23;
+    bits = (offset & 0x007fffff) + 0x3f3504f3;
+    float m;
+    std::memcpy(&m, &bits, sizeof(float));
+    float t = m - 1.0f;
+    float p = 0.126147324f;
+    p = p * t - 0.207420431f;
+    p = p * t + 0.215670011f;
+    p = p * t - 0.238920439f;
+    p = p * t + 0.287918319f;
+    p = p * t - 0.360704823f;
+    p = p * t + 0.48091061f;
+    p = p * t - 0.721347333f;
+    p = p * t + 1.442695f;
+    return static_cast<float>(exponent) + t * p;
+}
+
+// a must be positive and normal, see pow_checked()
+inline float pow_poly(float a, float b) {
+    return exp2_poly(b * log2_poly(a));
+}
+
+inline float pow_checked(float a, float b) {
+    if (!(a >= 1.17549435e-38f && a <= 3.40282347e38f)) {
+        // Zero, negative, denormal and special bases need libm
+        return std::pow(a, b);
+    }
+    return pow_poly(a, b);
+}
+
+// Table kernels --------------------------------------------------------------
+
+const int kSineTableSize = 4096; // Must be a power of two
+
+// Filled by init(). One extra entry avoids wrapping when interpolating.
+static float sine_table[kSineTableSize + 1];
+static bool sine_table_ready = false;
+
+// Fills the tables. Runs automatically before main(), so the kernels never
+// allocate or compute tables while processing.
+inline void init() {
+    if (!sine_table_ready) {
+        for (int i = 0; i <= kSineTableSize; i++) {
+            sine_table[i] = static_cast<float>(std::sin(6.283185307179586 * i / kSineTableSize));
+        }
+        sine_table_ready = true;
+    }
+}
+
+struct TableInitializer {
+    TableInitializer() { init(); }
+};
+static TableInitializer table_initializer;
+
+// Interpolated lookup of sin(r + offset / kSineTableSize * 2 * pi) for r in
+// [-pi, pi]
+inline float table_lookup(float r, int offset) {
+    float phase = (r + kPi) * (kSineTableSize / kTwoPi);
+    int index = static_cast<int>(phase);
+    float frac = phase - static_cast<float>(index);
+    // The table starts at 0, half a cycle away from -pi
+    index = (index + kSineTableSize / 2 + offset) & (kSineTableSize - 1);
+    return sine_table[index] + frac * (sine_table[index + 1] - sine_table[index]);
+}
+
+// Wraps x to [-pi, pi] so large phases keep their precision
+inline float reduce_two_pi(float x) {
+    float k = round_fast(x * (0.5f / kPi));
+    return (x - k * 6.28125f) - k * 1.93530717958647692e-3f;
+}
+
+inline float sin_table(float x) {
+    return table_lookup(reduce_two_pi(x), 0);
+}
+
+inline float cos_table(float x) {
+    return table_lookup(reduce_two_pi(x), kSineTableSize / 4);
+}
+
+// Batch versions -------------------------------------------------------------
+
+inline void sin_poly_n(const float *in, float *out, int n) {
+    for (int i = 0; i < n; i++) {
+        out[i] = sin_poly(in[i]);
+    }
+}
+
+inline void cos_poly_n(const float *in, float *out, int n) {
+    for (int i = 0; i < n; i++) {
+        out[i] = cos_poly(in[i]);
+    }
+}
+
+inline void sin_table_n(const float *in, float *out, int n) {
+    for (int i = 0; i < n; i++) {
+        out[i] = sin_table(in[i]);
+    }
+}
+
+inline void exp_poly_n(const float *in, float *out, int n) {
+    for (int i = 0; i < n; i++) {
+        out[i] = exp_poly(in[i]);
+    }
+}
+
+// Bases must be positive and normal
+inline void pow_poly_n(const float *a, const float *b, float *out, int n) {
+    for (int i = 0; i < n; i++) {
+        out[i] = pow_poly(a[i], b[i]);
+    }
+}
+
+// Functions used by generated code --------------------------------------------
+
+#if STRIDE_FAST_MATH == STRIDE_FAST_MATH_TABLE
+inline float sin(float x) { return sin_table(x); }
+inline float cos(float x) { return cos_table(x); }
+#elif STRIDE_FAST_MATH == STRIDE_FAST_MATH_POLY
+inline float sin(float x) { return sin_poly(x); }
+inline float cos(float x) { return cos_poly(x); }
+#else
+inline float sin(float x) { return std::sin(x); }
+inline float cos(float x) { return std::cos(x); }
+#endif
+
+#if STRIDE_FAST_MATH == STRIDE_FAST_MATH_OFF
+inline float tan(float x) { return std::tan(x); }
+inline float exp(float x) { return std::exp(x); }
+inline float pow(float a, float b) { return std::pow(a, b); }
+#else
+inline float tan(float x) { return tan_poly(x); }
+inline float exp(float x) { return exp_poly(x); }
+inline float pow(float a, float b) { return pow_checked(a, b); }
+#endif
+
+} // namespace stride_math
+
+#endif // STRIDEMATH_H
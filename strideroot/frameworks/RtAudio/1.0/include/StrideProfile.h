@@ -0,0 +1,205 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#ifndef STRIDEPROFILE_H
+#define STRIDEPROFILE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Probes for profiling builds of generated code ("Profile" in the project
+// configuration). The generator wraps streams and module process calls with
+// probes and emits a table mapping each probe site to its .stride file and
+// line.
+
+namespace stride_profile {
+
+struct Site {
+    const char *name;
+    const char *filename;
+    int line;
+};
+
+// Cycle counter where available, nanoseconds otherwise
+inline uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Histogram bucket i counts durations in [2^i, 2^(i+1)) ticks
+const int kNumBuckets = 40;
+
+struct SiteStats {
+    uint64_t count;
+    uint64_t total;
+    uint64_t max;
+    uint64_t buckets[kNumBuckets];
+};
+
+inline int bucket_index(uint64_t ticks) {
+    int index = 0;
+    while (ticks > 1 && index < kNumBuckets - 1) {
+        ticks >>= 1;
+        index++;
+    }
+    return index;
+}
+
+// Statistics are kept per thread, each thread only writes its own table so
+// recording needs no locks or atomics. Tables are read by dump() once
+// processing has stopped.
+template<int NumSites, int MaxThreads = 16>
+class Profiler {
+public:
+    Profiler(const Site *sites) : m_sites(sites) {
+        std::memset(m_stats, 0, sizeof(m_stats));
+    }
+
+    void record(int site, uint64_t ticks) {
+        SiteStats *stats = threadStats();
+        if (stats) {
+            SiteStats &siteStats = stats[site];
+            siteStats.count++;
+            siteStats.total += ticks;
+            if (ticks > siteStats.max) {
+                siteStats.max = ticks;
+            }
+            siteStats.buckets[bucket_index(ticks)]++;
+        }
+    }
+
+    // Prints all sites that ran, most expensive first
+    void dump() {
+        double ticksPerMicrosecond = calibrate();
+        int numThreads = std::min(m_nextThread.load(), MaxThreads);
+        std::vector<SiteStats> merged(NumSites);
+        std::memset(merged.data(), 0, sizeof(SiteStats) * NumSites);
+        std::vector<int> order;
+        for (int site = 0; site < NumSites; site++) {
+            for (int thread = 0; thread < numThreads; thread++) {
+                const SiteStats &stats = m_stats[thread][site];
+                merged[site].count += stats.count;
+                merged[site].total += stats.total;
+                merged[site].max = std::max(merged[site].max, stats.max);
+                for (int i = 0; i < kNumBuckets; i++) {
+                    merged[site].buckets[i] += stats.buckets[i];
+                }
+            }
+            if (merged[site].count > 0) {
+                order.push_back(site);
+            }
+        }
+        std::sort(order.begin(), order.end(), [&](int a, int b) {
+            return merged[a].total > merged[b].total;
+        });
+        std::fprintf(stderr, "Profile (%i threads)\n", numThreads);
+        std::fprintf(stderr, "%-40s %-32s %12s %10s %10s %10s\n",
+                     "location", "site", "count", "total ms", "mean us", "max us");
+        for (int site : order) {
+            const SiteStats &stats = merged[site];
+            char location[256];
+            std::snprintf(location, sizeof(location), "%s:%i", m_sites[site].filename, m_sites[site].line);
+            std::fprintf(stderr, "%-40s %-32s %12llu %10.3f %10.4f %10.3f\n",
+                         location, m_sites[site].name,
+                         (unsigned long long) stats.count,
+                         stats.total / ticksPerMicrosecond / 1000.0,
+                         stats.total / ticksPerMicrosecond / stats.count,
+                         stats.max / ticksPerMicrosecond);
+            std::fprintf(stderr, "    histogram (us):");
+            for (int i = 0; i < kNumBuckets; i++) {
+                if (stats.buckets[i] > 0) {
+                    std::fprintf(stderr, " <%.3g:%llu", double(uint64_t(2) << i) / ticksPerMicrosecond,
+                                 (unsigned long long) stats.buckets[i]);
+                }
+            }
+            std::fprintf(stderr, "\n");
+        }
+    }
+
+private:
+    SiteStats *threadStats() {
+        static thread_local int slot = -1;
+        if (slot < 0) {
+            slot = m_nextThread.fetch_add(1);
+        }
+        return slot < MaxThreads ? m_stats[slot] : nullptr;
+    }
+
+    static double calibrate() {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t startTicks = now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        uint64_t ticks = now() - startTicks;
+        double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        return ticks / elapsed;
+    }
+
+    const Site *m_sites;
+    std::atomic<int> m_nextThread {0};
+    SiteStats m_stats[MaxThreads][NumSites];
+};
+
+// Times an expression, used to wrap module process calls
+template<typename ProfilerType, typename Function>
+inline auto measure(ProfilerType &profiler, int site, Function function) -> decltype(function()) {
+    struct Probe {
+        ProfilerType &profiler;
+        int site;
+        uint64_t start;
+        ~Probe() { profiler.record(site, now() - start); }
+    } probe {profiler, site, now()};
+    return function();
+}
+
+} // namespace stride_profile
+
+#endif // STRIDEPROFILE_H
@@ -0,0 +1,200 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#ifndef STRIDEREALTIME_H
+#define STRIDEREALTIME_H
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_IX86_FP)
+#include <xmmintrin.h>
+#include <pmmintrin.h>
+#define STRIDE_RT_SSE
+#endif
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#define STRIDE_RT_POSIX
+#endif
+
+// Support for the "Realtime" profile of the RtAudio framework
+// (STRIDE_REALTIME). All functions fall back to doing nothing on platforms
+// that don't support them.
+
+namespace stride_rt {
+
+// Flush denormals to zero in the calling thread. Denormal arithmetic is very
+// slow on most CPUs and decaying filters and reverb tails produce plenty.
+inline void flush_denormals() {
+#if defined(STRIDE_RT_SSE)
+    _MM_SET_FLUSH_ZERO_MODE(_MM_FLUSH_ZERO_ON);
+    _MM_SET_DENORMALS_ZERO_MODE(_MM_DENORMALS_ZERO_ON);
+#elif defined(__aarch64__)
+    uint64_t fpcr;
+    __asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+    __asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr | (1 << 24)));
+#endif
+}
+
+// Touch the stack the audio thread will use so it doesn't page fault later
+inline void prefault_stack() {
+    volatile unsigned char stack[256 * 1024];
+    for (unsigned int i = 0; i < sizeof(stack); i += 4096) {
+        stack[i] = 0;
+    }
+}
+
+// Lock current and future pages in memory. All generated state is global,
+// so by the time this runs from main() it is allocated and gets faulted in.
+inline bool lock_memory() {
+#if defined(STRIDE_RT_POSIX)
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        std::cerr << "Realtime: could not lock memory: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    prefault_stack();
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Move the calling thread to SCHED_FIFO. Usually needs rtprio permissions.
+inline bool promote_thread(int priority = 80) {
+#if defined(STRIDE_RT_POSIX)
+    sched_param param;
+    std::memset(&param, 0, sizeof(param));
+    int maxPriority = sched_get_priority_max(SCHED_FIFO);
+    param.sched_priority = priority < maxPriority ? priority : maxPriority;
+    return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+#else
+    return false;
+#endif
+}
+
+// Called at the start of every audio callback. The first callback is a
+// pre-roll that sets up the audio thread and faults in its stack. It
+// returns false, and the caller outputs silence for that block instead
+// of processing, so the page faults can't make real output late.
+inline bool begin_callback() {
+    static bool promoted = false;
+    flush_denormals();
+    if (!promoted) {
+        promoted = true;
+        promote_thread();
+        prefault_stack();
+        return false;
+    }
+    return true;
+}
+
+// Collects over/underflows reported to the audio callback without locking
+// or printing from the audio thread. A non realtime thread drains the
+// events and prints them.
+class XrunMonitor {
+public:
+    ~XrunMonitor() { stop(); }
+
+    // Audio thread side
+    void report(unsigned int status, double streamTime) {
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        int write = m_write.load(std::memory_order_relaxed);
+        int next = (write + 1) & (kEventCount - 1);
+        if (next != m_read.load(std::memory_order_acquire)) {
+            m_events[write].status = status;
+            m_events[write].streamTime = streamTime;
+            m_write.store(next, std::memory_order_release);
+        }
+    }
+
+    unsigned long count() const { return m_count.load(std::memory_order_relaxed); }
+
+    void start() {
+        m_running.store(true);
+        m_thread = std::thread(&XrunMonitor::drainLoop, this);
+    }
+
+    void stop() {
+        if (m_running.exchange(false)) {
+            m_thread.join();
+            drain();
+            if (count() > 0) {
+                std::cout << "Realtime: " << count() << " over/underflows." << std::endl;
+            }
+        }
+    }
+
+private:
+    struct Event {
+        unsigned int status;
+        double streamTime;
+    };
+
+    void drain() {
+        int read = m_read.load(std::memory_order_relaxed);
+        while (read != m_write.load(std::memory_order_acquire)) {
+            std::cout << "Stream over/underflow detected at " << m_events[read].streamTime
+                      << " s (status " << m_events[read].status << ")" << std::endl;
+            read = (read + 1) & (kEventCount - 1);
+            m_read.store(read, std::memory_order_release);
+        }
+    }
+
+    void drainLoop() {
+        while (m_running.load()) {
+            drain();
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+
+    static const int kEventCount = 64; // Must be a power of two
+    Event m_events[kEventCount];
+    std::atomic<int> m_write {0};
+    std::atomic<int> m_read {0};
+    std::atomic<unsigned long> m_count {0};
+    std::atomic<bool> m_running {false};
+    std::thread m_thread;
+};
+
+} // namespace stride_rt
+
+#endif // STRIDEREALTIME_H
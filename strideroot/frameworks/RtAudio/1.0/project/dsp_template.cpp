@@ -0,0 +1,61 @@
+#define STRIDE_DSP_LIBRARY
+#include "StrideDsp.h"
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+
+//[[Includes]]
+//[[/Includes]]
+
+
+//[[Declarations]]
+//[[/Declarations]]
+
+//[[Instances]]
+//[[/Instances]]
+
+
+//[[Processing]]
+//[[/Processing]]
+
+//[[OSC:Processing]]
+//[[/OSC:Processing]]
+//[[SerialIn:Processing]]
+//[[/SerialIn:Processing]]
+//[[SerialOut:Processing]]
+//[[/SerialOut:Processing]]
+
+//[[State]]
+//[[/State]]
+
+STRIDE_DSP_EXPORT int stride_dsp_abi_version() {
+    return STRIDE_DSP_ABI_VERSION;
+}
+
+STRIDE_DSP_EXPORT void stride_dsp_init() {
+//[[Initialization]]
+
+//[[/Initialization]]
+}
+
+STRIDE_DSP_EXPORT void stride_dsp_cleanup() {
+//[[Cleanup]]
+//[[/Cleanup]]
+}
+
+STRIDE_DSP_EXPORT int stride_dsp_state_size() {
+    return _stride_dsp_state_count;
+}
+
+STRIDE_DSP_EXPORT const StrideDspState *stride_dsp_state() {
+    return _stride_dsp_state;
+}
+
+STRIDE_DSP_EXPORT int stride_dsp_migrate(const StrideDspState *state, int count) {
+    return stride_dsp::migrate(_stride_dsp_state, _stride_dsp_state_count, state, count);
+}
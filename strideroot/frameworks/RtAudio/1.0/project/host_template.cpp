@@ -0,0 +1,101 @@
+#include "RtAudio.h"
+#include "StrideDsp.h"
+#include "StrideRealtime.h"
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cstdio>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <unistd.h>
+
+// Persistent host for builds with "HotReload". It owns the audio device and
+// runs the generated code from the DSP library, which is swapped in
+// between blocks whenever it is rebuilt.
+
+#define NUM_IN_CHANNELS %%num_in_chnls%%
+#define NUM_OUT_CHANNELS %%num_out_chnls%%
+typedef float MY_TYPE;
+#define FORMAT RTAUDIO_FLOAT32
+
+stride_dsp::Host _dsp_host("%%dsp_library%%");
+
+int audio_buffer_process( void *outputBuffer, void *inputBuffer, unsigned int nBufferFrames,
+           double streamTime, RtAudioStreamStatus status, void *data )
+{
+#ifdef STRIDE_REALTIME
+  if ( !stride_rt::begin_callback() ) {
+    std::memset(outputBuffer, 0, nBufferFrames * NUM_OUT_CHANNELS * sizeof(MY_TYPE));
+    return 0;
+  }
+#endif
+  if ( status ) std::cout << "Stream over/underflow detected." << std::endl;
+  _dsp_host.process((MY_TYPE *)inputBuffer, (MY_TYPE *)outputBuffer, nBufferFrames, NUM_OUT_CHANNELS);
+  return 0;
+}
+
+int main() {
+    if (!_dsp_host.poll()) {
+        std::cout << "Could not load %%dsp_library%%" << std::endl;
+        exit( -1 );
+    }
+    // Lets the generator know new builds will be picked up
+    std::ofstream("%%pid_file%%") << getpid() << std::endl;
+
+    RtAudio adac;
+    if ( adac.getDeviceCount() < 1 ) {
+        std::cout << std::endl << "No audio devices found!" << std::endl;
+        exit( -1 );
+    }
+    unsigned int bufferFrames = %%block_size%%;
+    unsigned int fs = %%sample_rate%%;
+
+    RtAudio::StreamOptions options;
+#ifdef STRIDE_REALTIME
+    stride_rt::lock_memory();
+    options.flags |= RTAUDIO_SCHEDULE_REALTIME;
+#endif
+
+    RtAudio::StreamParameters iParams, oParams;
+    iParams.deviceId = adac.getDefaultInputDevice();
+    iParams.nChannels = NUM_IN_CHANNELS;
+    oParams.deviceId = adac.getDefaultOutputDevice();
+    oParams.nChannels = NUM_OUT_CHANNELS;
+
+    try {
+        adac.openStream( &oParams, &iParams, FORMAT, fs, &bufferFrames, &audio_buffer_process, nullptr, &options);
+        adac.startStream();
+    }
+    catch ( RtAudioError& e ) {
+        e.printMessage();
+        if ( adac.isStreamOpen() ) adac.closeStream();
+        remove("%%pid_file%%");
+        exit( -1 );
+    }
+
+    std::atomic<bool> done(false);
+    std::thread input([&done]() {
+        char c;
+        std::cin.get(c);
+        done = true;
+    });
+    std::cout << "\nRunning ... press <enter> to quit.\n";
+    while (!done) {
+        if (_dsp_host.poll()) {
+            std::cout << "DSP reloaded." << std::endl;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    input.join();
+
+    try {
+        if ( adac.isStreamRunning() ) adac.stopStream();
+        if ( adac.isStreamOpen() ) adac.closeStream();
+    }
+    catch ( RtAudioError& e ) {
+      e.printMessage();
+    }
+    remove("%%pid_file%%");
+    return 0;
+}
@@ -0,0 +1,206 @@
+#include "StrideDsp.h"
+#ifdef STRIDE_REALTIME
+#include "StrideRealtime.h"
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// Null audio device for builds with "NullDevice". Calls the generated code
+// from a timer at the rate a sound card with the configured block size and
+// sample rate would, and reports how long each callback takes, how much the
+// timer wakes up late and how many callbacks miss their deadline.
+//
+// With loopback the output of each block is fed to the input of the next,
+// as if the outputs were cabled to the inputs. An impulse is then sent
+// through the code before timing starts to measure round trip latency.
+
+#define NUM_IN_CHANNELS %%num_in_chnls%%
+#define NUM_OUT_CHANNELS %%num_out_chnls%%
+#define SAMPLE_RATE %%sample_rate%%
+#define BLOCK_FRAMES %%block_size%%
+
+STRIDE_DSP_EXPORT void stride_dsp_init();
+STRIDE_DSP_EXPORT void stride_dsp_process(float *in, float *out, unsigned int nBufferFrames);
+STRIDE_DSP_EXPORT void stride_dsp_cleanup();
+STRIDE_DSP_EXPORT int stride_dsp_state_size();
+STRIDE_DSP_EXPORT const StrideDspState *stride_dsp_state();
+
+typedef std::chrono::steady_clock Clock;
+
+static std::vector<float> in(BLOCK_FRAMES * NUM_IN_CHANNELS, 0.0f);
+static std::vector<float> out(BLOCK_FRAMES * NUM_OUT_CHANNELS, 0.0f);
+
+static void processBlock(bool loopback) {
+    if (loopback) {
+        for (int i = 0; i < BLOCK_FRAMES; i++) {
+            for (int c = 0; c < NUM_IN_CHANNELS; c++) {
+                in[i * NUM_IN_CHANNELS + c] = c < NUM_OUT_CHANNELS ? out[i * NUM_OUT_CHANNELS + c] : 0.0f;
+            }
+        }
+    }
+    stride_dsp_process(in.data(), out.data(), BLOCK_FRAMES);
+}
+
+// The latency measurement restores the code's state, which is only possible
+// when all of it is trivially copyable
+static bool stateCanBeRestored() {
+    const StrideDspState *state = stride_dsp_state();
+    int stateCount = stride_dsp_state_size();
+    for (int i = 0; i < stateCount; i++) {
+        if (!state[i].data) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Frames from an impulse on the first input to the first output. The code
+// is run from the same state with and without the impulse and the first
+// output frame that differs is taken as the arrival, so signals the code
+// generates itself don't hide it. Returns -1 if the impulse doesn't arrive
+// within maxBlocks. Needs stateCanBeRestored().
+static long measureLatency(int maxBlocks) {
+    if (NUM_IN_CHANNELS == 0 || NUM_OUT_CHANNELS == 0) {
+        return -1;
+    }
+    std::vector<std::vector<unsigned char>> saved;
+    const StrideDspState *state = stride_dsp_state();
+    int stateCount = stride_dsp_state_size();
+    for (int i = 0; i < stateCount; i++) {
+        const unsigned char *data = (const unsigned char *) state[i].data;
+        saved.push_back(std::vector<unsigned char>(data, data + state[i].size));
+    }
+    std::vector<float> savedOut = out;
+
+    std::vector<float> reference;
+    for (int b = 0; b < maxBlocks; b++) {
+        std::fill(in.begin(), in.end(), 0.0f);
+        processBlock(b > 0);
+        reference.insert(reference.end(), out.begin(), out.end());
+    }
+
+    for (int i = 0; i < stateCount; i++) {
+        memcpy(state[i].data, saved[i].data(), state[i].size);
+    }
+    out = savedOut;
+    long arrival = -1;
+    for (int b = 0; b < maxBlocks && arrival < 0; b++) {
+        std::fill(in.begin(), in.end(), 0.0f);
+        if (b > 0) {
+            processBlock(true);
+        } else {
+            in[0] = 1.0f;
+            processBlock(false);
+        }
+        for (int i = 0; i < BLOCK_FRAMES; i++) {
+            size_t index = (size_t) (b * BLOCK_FRAMES + i) * NUM_OUT_CHANNELS;
+            if (out[i * NUM_OUT_CHANNELS] != reference[index]) {
+                arrival = b * BLOCK_FRAMES + i;
+                break;
+            }
+        }
+    }
+
+    // The timed run starts from the state the code had before measuring
+    for (int i = 0; i < stateCount; i++) {
+        memcpy(state[i].data, saved[i].data(), state[i].size);
+    }
+    out = savedOut;
+    std::fill(in.begin(), in.end(), 0.0f);
+    return arrival;
+}
+
+static double percentile(std::vector<double> values, double fraction) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    size_t index = std::min(values.size() - 1, (size_t) (fraction * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+int main(int argc, char *argv[]) {
+    double seconds = argc > 1 ? atof(argv[1]) : 10.0;
+    bool loopback = argc > 2 && atoi(argv[2]) != 0;
+    if (seconds <= 0) {
+        seconds = 10.0;
+    }
+    const double period = BLOCK_FRAMES / (double) SAMPLE_RATE;
+    const size_t callbacks = (size_t) std::ceil(seconds / period);
+
+    stride_dsp_init();
+
+    if (loopback && !stateCanBeRestored()) {
+        printf("Loopback latency: not measured, the code has state that can't be copied\n");
+    } else if (loopback) {
+        long latency = measureLatency(SAMPLE_RATE / BLOCK_FRAMES + 2);
+        if (latency >= 0) {
+            // A device adds a block of input and a block of output buffering
+            long roundTrip = latency + 2 * BLOCK_FRAMES;
+            printf("Loopback latency: %ld frames through the code, %ld frames (%.2f ms) round trip\n",
+                   latency, roundTrip, 1000.0 * roundTrip / SAMPLE_RATE);
+        } else {
+            printf("Loopback latency: impulse did not reach the first output\n");
+        }
+    }
+
+#ifdef STRIDE_REALTIME
+    stride_rt::lock_memory();
+    stride_rt::promote_thread();
+    stride_rt::flush_denormals();
+#endif
+    // Preallocated so nothing is allocated while timing
+    std::vector<double> execution(callbacks);
+    std::vector<double> lateness(callbacks);
+    size_t misses = 0;
+
+    const Clock::duration step = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(period));
+    Clock::time_point deadline = Clock::now() + step;
+    for (size_t i = 0; i < callbacks; i++) {
+        // The block for this deadline is due when the previous one ends
+        Clock::time_point due = deadline - step;
+        std::this_thread::sleep_until(due);
+        Clock::time_point start = Clock::now();
+        processBlock(loopback);
+        Clock::time_point end = Clock::now();
+        execution[i] = std::chrono::duration<double>(end - start).count();
+        lateness[i] = std::chrono::duration<double>(start - due).count();
+        if (end > deadline) {
+            misses++;
+        }
+        deadline += step;
+    }
+    stride_dsp_cleanup();
+
+    double total = 0.0;
+    double latenessTotal = 0.0;
+    for (size_t i = 0; i < callbacks; i++) {
+        total += execution[i];
+        latenessTotal += lateness[i];
+    }
+    double mean = total / callbacks;
+    double meanLateness = latenessTotal / callbacks;
+    double jitter = 0.0;
+    for (size_t i = 0; i < callbacks; i++) {
+        jitter += (lateness[i] - meanLateness) * (lateness[i] - meanLateness);
+    }
+    jitter = std::sqrt(jitter / callbacks);
+    double maxExecution = *std::max_element(execution.begin(), execution.end());
+
+    printf("Null device: %zu callbacks of %i frames at %i Hz (%.3f ms budget)\n",
+           callbacks, BLOCK_FRAMES, SAMPLE_RATE, period * 1000.0);
+    printf("Execution: mean %.3f ms, p99 %.3f ms, max %.3f ms (%.1f%% of budget at max)\n",
+           mean * 1000.0, percentile(execution, 0.99) * 1000.0, maxExecution * 1000.0,
+           100.0 * maxExecution / period);
+    printf("Wake up: mean late %.3f ms, jitter %.3f ms, max late %.3f ms\n",
+           meanLateness * 1000.0, jitter * 1000.0,
+           *std::max_element(lateness.begin(), lateness.end()) * 1000.0);
+    printf("Deadline misses: %zu\n", misses);
+    return misses == 0 ? 0 : 1;
+}
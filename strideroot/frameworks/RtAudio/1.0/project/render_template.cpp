@@ -0,0 +1,233 @@
+#include "StrideDsp.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Offline renderer for builds with "Render". Runs the generated code from
+// an input file to an output file as fast as possible. Files are WAV
+// (16, 24 or 32 bit integer or 32 bit float) or interleaved 32 bit float
+// raw data when their name ends in ".raw". The input is mapped into memory,
+// the output is written through a large buffer.
+
+#define NUM_IN_CHANNELS %%num_in_chnls%%
+#define NUM_OUT_CHANNELS %%num_out_chnls%%
+#define SAMPLE_RATE %%sample_rate%%
+#define RENDER_BLOCK_FRAMES 4096
+
+STRIDE_DSP_EXPORT void stride_dsp_init();
+STRIDE_DSP_EXPORT void stride_dsp_process(float *in, float *out, unsigned int nBufferFrames);
+STRIDE_DSP_EXPORT void stride_dsp_cleanup();
+
+struct InputFile {
+    const uint8_t *map {nullptr};
+    size_t mapSize {0};
+    const uint8_t *data {nullptr};
+    uint64_t frames {0};
+    int channels {0};
+    int format {3};  // WAVE_FORMAT_PCM (1) or WAVE_FORMAT_IEEE_FLOAT (3)
+    int bytesPerSample {4};
+    unsigned int sampleRate {SAMPLE_RATE};
+
+    float sample(uint64_t frame, int channel) const {
+        const uint8_t *p = data + (frame * channels + channel) * bytesPerSample;
+        if (format == 3) {
+            float value;
+            memcpy(&value, p, 4);
+            return value;
+        }
+        switch (bytesPerSample) {
+        case 2:
+            return (int16_t) (p[0] | (p[1] << 8)) / 32768.0f;
+        case 3:
+            return (int32_t) ((uint32_t) p[0] << 8 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 24) / 2147483648.0f;
+        default:
+            return (int32_t) ((uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24) / 2147483648.0f;
+        }
+    }
+};
+
+static bool isRaw(const std::string &name) {
+    return name.size() > 4 && name.compare(name.size() - 4, 4, ".raw") == 0;
+}
+
+static uint32_t read32(const uint8_t *p) {
+    return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static bool openInput(const std::string &name, InputFile &input) {
+    int fd = open(name.c_str(), O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Can't open %s\n", name.c_str());
+        return false;
+    }
+    struct stat info;
+    fstat(fd, &info);
+    input.mapSize = info.st_size;
+    if (input.mapSize > 0) {
+        void *map = mmap(nullptr, input.mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        input.map = map == MAP_FAILED ? nullptr : (const uint8_t *) map;
+    }
+    close(fd);
+    if (!input.map) {
+        fprintf(stderr, "Can't map %s\n", name.c_str());
+        return false;
+    }
+    madvise((void *) input.map, input.mapSize, MADV_SEQUENTIAL);
+
+    if (isRaw(name)) {
+        input.data = input.map;
+        input.channels = NUM_IN_CHANNELS;
+        input.frames = input.mapSize / (4 * NUM_IN_CHANNELS);
+        return true;
+    }
+    if (input.mapSize < 12 || memcmp(input.map, "RIFF", 4) != 0 || memcmp(input.map + 8, "WAVE", 4) != 0) {
+        fprintf(stderr, "%s is not a WAV file\n", name.c_str());
+        return false;
+    }
+    size_t offset = 12;
+    bool haveFormat = false;
+    while (offset + 8 <= input.mapSize) {
+        const uint8_t *chunk = input.map + offset;
+        uint32_t size = read32(chunk + 4);
+        if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+            input.format = chunk[8] | (chunk[9] << 8);
+            input.channels = chunk[10] | (chunk[11] << 8);
+            input.sampleRate = read32(chunk + 12);
+            input.bytesPerSample = (chunk[22] | (chunk[23] << 8)) / 8;
+            if (input.format == 0xFFFE && size >= 40) { // WAVE_FORMAT_EXTENSIBLE
+                input.format = chunk[32] | (chunk[33] << 8);
+            }
+            haveFormat = true;
+        } else if (memcmp(chunk, "data", 4) == 0 && haveFormat) {
+            if (!((input.format == 1 && input.bytesPerSample >= 2) || (input.format == 3 && input.bytesPerSample == 4))
+                    || input.channels < 1) {
+                fprintf(stderr, "Unsupported sample format in %s\n", name.c_str());
+                return false;
+            }
+            input.data = chunk + 8;
+            size = (uint32_t) std::min<uint64_t>(size, input.mapSize - offset - 8);
+            input.frames = size / (input.bytesPerSample * input.channels);
+            return true;
+        }
+        offset += 8 + size + (size & 1);
+    }
+    fprintf(stderr, "No audio data in %s\n", name.c_str());
+    return false;
+}
+
+static void write32(FILE *f, uint32_t value) {
+    uint8_t bytes[4] = {(uint8_t) value, (uint8_t) (value >> 8), (uint8_t) (value >> 16), (uint8_t) (value >> 24)};
+    fwrite(bytes, 1, 4, f);
+}
+
+static void write16(FILE *f, uint16_t value) {
+    uint8_t bytes[2] = {(uint8_t) value, (uint8_t) (value >> 8)};
+    fwrite(bytes, 1, 2, f);
+}
+
+// 32 bit float WAV header. Written with the final size once rendering is done.
+static void writeWavHeader(FILE *f, uint64_t frames) {
+    uint32_t dataSize = (uint32_t) (frames * NUM_OUT_CHANNELS * 4);
+    fwrite("RIFF", 1, 4, f);
+    write32(f, 36 + dataSize);
+    fwrite("WAVEfmt ", 1, 8, f);
+    write32(f, 16);
+    write16(f, 3);
+    write16(f, NUM_OUT_CHANNELS);
+    write32(f, SAMPLE_RATE);
+    write32(f, SAMPLE_RATE * NUM_OUT_CHANNELS * 4);
+    write16(f, NUM_OUT_CHANNELS * 4);
+    write16(f, 32);
+    fwrite("data", 1, 4, f);
+    write32(f, dataSize);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s <input|-> <output> <seconds>\n"
+                        "Use - for silent input. Seconds <= 0 renders the whole input.\n", argv[0]);
+        return -1;
+    }
+    std::string inputName = argv[1];
+    std::string outputName = argv[2];
+    double seconds = atof(argv[3]);
+
+    InputFile input;
+    if (inputName != "-") {
+        if (!openInput(inputName, input)) {
+            return -1;
+        }
+        if (input.sampleRate != SAMPLE_RATE) {
+            fprintf(stderr, "Warning: %s is %u Hz, rendering at %i Hz\n", inputName.c_str(), input.sampleRate, SAMPLE_RATE);
+        }
+    }
+    uint64_t totalFrames = seconds > 0 ? (uint64_t) (seconds * SAMPLE_RATE) : input.frames;
+    if (totalFrames == 0) {
+        fprintf(stderr, "Nothing to render. Set a duration when there is no input.\n");
+        return -1;
+    }
+
+    FILE *output = fopen(outputName.c_str(), "wb");
+    if (!output) {
+        fprintf(stderr, "Can't open %s\n", outputName.c_str());
+        return -1;
+    }
+    std::vector<char> outputBuffer(1 << 20);
+    setvbuf(output, outputBuffer.data(), _IOFBF, outputBuffer.size());
+    bool raw = isRaw(outputName);
+    if (!raw) {
+        writeWavHeader(output, 0);
+    }
+
+    std::vector<float> in(RENDER_BLOCK_FRAMES * NUM_IN_CHANNELS, 0.0f);
+    std::vector<float> out(RENDER_BLOCK_FRAMES * NUM_OUT_CHANNELS, 0.0f);
+    int inputChannels = std::min(input.channels, NUM_IN_CHANNELS);
+
+    stride_dsp_init();
+    auto start = std::chrono::steady_clock::now();
+    uint64_t frame = 0;
+    while (frame < totalFrames) {
+        unsigned int blockFrames = (unsigned int) std::min<uint64_t>(RENDER_BLOCK_FRAMES, totalFrames - frame);
+        // Deinterleave into the block, past the end of the input is silence
+        uint64_t available = frame < input.frames ? std::min<uint64_t>(blockFrames, input.frames - frame) : 0;
+        if (input.format == 3 && input.channels == NUM_IN_CHANNELS && available > 0) {
+            memcpy(in.data(), input.data + frame * NUM_IN_CHANNELS * 4, available * NUM_IN_CHANNELS * 4);
+        } else {
+            for (uint64_t i = 0; i < available; i++) {
+                for (int c = 0; c < inputChannels; c++) {
+                    in[i * NUM_IN_CHANNELS + c] = input.sample(frame + i, c);
+                }
+            }
+        }
+        if (available < blockFrames) {
+            std::fill(in.begin() + available * NUM_IN_CHANNELS, in.end(), 0.0f);
+        }
+        stride_dsp_process(in.data(), out.data(), blockFrames);
+        fwrite(out.data(), sizeof(float), blockFrames * NUM_OUT_CHANNELS, output);
+        frame += blockFrames;
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stride_dsp_cleanup();
+
+    if (!raw) {
+        fseek(output, 0, SEEK_SET);
+        writeWavHeader(output, totalFrames);
+    }
+    bool ok = fclose(output) == 0;
+    if (input.map) {
+        munmap((void *) input.map, input.mapSize);
+    }
+    double duration = totalFrames / (double) SAMPLE_RATE;
+    printf("Rendered %.3f s in %.3f s (%.1fx realtime)\n", duration, elapsed,
+           elapsed > 0 ? duration / elapsed : 0.0);
+    return ok ? 0 : -1;
+}
@@ -3,6 +3,10 @@
 #include <iostream>
 #include <cstdlib>
 #include <cstring>
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <chrono>
 
 
 //[[Includes]]
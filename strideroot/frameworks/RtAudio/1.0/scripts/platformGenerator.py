@@ -174,6 +174,73 @@ class Generator(GeneratorBase):
         else:
             self.templates.properties['block_size'] = 512
 
+        # Preprocessor definitions and compiler options passed to every
+        # compiled source file
+        self.defines = []
+        self.compile_flags = []
+        if self.config and 'StaticBuffers' in self.config and self.config['StaticBuffers']:
+            self.defines.append('-DSTRIDE_STATIC_BUFFERS')
+
+        # Realtime profile from include/StrideRealtime.h. Buffers are made
+        # static so no state is allocated on the heap.
+        if self.config and 'Realtime' in self.config and self.config['Realtime']:
+            self.defines.append('-DSTRIDE_REALTIME')
+            if not '-DSTRIDE_STATIC_BUFFERS' in self.defines:
+                self.defines.append('-DSTRIDE_STATIC_BUFFERS')
+
+        # Probes around streams and module calls, see include/StrideProfile.h
+        if self.config and 'Profile' in self.config and self.config['Profile']:
+            self.templates.profiling = True
+
+        # Math kernels from include/StrideMath.h: "poly", "table" or libm
+        if self.config and 'FastMath' in self.config and self.config['FastMath']:
+            if self.config['FastMath'] == 'table':
+                self.defines.append('-DSTRIDE_FAST_MATH=STRIDE_FAST_MATH_TABLE')
+            else:
+                self.defines.append('-DSTRIDE_FAST_MATH=STRIDE_FAST_MATH_POLY')
+            # The kernels rely on inlining and vectorization of their range
+            # checks. Without them exp and pow are slower than libm.
+            self.compile_flags += ['-O3', '-fno-trapping-math']
+
+        # Build the generated code as a library that a persistent host swaps
+        # in without reopening the audio device, see include/StrideDsp.h
+        self.dsp_library = self.out_dir + '/libstride_dsp.so'
+        self.hot_reload = False
+        if self.config and 'HotReload' in self.config and self.config['HotReload']:
+            if platform.system() == "Linux" or platform.system() == "Darwin":
+                self.library_build = True
+                self.hot_reload = True
+            else:
+                self.log("HotReload not supported on '%s'. Building application."%platform.system())
+
+        # Offline render of files through the library code, linked into the
+        # driver from project/render_template.cpp instead of a host
+        self.render = None
+        if self.config and 'Render' in self.config and self.config['Render']:
+            if platform.system() == "Linux" or platform.system() == "Darwin":
+                self.render = self.config['Render']
+                self.library_build = True
+                self.hot_reload = False
+                self.target_name = 'rtaudio_render'
+            else:
+                self.log("Render not supported on '%s'. Building application."%platform.system())
+
+        # Null audio device from project/null_template.cpp. Clocks the code
+        # from a timer and reports execution time, jitter and deadline misses.
+        self.null_device = None
+        if self.config and 'NullDevice' in self.config and self.config['NullDevice'] and not self.render:
+            if platform.system() == "Linux" or platform.system() == "Darwin":
+                self.null_device = self.config['NullDevice']
+                if not isinstance(self.null_device, dict):
+                    self.null_device = {}
+                self.library_build = True
+                self.hot_reload = False
+                self.target_name = 'rtaudio_null'
+            else:
+                self.log("NullDevice not supported on '%s'. Building application."%platform.system())
+
+        # Written by a running host, so it follows the final target name
+        self.pid_file = self.out_dir + '/' + self.target_name + '.pid'
 
     def generate_code(self):
         # Generate code from tree
@@ -187,8 +254,18 @@ class Generator(GeneratorBase):
         #declare_code = var_declaration + declare_code
 
 
-        self.out_file = self.out_dir + "/main.cpp"
-        shutil.copyfile(self.project_dir + "/template.cpp", self.out_file)
+        if self.library_build:
+            self.out_file = self.out_dir + "/dsp.cpp"
+            shutil.copyfile(self.project_dir + "/dsp_template.cpp", self.out_file)
+            if self.render:
+                self.write_driver_code("render")
+            elif self.null_device is not None:
+                self.write_driver_code("null")
+            else:
+                self.write_host_code()
+        else:
+            self.out_file = self.out_dir + "/main.cpp"
+            shutil.copyfile(self.project_dir + "/template.cpp", self.out_file)
         if os.path.isdir(self.out_dir + "/rtaudio"):
             shutil.rmtree(self.out_dir + "/rtaudio")
         if os.path.isdir(self.project_dir + "/rtaudio-4.1.2"):
@@ -197,6 +274,9 @@ class Generator(GeneratorBase):
             self.log("RtAudio 4.1.2 required. Not copying to project.")
 
         self.write_code(code,self.out_file)
+        if self.library_build:
+            state_code = self.templates.dsp_state_code(self.platform.get_state_entries())
+            self.write_section_in_file('State', state_code, self.out_file)
 
         self.make_code_pretty()
 
@@ -222,6 +302,122 @@ class Generator(GeneratorBase):
 
         self.log("Platform code generation finished!")
 
+    def write_host_code(self):
+        host_code = open(self.project_dir + "/host_template.cpp").read()
+        host_code = self.templates.process_code(host_code)
+        host_code = host_code.replace("%%dsp_library%%", self.dsp_library)
+        host_code = host_code.replace("%%pid_file%%", self.pid_file)
+        # Only touch the host when it changes, so it is not rebuilt
+        host_file = self.out_dir + "/host.cpp"
+        if os.path.exists(host_file) and open(host_file).read() == host_code:
+            return
+        f = open(host_file, 'w')
+        f.write(host_code)
+        f.close()
+        if self.host_is_running():
+            self.log("Audio configuration changed. Restart the running host to apply it.")
+
+    def write_driver_code(self, name):
+        driver_code = open(self.project_dir + "/" + name + "_template.cpp").read()
+        driver_code = self.templates.process_code(driver_code)
+        self.driver_file = self.out_dir + "/" + name + ".cpp"
+        f = open(self.driver_file, 'w')
+        f.write(driver_code)
+        f.close()
+
+    def host_is_running(self):
+        if not os.path.exists(self.pid_file):
+            return False
+        try:
+            pid = int(open(self.pid_file).read())
+            os.kill(pid, 0)
+        except (ValueError, OSError):
+            return False
+        return True
+
+    def get_audio_api_flags(self):
+        if platform.system() == "Darwin":
+            return ["-D__MACOSX_CORE__"], ["-framework CoreFoundation", "-framework CoreAudio", "-lpthread"]
+        modules = self.templates.properties['rtaudio_api']
+        if modules.count('pulse') > 0:
+            return ['-D__LINUX_PULSE__'], ['-lpthread', '-lpulse-simple', '-lpulse']
+        elif modules.count('jack') > 0:
+            return ['-D__UNIX_JACK__'], ["-ljack", '-lpthread']
+        return ['-D__LINUX_ALSA__'], ["-lasound", '-lpthread']
+
+    def run_build_command(self, args):
+        self.log(args)
+        if platform.system() == "Darwin":
+            # ck_out didn't work properly on OS X
+            os.system(' '.join(args))
+        else:
+            outtext = ck_out(args)
+            self.log(outtext)
+
+    def compile_driver(self):
+        if platform.system() == "Darwin":
+            cpp_compiler = "/usr/bin/c++"
+        else:
+            cpp_compiler = "/usr/bin/g++"
+        flags = ["-I" + self.platform_dir + "/include",
+                 "-I"+ self.out_dir + "/rtaudio",
+                 "-O3" ,
+                 "-std=c++11",
+                 "-DNDEBUG"]
+        flags += self.defines + self.compile_flags
+        source_files = [self.out_file, self.driver_file]
+        for f in source_files:
+            short_f = f[f.rindex("/") + 1:]
+            args = [cpp_compiler] + flags + ["-o" + short_f + ".o", "-c", f]
+            self.run_build_command(args)
+        args = [cpp_compiler, "-O3", "-std=c++11", "-DNDEBUG"]
+        args += [f[f.rindex("/") + 1:] + ".o" for f in source_files]
+        args += ["-o" + self.out_dir + "/" + self.target_name]
+        args += self.build_flags + self.link_flags
+        self.run_build_command(args)
+
+    def compile_library(self):
+        if platform.system() == "Darwin":
+            cpp_compiler = "/usr/bin/c++"
+        else:
+            cpp_compiler = "/usr/bin/g++"
+        api_defines, api_link_flags = self.get_audio_api_flags()
+        flags = ["-I" + self.platform_dir + "/include",
+                 "-I"+ self.out_dir + "/rtaudio",
+                 "-O3" ,
+                 "-std=c++11",
+                 "-DNDEBUG"]
+        flags += api_defines + self.defines + self.compile_flags
+
+        # The library is renamed into place so the host never loads a
+        # partially written file
+        args = [cpp_compiler] + flags
+        args += ["-fPIC", "-shared", "-fvisibility=hidden",
+                 "-o" + self.dsp_library + ".tmp",
+                 self.out_file]
+        args += self.build_flags + self.link_flags
+        self.run_build_command(args)
+        os.rename(self.dsp_library + ".tmp", self.dsp_library)
+
+        host_file = self.out_dir + "/host.cpp"
+        host_target = self.out_dir + "/" + self.target_name
+        if os.path.exists(host_target) and os.path.getmtime(host_target) > os.path.getmtime(host_file):
+            return
+        source_files = [host_file]
+        if os.path.exists(self.out_dir + "/rtaudio/RtAudio.cpp"):
+            source_files.append(self.out_dir + "/rtaudio/RtAudio.cpp")
+        for f in source_files:
+            short_f = f[f.rindex("/") + 1:]
+            args = [cpp_compiler] + flags + ["-o" + short_f + ".o", "-c", f]
+            self.run_build_command(args)
+        args = [cpp_compiler, "-O3", "-std=c++11", "-DNDEBUG"]
+        args += [f[f.rindex("/") + 1:] + ".o" for f in source_files]
+        args += ["-o" + host_target]
+        args += api_link_flags
+        if platform.system() == "Linux":
+            args += ["-ldl"]
+        self.run_build_command(args)
+
 # Compile --------------------------
     def compile(self):
 
@@ -229,6 +425,16 @@ class Generator(GeneratorBase):
 
         os.chdir(self.out_dir)
 
+        if self.render or self.null_device is not None:
+            self.compile_driver()
+            self.log("Platform code compilation finished!")
+            return
+
+        if self.library_build:
+            self.compile_library()
+            self.log("Platform code compilation finished!")
+            return
+
         if platform.system() == "Windows":
 
             source_files = [self.out_file, self.out_dir + "/rtaudio/RtAudio.cpp"]
@@ -237,13 +443,14 @@ class Generator(GeneratorBase):
             for f in source_files:
                 short_f = f[f.rindex("/") + 1:]
                 flags = ["-std=c++11",
-                         "-I"+ self.platform_dir +"include",
+                         "-I"+ self.platform_dir +"/include",
                          "-O3",
                          "-DNDEBUG",
                          "-D__WINDOWS_WASAPI__",
                          "-Irtaudio/include"
                          "-o " + short_f + ".o",
                          "-c "+ f]
+                flags += self.defines + self.compile_flags
 
                 args = [cpp_compiler] + flags
 
@@ -307,12 +514,13 @@ class Generator(GeneratorBase):
             for f in source_files:
                 short_f = f[f.rindex("/") + 1:]
                 args = [cpp_compiler,
-#                        "-I" + self.platform_dir + "/include",
+                        "-I" + self.platform_dir + "/include",
                         "-I"+ self.out_dir + "/rtaudio",
                         "-O3" ,
                         "-std=c++11",
                         "-DNDEBUG"]
                 args += defines
+                args += self.defines + self.compile_flags
                 args += ["-o" + short_f + ".o",
                          "-c",
                          f]
@@ -352,6 +560,7 @@ class Generator(GeneratorBase):
             for f in source_files:
                 short_f = f[f.rindex("/") + 1:]
                 args = [cpp_compiler,
+                        "-I" + self.platform_dir + "/include",
                         "-I"+ self.out_dir + "/rtaudio",
                         "-O3" ,
                         "-std=c++11",
@@ -361,6 +570,7 @@ class Generator(GeneratorBase):
                          "-o" + short_f + ".o",
                          "-c",
                          f]
+                args += self.defines + self.compile_flags
 
                 self.log(args)
 
@@ -399,11 +609,26 @@ class Generator(GeneratorBase):
     def run(self):
 
         os.chdir(self.out_dir)
+        if self.hot_reload and self.host_is_running():
+            self.log("Host running, new DSP will be swapped in.")
+            return
         self.log("Running: " + self.out_dir + "/" + self.target_name)
         self.log("Running in directory: " + self.out_dir)
 
         args = [self.out_dir + "/" + self.target_name]
-        outtext = ck_out(args)
+        if self.render:
+            args += [self.render.get('input', '-') or '-',
+                     self.render['output'],
+                     str(self.render.get('seconds', 0))]
+        elif self.null_device is not None:
+            args += [str(self.null_device.get('seconds', 10)),
+                     '1' if self.null_device.get('loopback', False) else '0']
+        try:
+            outtext = ck_out(args)
+        except subprocess.CalledProcessError as e:
+            # The null device exits with an error when deadlines are missed
+            self.log(e.output)
+            raise
         self.log(outtext)
 #        self.process = ExternalProcess()
 
@@ -42,6 +42,310 @@ class Templates(BaseCTemplate):
 
         self.framework = "RtAudio"
 
+        # Must be a power of two
+        self.bridge_fifo_size = 64
+        # Longest string that can cross a bridge, including the terminator
+        self.bridge_string_size = 256
+
+        self.str_stream_scheduler = '''
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#ifdef __linux__
+#include <pthread.h>
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+typedef void (*_StreamGroupFunction)(MY_TYPE *in, MY_TYPE *out, unsigned int nBufferFrames);
+
+// Runs independent groups of streams on a fixed pool of worker threads.
+// Each block, the audio thread and the workers claim groups from a shared
+// counter until none are left. The audio thread then waits for all groups
+// to finish before returning the block. Idle workers spin briefly and then
+// park until the next block. On Linux they sleep on a futex on the block
+// counter, so the audio thread wakes them with one system call and never
+// takes a lock. Elsewhere they keep spinning, backing off with short sleeps.
+class _StreamScheduler {
+public:
+    _StreamScheduler(const _StreamGroupFunction *groups, int numGroups, int numWorkers) :
+        m_groups(groups), m_numGroups(numGroups), m_numWorkers(numWorkers) {}
+    ~_StreamScheduler() { stop(); }
+
+    void start() {
+        unsigned int numCores = std::thread::hardware_concurrency();
+        m_running.store(true, std::memory_order_release);
+        for (int i = 0; i < m_numWorkers; i++) {
+            m_workers.push_back(std::thread(&_StreamScheduler::workerLoop, this));
+#ifdef __linux__
+            if (numCores > 1) {
+                // Keep workers off core 0, so the audio thread (which is
+                // not pinned) and the system always have a free core
+                cpu_set_t cpuset;
+                CPU_ZERO(&cpuset);
+                CPU_SET(1 + (i % (numCores - 1)), &cpuset);
+                pthread_setaffinity_np(m_workers.back().native_handle(), sizeof(cpu_set_t), &cpuset);
+            }
+#endif
+        }
+    }
+
+    void stop() {
+        if (m_running.exchange(false)) {
+            // Moving the block counter releases workers parked on it
+            m_block.fetch_add(1, std::memory_order_seq_cst);
+            wakeWorkers();
+            for (auto &worker : m_workers) {
+                worker.join();
+            }
+            m_workers.clear();
+        }
+    }
+
+    // Called from the audio callback once per block
+    void process(MY_TYPE *in, MY_TYPE *out, unsigned int nBufferFrames) {
+        m_in = in;
+        m_out = out;
+        m_frames = nBufferFrames;
+        m_done.store(0, std::memory_order_relaxed);
+        m_next.store(0, std::memory_order_release);
+        m_block.fetch_add(1, std::memory_order_seq_cst);
+        // A worker counts itself as parked before it sleeps, and only
+        // sleeps if the block counter hasn't moved, so it can't miss this
+        if (m_parked.load(std::memory_order_seq_cst) > 0) {
+            wakeWorkers();
+        }
+        runGroups();
+        int spins = 0;
+        while (m_done.load(std::memory_order_acquire) < m_numGroups) {
+            if (++spins < SPIN_COUNT) {
+                cpuPause();
+            } else {
+                // A worker holding a group may have been preempted
+                spins = 0;
+                std::this_thread::yield();
+            }
+        }
+    }
+
+private:
+    void runGroups() {
+        int group;
+        while ((group = m_next.fetch_add(1, std::memory_order_acq_rel)) < m_numGroups) {
+            m_groups[group](m_in, m_out, m_frames);
+            m_done.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    void workerLoop() {
+#ifdef STRIDE_REALTIME
+        stride_rt::promote_thread();
+        stride_rt::flush_denormals();
+#endif
+        unsigned int block = m_block.load(std::memory_order_acquire);
+        int idle = 0;
+        while (m_running.load(std::memory_order_acquire)) {
+            unsigned int currentBlock = m_block.load(std::memory_order_acquire);
+            if (currentBlock != block) {
+                block = currentBlock;
+                idle = 0;
+                if (m_running.load(std::memory_order_acquire)) {
+                    runGroups();
+                }
+            } else if (++idle < SPIN_COUNT) {
+                std::this_thread::yield();
+            } else {
+                park(block);
+                idle = 0;
+            }
+        }
+    }
+
+    void park(unsigned int block) {
+#ifdef __linux__
+        static_assert(sizeof(std::atomic<unsigned int>) == sizeof(unsigned int),
+                      "The block counter must be a plain word to wait on it");
+        m_parked.fetch_add(1, std::memory_order_seq_cst);
+        // The kernel only sleeps while the counter still holds block
+        syscall(SYS_futex, reinterpret_cast<unsigned int *>(&m_block),
+                FUTEX_WAIT_PRIVATE, block, nullptr, nullptr, 0);
+        m_parked.fetch_sub(1, std::memory_order_relaxed);
+#else
+        (void) block;
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+#endif
+    }
+
+    void wakeWorkers() {
+#ifdef __linux__
+        syscall(SYS_futex, reinterpret_cast<unsigned int *>(&m_block),
+                FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#endif
+    }
+
+    static inline void cpuPause() {
+#if defined(__SSE2__) || defined(_M_X64)
+        _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        __asm__ __volatile__("yield");
+#endif
+    }
+
+    static const int SPIN_COUNT = 64;
+
+    const _StreamGroupFunction *m_groups;
+    const int m_numGroups;
+    const int m_numWorkers;
+    std::vector<std::thread> m_workers;
+    std::atomic<bool> m_running {false};
+    std::atomic<unsigned int> m_block {0};
+    std::atomic<int> m_next {0};
+    std::atomic<int> m_done {0};
+    std::atomic<int> m_parked {0};
+    MY_TYPE *m_in {nullptr};
+    MY_TYPE *m_out {nullptr};
+    unsigned int m_frames {0};
+};
+'''
+
+        self.str_bridge_declaration = '''
+// Latest value channel for signals bridged between domains running on
+// different threads. The writer publishes, the reader always sees the
+// most recent complete value.
+template<typename T>
+class _BridgeLatest {
+public:
+    _BridgeLatest &operator=(const T &value) {
+        m_value.store(value, std::memory_order_release);
+        return *this;
+    }
+    operator T() const { return m_value.load(std::memory_order_acquire); }
+
+private:
+    std::atomic<T> m_value {T()};
+};
+
+// Single producer/single consumer queue for event signals bridged between
+// domains. Each update() takes every event written since the previous
+// cycle, so none arrives late. The reader sees the last of them for the
+// whole cycle: events that arrive within one reader cycle collapse into
+// the last value. Writes are dropped if more than Size - 1 events arrive
+// within one reader cycle.
+template<typename T, int Size>
+class _BridgeFifo {
+public:
+    _BridgeFifo &operator=(const T &value) {
+        int write = m_write.load(std::memory_order_relaxed);
+        int next = (write + 1) & (Size - 1);
+        if (next != m_read.load(std::memory_order_acquire)) {
+            m_data[write] = value;
+            m_write.store(next, std::memory_order_release);
+        }
+        return *this;
+    }
+    // Called by the reading domain once per cycle
+    void update() {
+        int read = m_read.load(std::memory_order_relaxed);
+        int write = m_write.load(std::memory_order_acquire);
+        if (read != write) {
+            m_current = m_data[(write - 1) & (Size - 1)];
+            m_read.store(write, std::memory_order_release);
+        }
+    }
+    operator T() const { return m_current; }
+
+private:
+    static_assert((Size & (Size - 1)) == 0, "Bridge size must be a power of two");
+    T m_data[Size];
+    T m_current {T()};
+    std::atomic<int> m_write {0};
+    std::atomic<int> m_read {0};
+};
+
+// String bridges copy values through fixed size character slots, so
+// neither side allocates or touches the other side's std::string. The
+// reader's copy is refreshed in update() and stays valid for the whole
+// cycle. Strings longer than Capacity - 1 characters are truncated.
+template<int Capacity>
+struct _BridgeStringSlot {
+    char data[Capacity];
+    size_t length {0};
+
+    void set(const std::string &value) { length = value.copy(data, Capacity - 1); }
+};
+
+// Latest value string bridge. A triple buffer: the writer fills its own
+// slot and swaps it with the shared one, the reader swaps the shared slot
+// with its own only when a new value was published.
+template<int Capacity>
+class _BridgeStringLatest {
+public:
+    _BridgeStringLatest() { m_current.reserve(Capacity); }
+    _BridgeStringLatest &operator=(const std::string &value) {
+        m_slots[m_back].set(value);
+        m_back = m_shared.exchange(m_back | FRESH, std::memory_order_acq_rel) & INDEX;
+        return *this;
+    }
+    // Called by the reading domain once per cycle
+    void update() {
+        if (m_shared.load(std::memory_order_relaxed) & FRESH) {
+            m_front = m_shared.exchange(m_front, std::memory_order_acq_rel) & INDEX;
+            m_current.assign(m_slots[m_front].data, m_slots[m_front].length);
+        }
+    }
+    operator const std::string &() const { return m_current; }
+
+private:
+    static const int INDEX = 3;
+    static const int FRESH = 4;
+    _BridgeStringSlot<Capacity> m_slots[3];
+    int m_back {0};
+    std::atomic<int> m_shared {1};
+    int m_front {2};
+    std::string m_current;
+};
+
+// Event string bridge, drains pending writes each cycle like _BridgeFifo
+template<int Capacity, int Size>
+class _BridgeStringFifo {
+public:
+    _BridgeStringFifo() { m_current.reserve(Capacity); }
+    _BridgeStringFifo &operator=(const std::string &value) {
+        int write = m_write.load(std::memory_order_relaxed);
+        int next = (write + 1) & (Size - 1);
+        if (next != m_read.load(std::memory_order_acquire)) {
+            m_slots[write].set(value);
+            m_write.store(next, std::memory_order_release);
+        }
+        return *this;
+    }
+    // Called by the reading domain once per cycle
+    void update() {
+        int read = m_read.load(std::memory_order_relaxed);
+        int write = m_write.load(std::memory_order_acquire);
+        if (read != write) {
+            int last = (write - 1) & (Size - 1);
+            m_current.assign(m_slots[last].data, m_slots[last].length);
+            m_read.store(write, std::memory_order_release);
+        }
+    }
+    operator const std::string &() const { return m_current; }
+
+private:
+    static_assert((Size & (Size - 1)) == 0, "Bridge size must be a power of two");
+    _BridgeStringSlot<Capacity> m_slots[Size];
+    std::string m_current;
+    std::atomic<int> m_write {0};
+    std::atomic<int> m_read {0};
+};
+'''
+
     def process_code(self, code):
         code = code.replace("%%device%%", str(self.properties['audio_device']))
         code = code.replace("%%block_size%%", str(self.properties['block_size']))
@@ -51,6 +355,78 @@ class Templates(BaseCTemplate):
 
         return code
 
+    def declaration_bridge(self, vartype, handle, channel, close=True):
+        # Domains run on their own threads, so bridges need to be lock-free
+        # channels
+        value_type = self.bool_type if vartype == 'bool' else self.real_type
+        if vartype == 'string':
+            if channel == 'fifo':
+                declaration = '_BridgeStringFifo<%i, %i> %s'%(self.bridge_string_size, self.bridge_fifo_size, handle)
+            else:
+                declaration = '_BridgeStringLatest<%i> %s'%(self.bridge_string_size, handle)
+        elif channel == 'fifo':
+            declaration = '_BridgeFifo<%s, %i> %s'%(value_type, self.bridge_fifo_size, handle)
+        else:
+            declaration = '_BridgeLatest<%s> %s'%(value_type, handle)
+        if close:
+            declaration += ';\n'
+        return declaration
+
+    def bridge_declaration_code(self):
+        return self.str_bridge_declaration
+
+    def bridge_update_code(self, vartype, handle, channel):
+        if channel == 'fifo' or vartype == 'string':
+            return handle + '.update();\n'
+        return ''
+
+    def stream_scheduler_code(self, group_names, num_workers):
+        code = self.str_stream_scheduler
+        code += 'static const _StreamGroupFunction _stream_groups[] = {%s};\n'%', '.join(group_names)
+        code += '_StreamScheduler _stream_scheduler(_stream_groups, %i, %i);\n'%(len(group_names), num_workers)
+        return code
+
+    def stream_scheduler_start_code(self):
+        return '    _stream_scheduler.start();\n'
+
+    def stream_scheduler_stop_code(self):
+        return '    _stream_scheduler.stop();\n'
+
+    def profile_begin_code(self, site):
+        return 'const uint64_t _probe_%03i = stride_profile::now();\n'%site
+
+    def profile_end_code(self, site):
+        return '_stride_profiler.record(%i, stride_profile::now() - _probe_%03i);\n'%(site, site)
+
+    def profile_call_code(self, site, call):
+        return 'stride_profile::measure(_stride_profiler, %i, [&]() { return %s; })'%(site, call)
+
+    def profile_declaration_code(self):
+        if len(self.profile_sites) == 0:
+            return ''
+        code = '#include "StrideProfile.h"\n'
+        code += 'static const stride_profile::Site _stride_profile_sites[] = {\n'
+        for name, filename, line in self.profile_sites:
+            code += '    {"%s", "%s", %i},\n'%(name, filename.replace('\\', '/'), line)
+        code += '};\n'
+        code += 'stride_profile::Profiler<%i> _stride_profiler(_stride_profile_sites);\n'%len(self.profile_sites)
+        return code
+
+    def profile_report_code(self):
+        if len(self.profile_sites) == 0:
+            return ''
+        return '    _stride_profiler.dump();\n'
+
+    def dsp_state_code(self, entries):
+        # The final empty entry keeps the table valid when there is no state
+        code = 'static const StrideDspState _stride_dsp_state[] = {\n'
+        for name, signature in entries:
+            code += '    STRIDE_DSP_STATE(%s, "%s"),\n'%(name, signature)
+        code += '    {"", "", nullptr, 0}\n'
+        code += '};\n'
+        code += 'static const int _stride_dsp_state_count = %i;\n'%len(entries)
+        return code
+
     def get_config_code(self):
 
         config_template_code = '''
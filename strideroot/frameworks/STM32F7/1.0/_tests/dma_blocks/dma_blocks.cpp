@@ -0,0 +1,196 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+// Checks the STM32F7 audio block processing on a host. audio_block.h is
+// built against the CMSIS-DSP reference sources of the conversions, and
+// driven by a simulated pair of circular I2S DMA streams. Build and run
+// from this directory with the STM32Cube package used by the project:
+//   CMSIS_DSP=$STRIDE_PLATFORM_ROOT/STM32Cube_FW_F7_V1.7.0/Drivers/CMSIS/DSP_Lib/Source
+//   g++ -std=gnu++11 -Ihost -I../../project/Inc dma_blocks.cpp
+//       -x c++ $CMSIS_DSP/SupportFunctions/arm_q15_to_float.c
+//       -x c++ $CMSIS_DSP/SupportFunctions/arm_float_to_q15.c -o dma_blocks
+//   ./dma_blocks
+//
+// The simulation advances one q15 sample at a time. The receive DMA
+// stores each sample once it has been clocked in and raises the half and
+// complete callbacks after the last sample of each half. The transmit
+// DMA fetches each sample one sample ahead of sending it. A callback is
+// given almost half a buffer of time to process: its output only lands
+// in the transmit buffer when that time is over.
+//
+// The test checks that:
+//  - the output is the per sample conversion of the processed input,
+//    delayed by exactly one buffer.
+//  - the transmit DMA never reads a half while it is being processed.
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "audio_block.h"
+
+namespace {
+
+const int kTxLead = 1;
+const int kProcessingTime = AUDIO_HALF_BUFFER_SIZE - kTxLead;
+const int kBuffers = 64;
+
+q15_t I2S_TX_Buffer[AUDIO_BUFFER_SIZE];
+q15_t I2S_RX_Buffer[AUDIO_BUFFER_SIZE];
+float32_t Audio_In[AUDIO_HALF_BUFFER_SIZE];
+float32_t Audio_Out[AUDIO_HALF_BUFFER_SIZE];
+
+// Stands in for the generated stream code. The gain above 1 on the second
+// channel drives the output conversion into saturation.
+void process_frame(uint16_t i)
+{
+    Audio_Out[i * AUDIO_CHANNELS] = Audio_In[i * AUDIO_CHANNELS] * 0.5f;
+    Audio_Out[i * AUDIO_CHANNELS + 1] = Audio_In[i * AUDIO_CHANNELS + 1] * -1.5f + 0.1f;
+}
+
+float32_t process_sample(float32_t value, int channel)
+{
+    return channel == 0 ? value * 0.5f : value * -1.5f + 0.1f;
+}
+
+// Per sample conversions, as the audio domain did them before it worked on
+// whole blocks
+float32_t reference_q15_to_float(q15_t value)
+{
+    q15_t in = value;
+    float32_t out;
+    arm_q15_to_float(&in, &out, 1);
+    return out;
+}
+
+q15_t reference_float_to_q15(float32_t value)
+{
+    q15_t out;
+    arm_float_to_q15(&value, &out, 1);
+    return out;
+}
+
+int half_of(long position)
+{
+    return (position / AUDIO_HALF_BUFFER_SIZE) % 2;
+}
+
+} // namespace
+
+int main()
+{
+    const long length = (long) kBuffers * AUDIO_BUFFER_SIZE;
+    std::vector<q15_t> input(length);
+    uint32_t seed = 22695477;
+    for (long i = 0; i < length; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        input[i] = (q15_t) (seed >> 16);
+    }
+    input[0] = -32768;
+    input[1] = 32767;
+
+    std::vector<q15_t> output(length);
+    long pendingTime = -1;
+    int pendingHalf = 0;
+    q15_t pendingBlock[AUDIO_HALF_BUFFER_SIZE];
+    int failures = 0;
+
+    for (long t = 0; t < length; t++) {
+        // Processing started by an earlier callback finishes
+        if (t == pendingTime) {
+            if (half_of(t + kTxLead) == pendingHalf) {
+                std::printf("Transmit DMA reached half %i before it was processed (t=%li)\n", pendingHalf, t);
+                failures++;
+            }
+            for (int i = 0; i < AUDIO_HALF_BUFFER_SIZE; i++) {
+                I2S_TX_Buffer[pendingHalf * AUDIO_HALF_BUFFER_SIZE + i] = pendingBlock[i];
+            }
+            pendingTime = -1;
+        }
+        // Transmit DMA fetches ahead, so the sample sent now was read earlier
+        long fetched = t + kTxLead;
+        if (fetched < length) {
+            if (pendingTime >= 0 && half_of(fetched) == pendingHalf) {
+                std::printf("Transmit DMA read half %i while it was being processed (t=%li)\n", pendingHalf, t);
+                failures++;
+            }
+            output[fetched] = I2S_TX_Buffer[fetched % AUDIO_BUFFER_SIZE];
+        }
+        if (t < kTxLead) {
+            output[t] = 0;
+        }
+        // Receive DMA stores the sample that has just been clocked in
+        I2S_RX_Buffer[t % AUDIO_BUFFER_SIZE] = input[t];
+        int position = t % AUDIO_BUFFER_SIZE;
+        if (position == AUDIO_HALF_BUFFER_SIZE - 1 || position == AUDIO_BUFFER_SIZE - 1) {
+            int half = half_of(t);
+            // Output is computed from the buffers as they are now, but is
+            // only written to the transmit buffer kProcessingTime later
+            q15_t saved[AUDIO_HALF_BUFFER_SIZE];
+            q15_t *txHalf = I2S_TX_Buffer + half * AUDIO_HALF_BUFFER_SIZE;
+            for (int i = 0; i < AUDIO_HALF_BUFFER_SIZE; i++) {
+                saved[i] = txHalf[i];
+            }
+            Audio_ProcessBlock(I2S_TX_Buffer, I2S_RX_Buffer, half, Audio_In, Audio_Out, process_frame);
+            for (int i = 0; i < AUDIO_HALF_BUFFER_SIZE; i++) {
+                pendingBlock[i] = txHalf[i];
+                txHalf[i] = saved[i];
+            }
+            pendingHalf = half;
+            pendingTime = t + kProcessingTime;
+        }
+    }
+
+    long mismatches = 0;
+    for (long t = 0; t < length; t++) {
+        q15_t expected = 0;
+        if (t >= AUDIO_BUFFER_SIZE) {
+            int channel = t % AUDIO_CHANNELS;
+            float32_t value = reference_q15_to_float(input[t - AUDIO_BUFFER_SIZE]);
+            expected = reference_float_to_q15(process_sample(value, channel));
+        }
+        if (output[t] != expected) {
+            if (mismatches < 10) {
+                std::printf("Sample %li: got %i expected %i\n", t, output[t], expected);
+            }
+            mismatches++;
+        }
+    }
+    failures += mismatches > 0 ? 1 : 0;
+
+    std::printf("%li samples through %i buffers of %i frames: %li mismatches\n",
+                length, kBuffers, AUDIO_BLOCK_FRAMES, mismatches);
+    std::printf(failures == 0 ? "PASS\n" : "FAIL\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,75 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#ifndef AUDIO_BLOCK_H
+#define AUDIO_BLOCK_H
+
+#include "arm_math.h"
+
+// Audio is exchanged with the codec through two circular DMA buffers of
+// interleaved q15 samples, one for I2S transmit and one for I2S receive.
+// Each buffer holds two halves of AUDIO_BLOCK_FRAMES frames. The audio
+// domain runs once per half, when the receive DMA reports it full.
+//
+// This header has no HAL dependencies so the block logic can be checked
+// on a host against the CMSIS-DSP sources, see _tests/dma_blocks.
+
+#define AUDIO_CHANNELS					2
+#define AUDIO_BLOCK_FRAMES				32
+#define AUDIO_HALF_BUFFER_SIZE			(AUDIO_BLOCK_FRAMES * AUDIO_CHANNELS)
+#define AUDIO_BUFFER_SIZE				(AUDIO_HALF_BUFFER_SIZE * 2)
+
+// Processes one half of the DMA buffers. half is 0 on the receive DMA's
+// half transfer and 1 on its transfer complete. That half of rx_buffer has
+// just been filled, and the transmit DMA, which runs a sample ahead of the
+// receive DMA on the same clock, has moved on to the other half of
+// tx_buffer. The half is converted to float in a single block call, the
+// frames are processed one by one through process(i) and the result is
+// converted back in a single block call.
+template<typename Process>
+inline void Audio_ProcessBlock(q15_t *tx_buffer, q15_t *rx_buffer, int half,
+							   float32_t *audio_in, float32_t *audio_out,
+							   Process process)
+{
+	q15_t *tx_block = tx_buffer + half * AUDIO_HALF_BUFFER_SIZE;
+	q15_t *rx_block = rx_buffer + half * AUDIO_HALF_BUFFER_SIZE;
+	arm_q15_to_float(rx_block, audio_in, AUDIO_HALF_BUFFER_SIZE);
+	for (uint16_t i = 0; i < AUDIO_BLOCK_FRAMES; i++)
+	{
+		process(i);
+	}
+	arm_float_to_q15(audio_out, tx_block, AUDIO_HALF_BUFFER_SIZE);
+}
+
+#endif // AUDIO_BLOCK_H
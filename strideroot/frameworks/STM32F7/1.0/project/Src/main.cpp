@@ -43,6 +43,8 @@
 #include "usart.h"
 #include "gpio.h"
 #include "fmc.h"
+#include "arm_math.h"
+#include "audio_block.h"
 
 /* USER CODE BEGIN Includes */
 //[[Includes]]
@@ -62,7 +64,6 @@
 #define SI5351C_NUM_REGS                75
 #define AK4558_NUM_REGS					5
 
-#define AUDIO_BUFFER_SIZE				4
 #define UART_BUFFER_SIZE				10
 #define DFSDM_BUFFER_SIZE				32
 
@@ -175,7 +176,12 @@
 
   uint8_t LED = 0;
   q15_t I2S_TX_Buffer[AUDIO_BUFFER_SIZE] = {0};
-  q15_t *I2S_TX_Buffer_p = (q15_t *) I2S_TX_Buffer;
+  q15_t I2S_RX_Buffer[AUDIO_BUFFER_SIZE] = {0};
+
+  // Interleaved staging buffers for one DMA half-buffer. The stream code
+  // reads and writes these per frame, the conversion is done per block
+  float32_t Audio_In[AUDIO_HALF_BUFFER_SIZE] = {0};
+  float32_t Audio_Out[AUDIO_HALF_BUFFER_SIZE] = {0};
 
 //[[Declarations]]
 //[[/Declarations]]
@@ -324,7 +330,12 @@ int main(void)
     Error_Handler();
   }
 
-  // Start Audio DMA
+  // Start Audio DMA. Receive is started first so it is waiting for the
+  // clock when transmit starts, and both run in step from then on.
+  if (HAL_I2S_Receive_DMA(&hi2s3, (uint16_t *) I2S_RX_Buffer, AUDIO_BUFFER_SIZE) != HAL_OK)
+  {
+    Error_Handler();
+  }
   if (HAL_I2S_Transmit_DMA(&hi2s2, (uint16_t *) I2S_TX_Buffer, AUDIO_BUFFER_SIZE) != HAL_OK)
   {
     Error_Handler();
@@ -472,18 +483,25 @@ void SystemClock_Config(void)
 }
 
 /* USER CODE BEGIN 4 */
-void HAL_I2S_TxHalfCpltCallback(I2S_HandleTypeDef *hi2s)
+// Runs the audio domain on the half of the DMA buffers that has just been
+// received, see audio_block.h
+void Audio_ProcessHalf(int half)
 {
-	for (uint8_t i = 0; i < (AUDIO_BUFFER_SIZE / 4); i++)
-	{
+	Audio_ProcessBlock(I2S_TX_Buffer, I2S_RX_Buffer, half, Audio_In, Audio_Out,
+					   [](uint16_t i) {
 //[[AudioProcessing]]
 //[[/AudioProcessing]]
-	}
+	});
+}
+
+void HAL_I2S_RxHalfCpltCallback(I2S_HandleTypeDef *hi2s)
+{
+	Audio_ProcessHalf(0);
 }
 
-void HAL_I2S_TxCpltCallback(I2S_HandleTypeDef *hi2s)
+void HAL_I2S_RxCpltCallback(I2S_HandleTypeDef *hi2s)
 {
-	HAL_I2S_TxHalfCpltCallback(hi2s);
+	Audio_ProcessHalf(1);
 }
 
 void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart)
@@ -42,6 +42,7 @@ except:
     unicode = str # for python 3
 
 import re
+import math
 
 class BaseCTemplate(object):
     def __init__(self):
@@ -49,11 +50,19 @@ class BaseCTemplate(object):
         self.properties = {}
         self.included = [] # Accumulates include statements
 
+        self.profiling = False # Set by the generator for profiling builds
+        self.profile_sites = []
+
         self.rate_stack = []
         self.rate_nested = 0
         self.rate_counter = 0
         self.domain_rate = None
 
+        self.resampling = False # Filter signals crossing rate boundaries
+        self.resampler_counter = 0
+        self.resampler_max_ratio = 16
+        self.resampler_taps_per_phase = 8
+
         self.str_true = "true"
         self.str_false = "false"
         self.stream_begin_code = '// Starting stream %02i -------------------------\n ' #{\n'
@@ -329,13 +338,46 @@ public:
             declaration += ';\n'
         return declaration
 
-    def declaration_module(self, moduletype, handle, instance_consts = [], close=True):
-        declaration = moduletype + ' ' + handle
-        if len(instance_consts) > 0:
-            declaration += '{'
-            for value in instance_consts:
-                declaration += str(value)
-            declaration += '}'
+    def declaration_module(self, moduletype, handle, instance_consts = [], template_consts = False, close=True):
+        declaration = moduletype
+        if len(instance_consts) > 0 and template_consts:
+            declaration += '<' + ', '.join([str(int(value)) for value in instance_consts]) + '>'
+        declaration += ' ' + handle
+        if len(instance_consts) > 0 and not template_consts:
+            declaration += '{' + ', '.join([str(value) for value in instance_consts]) + '}'
+        if close:
+            declaration += ';\n'
+        return declaration
+
+    def module_consts_are_template(self, instance_consts):
+        ''' Instance constants that are port sizes are passed as template
+        parameters so the compiler can specialize the module. The choice
+        depends on which properties the module reads, not on their values, so
+        it is the same for every instance of a module type. '''
+        if len(instance_consts) == 0:
+            return False
+        for info in instance_consts.values():
+            if not info.get('property') == 'size':
+                return False
+            value = info['value']
+            if type(value) == bool or not type(value) in [int, float] or not float(value).is_integer():
+                return False
+        return True
+
+    def declaration_template_const(self, name):
+        # Instance constants are real values in module code, so arithmetic
+        # like 1 / Output.size is not done in integers.
+        return 'static constexpr %s %s = _%s;\n'%(self.real_type, name, name)
+
+    def definition_template_const(self, module_name, const_names, name):
+        # Out of line definition, needed in C++11 when the member is odr-used
+        # (e.g. bound to a const reference)
+        template_args = ', '.join(['int _' + const_name for const_name in const_names])
+        args = ', '.join(['_' + const_name for const_name in const_names])
+        return 'template<%s> constexpr %s %s<%s>::%s;\n'%(template_args, self.real_type, module_name, args, name)
+
+    def declaration_module_array(self, moduletype, handle, size, close=True):
+        declaration = moduletype + ' %s[%i]'%(handle, size)
         if close:
             declaration += ';\n'
         return declaration
@@ -347,11 +389,69 @@ public:
         return declaration
 
     def declaration_buffer(self, buffer_type, handle, size, close=True):
-        declaration = buffer_type + ' ' + handle + '{%i}'%size
+        declaration = buffer_type + '<%i> '%size + handle
         if close:
             declaration += ';\n'
         return declaration
 
+    def declaration_bridge(self, vartype, handle, channel, close=True):
+        ''' Signal bridges are plain variables unless the framework runs
+        domains on separate threads. channel is 'latest' for rate driven
+        signals and 'fifo' for event (rate 0) signals. '''
+        if vartype == 'bool':
+            return self.declaration_bool(handle, close)
+        elif vartype == 'string':
+            return self.declaration_string(handle, close)
+        return self.declaration_real(handle, close)
+
+    def bridge_declaration_code(self):
+        ''' Support code needed by declaration_bridge() '''
+        return ''
+
+    def bridge_update_code(self, vartype, handle, channel):
+        ''' Code run once per cycle by the reading domain of a bridge '''
+        return ''
+
+    # Profiling -------------------------------------------------------------
+    # Frameworks that support profiling override these to produce probes
+    # around streams and module calls. Sites map probes to .stride lines.
+    def profile_site(self, name, filename, line):
+        self.profile_sites.append([name, filename, line])
+        return len(self.profile_sites) - 1
+
+    def profile_begin_code(self, site):
+        return ''
+
+    def profile_end_code(self, site):
+        return ''
+
+    def profile_call_code(self, site, call):
+        return call
+
+    def profile_declaration_code(self):
+        return ''
+
+    def profile_report_code(self):
+        return ''
+
+    # Parallel processing of independent stream groups ----------------------
+    def stream_scheduler_code(self, group_names, num_workers):
+        ''' Runtime that runs the group functions each block. Frameworks that
+        return an empty string process streams serially. '''
+        return ''
+
+    def stream_scheduler_start_code(self):
+        return ''
+
+    def stream_scheduler_stop_code(self):
+        return ''
+
+
+    def declaration_constexpr_real(self, name, value, close=True):
+        declaration = "constexpr " + self.real_type + " " + name + " = " + str(value)
+        if close:
+            declaration += ';\n'
+        return declaration
 
     def declaration_const_real(self, name, default, close=True):
         declaration = "const " + self.real_type + " " + name + " = " + str(default)
@@ -359,6 +459,13 @@ public:
             declaration += ';\n'
         return declaration
 
+    def lane_loop_code(self, lane, size, code):
+        ''' Runs code once for each instance in an array of module lanes '''
+        final_code = 'for (int %s = 0; %s < %i; %s++) {\n'%(lane, lane, size, lane)
+        final_code += code
+        final_code += "}\n"
+        return final_code
+
     def conditional_code(self, condition, code):
         final_code =  "if (" + condition + ") {\n"
         final_code += code
@@ -527,8 +634,111 @@ public:
         else:
             return ''
 
+    # Resampling across rate boundaries --------------------------------------
+    def resampler_kernel(self, ratio):
+        ''' Blackman windowed sinc low pass for an integer ratio. The cutoff
+        is just below the Nyquist frequency of the slower rate. '''
+        size = ratio * self.resampler_taps_per_phase
+        cutoff = 0.45/ratio
+        center = (size - 1)/2.0
+        kernel = []
+        for n in range(size):
+            x = n - center
+            if x == 0:
+                value = 2 * cutoff
+            else:
+                value = math.sin(2 * math.pi * cutoff * x)/(math.pi * x)
+            window = 0.42 - 0.5 * math.cos(2 * math.pi * n/(size - 1)) + 0.08 * math.cos(4 * math.pi * n/(size - 1))
+            kernel.append(value * window)
+        total = sum(kernel)
+        return [value/total for value in kernel]
+
+    def resampler_instance_code(self, index, coefficients, history_size):
+        # The history is stored twice so the filter reads it without wrapping
+        code = self.declaration_bundle_real('_resample_hist_%03i'%index, history_size * 2)
+        code += self.declaration_int('_resample_pos_%03i'%index)
+        code += self.declaration_int('_resample_phase_%03i'%index)
+        code += self.declaration_real('_resample_out_%03i'%index)
+        code += 'const %s _resample_coeffs_%03i[%i] = {%s};\n'%(self.real_type, index, len(coefficients),
+                ', '.join([self.value_real(float('%.9g'%c)) for c in coefficients]))
+        return code
+
+    def resampler_init_code(self, index, history_size):
+        code = 'for (int _i = 0; _i < %i; _i++) { _resample_hist_%03i[_i] = 0.0; }\n'%(history_size * 2, index)
+        code += self.assignment('_resample_pos_%03i'%index, '0')
+        code += self.assignment('_resample_phase_%03i'%index, '0')
+        code += self.assignment('_resample_out_%03i'%index, '0.0')
+        return code
+
+    def resampler_push_code(self, index, token, history_size):
+        code = '_resample_hist_%03i[_resample_pos_%03i] = %s;\n'%(index, index, token)
+        code += '_resample_hist_%03i[_resample_pos_%03i + %i] = %s;\n'%(index, index, history_size, token)
+        code += 'if (++_resample_pos_%03i == %i) { _resample_pos_%03i = 0; }\n'%(index, history_size, index)
+        code += self.assignment('_resample_phase_%03i'%index, '0')
+        return code
+
+    def decimator(self, token, ratio):
+        ''' Polyphase decimation: the input is pushed at the faster rate, the
+        filter is only evaluated when the slower rate ticks.
+        Returns instance, init, code before and after the rate change and the
+        output token '''
+        index = self.resampler_counter
+        self.resampler_counter += 1
+        kernel = self.resampler_kernel(ratio)
+        size = len(kernel)
+        inst_code = self.resampler_instance_code(index, kernel[::-1], size)
+        init_code = self.resampler_init_code(index, size)
+        pre_code = self.resampler_push_code(index, token, size)
+        post_code = self.assignment('_resample_out_%03i'%index, '0.0')
+        post_code += 'for (int _k = 0; _k < %i; _k++) {\n'%size
+        post_code += '_resample_out_%03i += _resample_coeffs_%03i[_k] * _resample_hist_%03i[_resample_pos_%03i + _k];\n'%(index, index, index, index)
+        post_code += '}\n'
+        return inst_code, init_code, pre_code, post_code, '_resample_out_%03i'%index
+
+    def interpolator(self, token, ratio):
+        ''' Polyphase interpolation: each pass of the faster rate evaluates
+        only the filter phase for that sub-sample. '''
+        index = self.resampler_counter
+        self.resampler_counter += 1
+        kernel = self.resampler_kernel(ratio)
+        taps = self.resampler_taps_per_phase
+        # Rows are phases, taps reversed to match the history order
+        coefficients = []
+        for phase in range(ratio):
+            coefficients += [ratio * kernel[phase + (taps - 1 - k) * ratio] for k in range(taps)]
+        inst_code = self.resampler_instance_code(index, coefficients, taps)
+        init_code = self.resampler_init_code(index, taps)
+        pre_code = self.resampler_push_code(index, token, taps)
+        post_code = self.assignment('_resample_out_%03i'%index, '0.0')
+        post_code += 'for (int _k = 0; _k < %i; _k++) {\n'%taps
+        post_code += '_resample_out_%03i += _resample_coeffs_%03i[_resample_phase_%03i * %i + _k] * _resample_hist_%03i[_resample_pos_%03i + _k];\n'%(index, index, index, taps, index, index)
+        post_code += '}\n'
+        post_code += 'if (++_resample_phase_%03i == %i) { _resample_phase_%03i = 0; }\n'%(index, ratio, index)
+        return inst_code, init_code, pre_code, post_code, '_resample_out_%03i'%index
+
+    def ramp(self, token, step):
+        ''' Linear ramp to each new value of a slower signal, reaching it
+        after one period of the slower rate. '''
+        index = self.resampler_counter
+        self.resampler_counter += 1
+        value = '_ramp_value_%03i'%index
+        target = '_ramp_target_%03i'%index
+        increment = '_ramp_step_%03i'%index
+        inst_code = self.declaration_real(value) + self.declaration_real(target) + self.declaration_real(increment)
+        init_code = self.assignment(value, '0.0') + self.assignment(target, '0.0') + self.assignment(increment, '0.0')
+        post_code = 'if (%s != %s) {\n'%(token, target)
+        post_code += self.assignment(target, token)
+        post_code += self.assignment(increment, '(%s - %s) * %s'%(target, value, self.value_real(float('%.9g'%step))))
+        post_code += '}\n'
+        post_code += 'if ((%s - %s) * (%s - %s) > %s * %s) {\n'%(target, value, target, value, increment, increment)
+        post_code += self.increment(value, increment)
+        post_code += '} else {\n'
+        post_code += self.assignment(value, target)
+        post_code += '}\n'
+        return inst_code, init_code, '', post_code, value
+
     # Module code ------------------------------------------------------------
-    def module_declaration(self, name, header_code, init_code, process_code, instance_consts = {}):
+    def module_declaration(self, name, header_code, init_code, process_code, instance_consts = {}, template_consts = False):
 
         out_type = 'void'
 
@@ -555,7 +765,15 @@ public:
 
             process_functions += self.str_function_declaration%(out_type, 'process_' + str(domain), input_declaration, domain_proc_code)
 
-        for const_name, props in instance_consts.items():
+        const_names = sorted(instance_consts.keys())
+        if template_consts and len(const_names) > 0:
+            template_args = ', '.join(['int _' + const_name for const_name in const_names])
+            declaration = 'template<%s>'%template_args
+            declaration += self.str_module_declaration%(name, header_code, name, '', init_code, process_functions)
+            for const_name in const_names:
+                declaration += self.definition_template_const(name, const_names, const_name)
+            return declaration
+        for const_name in const_names:
             constructor_args += "float _" + const_name + ","
         if len(constructor_args) > 0 and constructor_args[-1] == ',':
             constructor_args = constructor_args[:-1]
@@ -566,7 +784,7 @@ public:
         code = handle + '.set_' + port_name + '(' + in_tokens[0] + ');'
         return code
 
-    def module_processing_code(self, handle, in_tokens, out_tokens, domain_name):
+    def module_processing_code(self, handle, in_tokens, out_tokens, domain_name, line = -1, filename = ''):
         code = handle + '.process_' + str(domain_name) + '('
         for in_token in in_tokens:
             code += in_token + ", "
@@ -576,6 +794,9 @@ public:
         if (len(in_tokens) > 0 and len(out_tokens) == 0) or (len(out_tokens) > 0):
             code = code[:-2] # Chop off extra comma
         code += ')'
+        if self.profiling:
+            site = self.profile_site(handle + '.process_' + str(domain_name), filename, line)
+            code = self.profile_call_code(site, code)
         return code
 
     def module_output_code(self, output_block):
@@ -688,6 +909,12 @@ public:
     def buffer_processing_bundle_output_code(self, buffer_name, token):
         return buffer_name + ".copy(%s)"%token
 
+    def buffer_processing_block_input_code(self, buffer_name, token, size):
+        return buffer_name + ".write_n(%s, %i)"%(token, size)
+
+    def buffer_processing_block_output_code(self, buffer_name, token, size):
+        return buffer_name + ".read_n(%s, %i)"%(token, size)
+
     # Configuration code -----------------------------------------------------
     def get_config_code(self):
         config_template_code = '''
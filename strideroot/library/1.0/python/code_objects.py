@@ -102,6 +102,22 @@ class BundleInstance(Instance):
     def get_bundle_type(self):
         return self.vartype
 
+class ConstantInstance(Instance):
+    # Constants keep the value type, but can be declared so their value is
+    # known to the compiler
+    pass
+
+class BridgeInstance(Instance):
+    def __init__(self, code, scope, domain, vartype, handle, channel, atom, post = True):
+        super(BridgeInstance, self).__init__(code, scope, domain, vartype, handle, atom, post)
+        self.channel = channel
+
+    # get_type() keeps returning the value type so bridges are read and
+    # initialized like any other signal
+
+    def get_channel(self):
+        return self.channel
+
 class ModuleInstance(Instance):
     def __init__(self, scope, domain, vartype, handle, atom, instance_consts, post = True):
         super(ModuleInstance, self).__init__('', scope, domain, vartype, handle, atom, post)
@@ -117,6 +133,13 @@ class ModuleInstance(Instance):
     def get_instance_consts(self):
         return self.instance_consts
 
+class ModuleArrayInstance(ModuleInstance):
+    def __init__(self, scope, domain, vartype, handle, size, atom, post = True):
+        super(ModuleArrayInstance, self).__init__(scope, domain, vartype, handle, atom, [], post)
+        self.size = size
+
+    def get_size(self):
+        return self.size
 
 class Declaration(Code):
     def __init__(self, scope, domain, name, code):
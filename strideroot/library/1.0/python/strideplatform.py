@@ -38,7 +38,7 @@ from __future__ import division
 
 
 from platformTemplates import templates
-from code_objects import Instance, BundleInstance, ModuleInstance, BufferInstance, Declaration
+from code_objects import Instance, BundleInstance, ModuleInstance, ModuleArrayInstance, BufferInstance, BridgeInstance, ConstantInstance, Declaration
 
 try:
     unicode_exists_test = type('a') == unicode
@@ -247,6 +247,8 @@ class ExpressionAtom(Atom):
         if right_atom:
             if not self.domain == right_atom.get_domain() and right_atom.get_domain() is not None:
                 print("ERROR! domains must match inside expressions!")
+        self.shared_handle = None
+        self.computes_shared = False
 
     def set_inline(self, inline):
         self.left_atom.set_inline(inline)
@@ -254,6 +256,23 @@ class ExpressionAtom(Atom):
             self.right_atom.set_inline(inline)
         self.inline = inline
 
+    def set_shared_value(self, handle, domain, compute):
+        ''' The value of this expression is stored in handle and shared with
+        other streams. Only the atom with compute set calculates it. '''
+        self.shared_handle = handle
+        self.shared_domain = domain
+        self.computes_shared = compute
+
+    def get_handles(self):
+        if self.shared_handle:
+            return [self.shared_handle]
+        return super(ExpressionAtom, self).get_handles()
+
+    def get_out_tokens(self):
+        if self.shared_handle:
+            return [self.shared_handle]
+        return super(ExpressionAtom, self).get_out_tokens()
+
     def get_declarations(self):
         declarations = self.left_atom.get_declarations()
         if self.right_atom:
@@ -264,13 +283,20 @@ class ExpressionAtom(Atom):
         instances = self.left_atom.get_instances()
         if self.right_atom:
             instances += self.right_atom.get_instances()
-        if not self.is_inline():
+        if not self.is_inline() and not self.shared_handle:
             instances.append(Instance('',
                                       self.scope_index,
                                       self.domain,
                                       self._expression_out_type(),
                                       self.handle,
                                       self))
+        if self.shared_handle:
+            instances.append(Instance('',
+                                      self.scope_index,
+                                      self.shared_domain,
+                                      self._expression_out_type(),
+                                      self.shared_handle,
+                                      self))
         return instances
 
     def get_inline_processing_code(self, in_tokens):
@@ -310,7 +336,13 @@ class ExpressionAtom(Atom):
         #domain = None
         processing_code = {self.domain: ['', []]}
         right_tokens = []
-        if self.is_inline():
+        if self.shared_handle and not self.computes_shared:
+            processing_code[self.domain] = ['', [self.shared_handle]]
+        elif self.shared_handle and self.is_inline():
+            code = templates.assignment(self.shared_handle,
+                                        self.get_inline_processing_code(in_tokens))
+            processing_code[self.domain] = [code, [self.shared_handle]]
+        elif self.is_inline():
             out_tokens = [self.get_inline_processing_code(in_tokens)]
             processing_code[self.domain] = ['', out_tokens]
         else:
@@ -330,10 +362,12 @@ class ExpressionAtom(Atom):
                     right_tokens = self.right_atom.get_out_tokens()[0]
 
 
-            processing_code[self.domain][0] += templates.assignment(self.handle,
+            # A shared value is computed straight into its handle
+            handle = self.shared_handle if self.shared_handle else self.handle
+            processing_code[self.domain][0] += templates.assignment(handle,
                                          self._operator_symbol(self.left_atom.get_out_tokens()[0],
                                                                right_tokens))
-            processing_code[self.domain][1] += [self.handle]
+            processing_code[self.domain][1] += [handle]
         return processing_code #{domain: [code, out_tokens]}
 
     def get_postprocessing_code(self, in_tokens):
@@ -416,13 +450,28 @@ class ListAtom(Atom):
         self.rate = -1
         self.inline = True
 
+        # Lists of identical modules (e.g. from Osc[16] >> Oscillator()) are
+        # placed in an array so they can be processed in a single loop
+        self.lane_handle = None
+        if self._is_module_lanes():
+            self.lane_handle = list_node[0].handle + '_lanes'
+            self.lane_in_handle = '_' + self.lane_handle + '_in'
+            self.lane_out_handle = '_' + self.lane_handle + '_out'
+            for i, elem in enumerate(list_node):
+                elem.set_handle(templates.bundle_indexing(self.lane_handle, i))
+                if len(elem.out_tokens) > 0:
+                    elem.out_tokens = [templates.bundle_indexing(self.lane_out_handle, i)]
+
         self.handles = [elem.get_handles() for elem in list_node] # TODO make this recursive
         self.out_tokens = []
         for elem in list_node:
             self.out_tokens += elem.get_out_tokens()
         self.instances = []
-        for elem in list_node:
-            self.instances += elem.get_instances()
+        if self.lane_handle:
+            self.instances = self._get_lane_instances()
+        else:
+            for elem in list_node:
+                self.instances += elem.get_instances()
 
         element_rates = [elem.get_rate() for elem in list_node]
 
@@ -489,6 +538,10 @@ class ListAtom(Atom):
         return code
 
     def get_processing_code(self, in_tokens):
+        if self.lane_handle:
+            lane_code = self._get_lane_processing_code(in_tokens)
+            if lane_code:
+                return lane_code
         proc_code = {}
         list_domain = self._get_list_domain()
         for i,elem in enumerate(self.list_node):
@@ -528,6 +581,87 @@ class ListAtom(Atom):
                 postproc += new_postproc
         return postproc
 
+    def _is_module_lanes(self):
+        if len(self.list_node) < 2:
+            return False
+        first = self.list_node[0]
+        for elem in self.list_node:
+            if not type(elem) == ModuleAtom:
+                return False
+            if not elem.name == first.name or not elem.domain == first.domain:
+                return False
+            if len(elem.instance_consts) > 0 or len(elem.out_tokens) > 1:
+                return False
+            for block in elem._input_blocks + elem._output_blocks:
+                if 'size' in block or not elem.get_block_types(block)[0] in ['real', 'bool']:
+                    return False
+        return True
+
+    def _get_lane_instances(self):
+        first = self.list_node[0]
+        size = len(self.list_node)
+        lane_names = [elem.handle for elem in self.list_node] + self.out_tokens
+        instances = []
+        for elem in self.list_node:
+            for inst in elem.get_instances():
+                if not inst.get_name() in lane_names:
+                    instances.append(inst)
+        lane_instances = [ModuleArrayInstance(first.scope_index, first.domain,
+                                              first.name, self.lane_handle,
+                                              size, first)]
+        if len(first._input_blocks) > 0:
+            lane_instances.append(BundleInstance('', first.scope_index, first.domain,
+                                                 first.get_block_types(first._input_blocks[0])[0],
+                                                 self.lane_in_handle, size, first))
+        if len(first.out_tokens) > 0:
+            lane_instances.append(BundleInstance('', first.scope_index, first.domain,
+                                                 first.get_block_types(first._output_blocks[0])[0],
+                                                 self.lane_out_handle, size, first))
+        for lane_instance in lane_instances:
+            for elem in self.list_node:
+                elem.code_declaration.add_dependent(lane_instance)
+        return instances + lane_instances
+
+    def _get_lane_processing_code(self, in_tokens):
+        ''' Processing code for all lanes in a single loop. Returns None if
+        the code for each lane differs by more than the lane index, e.g. when
+        lanes have different property values. '''
+        lane = '_lane'
+        lane_handles = [self.lane_handle, self.lane_in_handle, self.lane_out_handle]
+        bodies = []
+        profiling = templates.profiling
+        templates.profiling = False # Lanes are profiled as a single site
+        for i, elem in enumerate(self.list_node):
+            elem_in_tokens = []
+            if len(in_tokens) > 0:
+                elem_in_tokens = [templates.bundle_indexing(self.lane_in_handle, i)]
+            for domain, [code, out_tokens] in elem.get_processing_code(elem_in_tokens).items():
+                for handle in lane_handles:
+                    code = code.replace(templates.bundle_indexing(handle, i),
+                                        templates.bundle_indexing(handle, lane))
+                bodies.append([domain, code])
+        templates.profiling = profiling
+        if not len(bodies) == len(self.list_node):
+            return None
+        for body in bodies:
+            if not body == bodies[0]:
+                return None
+
+        domain, body = bodies[0]
+        code = ''
+        for i in range(len(self.list_node)):
+            if len(in_tokens) > 0:
+                code += templates.assignment(templates.bundle_indexing(self.lane_in_handle, i),
+                                             in_tokens[i % len(in_tokens)])
+        loop_code = templates.lane_loop_code(lane, len(self.list_node), body)
+        if templates.profiling:
+            first = self.list_node[0]
+            site = templates.profile_site('%s (%i lanes)'%(self.lane_handle, len(self.list_node)),
+                                          first.get_filename(), first.get_line())
+            loop_code = templates.profile_begin_code(site) + loop_code + templates.profile_end_code(site)
+        code += loop_code
+        return {domain : [code, list(self.out_tokens)]}
+
     def _get_list_domain(self):
         for elem in self.list_node:
             new_domain = elem.get_domain()
@@ -547,6 +681,8 @@ class NameAtom(Atom):
         self.declaration = declaration
         self.domain = None
         self.signalbridge = None # Stores signalbridge name if applicable
+        self.bridge_reader = False
+        self.bridge_channel = 'latest'
         self.token_index = token_index
 
         if 'domain' in self.declaration['ports']:
@@ -565,11 +701,13 @@ class NameAtom(Atom):
             else:
                 domainProp = self.declaration['ports']['inputDomain']
                 external_domain = previous_atom.get_domain()
+            self.bridge_reader = not previous_atom
 
             if type(domainProp) == dict:
                 self.domain = domainProp['name']['name']
             else:
                 self.domain = domainProp
+            self.bridge_channel = self._get_bridge_channel()
 
         if self.declaration['type'] == 'signal':
             # TODO we need checking of scope and domain here
@@ -610,6 +748,22 @@ class NameAtom(Atom):
                 self.rate = declaration['ports']['rate']
 
 
+    def _get_bridge_channel(self):
+        # Event signals (rate 0) must not lose values when crossing domains,
+        # everything else only needs the latest value
+        rate = None
+        if 'rate' in self.declaration['ports']:
+            rate = self.declaration['ports']['rate']
+        original = self.platform.find_declaration_in_tree(self.declaration['ports']['signal'])
+        if original:
+            if original['type'] == 'trigger':
+                return 'fifo'
+            if rate is None and 'rate' in original['ports']:
+                rate = original['ports']['rate']
+        if (type(rate) == int or type(rate) == float) and rate == 0:
+            return 'fifo'
+        return 'latest'
+
     def get_declarations(self):
         declarations = []
         if 'declarations' in self.platform_type['block']:
@@ -619,6 +773,10 @@ class NameAtom(Atom):
                                                 "_dec_%03i"%self.token_index, # This gives it a unique "id"... hacky
                                                 dec['value'] + '\n'))
                 self.platform_type['block']['ports']['declarations'] = [] # declarations have been consumed
+        if self.declaration['type'] == 'signalbridge':
+            bridge_code = templates.bridge_declaration_code()
+            if bridge_code:
+                declarations.append(Declaration(0, self.domain, "_bridge_channels", bridge_code))
         return declarations
 
     def get_instances(self):
@@ -665,31 +823,34 @@ class NameAtom(Atom):
                                      self)]
         elif 'type' in self.declaration and self.declaration['type'] == 'signalbridge':
             if self.declaration['ports']['bridgeType'] == 'switch':
-                inits = [Instance(default_value,
+                inits = [BridgeInstance(default_value,
                                  self.declaration['stack_index'],
                                  self.domain,
                                  'bool',
                                  self.handle,
+                                 self.bridge_channel,
                                  self
                                  )]
 
             elif signal_type_string(self.declaration):
-                inits = [Instance(default_value,
+                inits = [BridgeInstance(default_value,
                                  self.declaration['stack_index'],
                                  self.domain,
                                  'string',
                                  self.handle,
+                                 self.bridge_channel,
                                  self
                                  )]
             else:
-                inits = [Instance(str(default_value),
+                inits = [BridgeInstance(str(default_value),
                                  self.declaration['stack_index'],
                                  self.domain,
                                  'real',
                                  self.handle,
+                                 self.bridge_channel,
                                  self)]
         elif 'type' in self.declaration and self.declaration['type'] == 'constant':
-            inits = [Instance(str(default_value),
+            inits = [ConstantInstance(str(default_value),
                                  self.declaration['stack_index'],
                                  self.domain,
                                  'real',
@@ -795,6 +956,16 @@ class NameAtom(Atom):
         return code
 
     def get_preproc_once(self):
+        if self.bridge_reader:
+            if self.declaration['ports']['bridgeType'] == 'switch':
+                vartype = 'bool'
+            elif signal_type_string(self.declaration):
+                vartype = 'string'
+            else:
+                vartype = 'real'
+            update_code = templates.bridge_update_code(vartype, self.handle, self.bridge_channel)
+            if update_code:
+                return [['_bridge_' + self.handle, update_code]]
         if 'block' in self.platform_type and self.platform_type['block']['type'] == "platformType":
             if not self.platform_type['block']['ports']['preProcessingOnce'] == '':
                 return [[self.platform_type['block']['ports']['name'], self.platform_type['block']['ports']['preProcessingOnce']]]
@@ -991,7 +1162,7 @@ class PortPropertyAtom(Atom):
                         if not resolved_value:
                             self.resolve_output_port_property(parent_stack[:-1], atom, handle)
                         else:
-                            parent.add_instance_const(handle, 'integer', resolved_value)
+                            parent.add_instance_const(handle, 'integer', resolved_value, portproperty['name'])
                         break
                 elif isinstance(out_block, ListAtom):
                 # FIXME There needs to be a way to know what member of the list we are actually connectiong to...
@@ -1002,14 +1173,14 @@ class PortPropertyAtom(Atom):
                                 if not resolved_value:
                                     self.resolve_output_port_property(parent_stack[:-1], atom, handle)
                                 else:
-                                    parent.add_instance_const(handle, 'integer', resolved_value)
+                                    parent.add_instance_const(handle, 'integer', resolved_value, portproperty['name'])
                 elif isinstance(out_block, ModuleAtom):
                     if portproperty['name'] in out_block.function:
                         resolved_value = out_block.function[portproperty['name']]
                         if not resolved_value:
                             self.resolve_output_port_property(parent_stack[:-1], atom, handle)
                         else:
-                            parent.add_instance_const(handle, 'integer', resolved_value)
+                            parent.add_instance_const(handle, 'integer', resolved_value, portproperty['name'])
                 else:
                     self.platform.log_debug("ERROR: Can't resolve port property value")
         else:
@@ -1210,6 +1381,11 @@ class ModuleAtom(Atom):
             return
         self.inline = inline
 
+    def set_handle(self, handle):
+        ''' Renames the instance, e.g. to place it in an array of lanes '''
+        self.initialization_code = self.initialization_code.replace(self.handle + '.', handle + '.')
+        self.handle = handle
+
     def _prepare_declaration(self):
         header_code = ''
         init_code = ''
@@ -1242,9 +1418,17 @@ class ModuleAtom(Atom):
                     if block['ports']['domain'] == domain:
                         process_code[domain]['output_blocks'].append(block)
 
-        for const_name, const_info in self.instance_consts.items():
-            init_code += templates.assignment(const_name, "_" + const_name)
-            header_code += templates.declaration_real(const_name);
+        # All instances share one class declaration, so the first instance
+        # decides for the module type
+        if not self.name in self.platform.module_template_consts:
+            self.platform.module_template_consts[self.name] = templates.module_consts_are_template(self.instance_consts)
+        template_consts = self.platform.module_template_consts[self.name]
+        for const_name in sorted(self.instance_consts.keys()):
+            if template_consts:
+                header_code += templates.declaration_template_const(const_name)
+            else:
+                init_code += templates.assignment(const_name, "_" + const_name)
+                header_code += templates.declaration_real(const_name);
 
 
         for domain, code in domain_code.items():
@@ -1256,7 +1440,7 @@ class ModuleAtom(Atom):
         declaration_text = templates.module_declaration(
                 self.name, header_code,
                 init_code, process_code,
-                self.instance_consts)
+                self.instance_consts, template_consts)
 
         self.code_declaration = Declaration(self.module['stack_index'],
                                         self.domain,
@@ -1298,8 +1482,8 @@ class ModuleAtom(Atom):
     def get_instances(self):
         instances = []
         instance_consts = []
-        for name, info in self.instance_consts.items():
-            instance_consts.append(info['value'])
+        for name in sorted(self.instance_consts.keys()):
+            instance_consts.append(self.instance_consts[name]['value'])
         self.instance = ModuleInstance(self.scope_index,
                                  self.domain,
                                  self.name,
@@ -1376,7 +1560,9 @@ class ModuleAtom(Atom):
         code = templates.module_processing_code(self.handle,
                                                 in_tokens,
                                                 out_tokens,
-                                                domain
+                                                domain,
+                                                self.get_line(),
+                                                self.get_filename()
                                                 )
         return code
 
@@ -1461,7 +1647,8 @@ class ModuleAtom(Atom):
             if len(self._output_blocks) > 0 and module_port_domain == self._output_blocks[0]['ports']['domain']:
                 in_tokens += values['handles']
             else:
-                module_call = templates.module_processing_code(self.handle, values['handles'], [], module_port_domain)
+                module_call = templates.module_processing_code(self.handle, values['handles'], [], module_port_domain,
+                                                               self.get_line(), self.get_filename())
                 code += templates.expression(module_call)
 
         if not io_domains_match: # If domains don't match, this function should discard'
@@ -1477,12 +1664,16 @@ class ModuleAtom(Atom):
                                                         in_tokens,
                                                         [],
                                                         self._input_blocks[0]['ports']['domain'],
+                                                        self.get_line(),
+                                                        self.get_filename()
                                                         ))
             if len(self._output_blocks) > 0 and self._output_blocks[0]['main']:
                 code += templates.expression(templates.module_processing_code(self.handle,
                                                         [],
                                                         out_tokens,
-                                                        self._output_blocks[0]['ports']['domain']
+                                                        self._output_blocks[0]['ports']['domain'],
+                                                        self.get_line(),
+                                                        self.get_filename()
                                                         ))
         else:
             if 'output' in self.module and not self.module['output'] is None: #For Platform types
@@ -1690,9 +1881,10 @@ class ModuleAtom(Atom):
             instances += self._get_expression_instances(right)
         return instances
 
-    def add_instance_const(self, name, consttype, value):
+    def add_instance_const(self, name, consttype, value, port_property = None):
         if not name in self.instance_consts:
-            self.instance_consts[name] = {'type': consttype, 'value' : value}
+            self.instance_consts[name] = {'type': consttype, 'value' : value,
+                                          'property': port_property}
 
 class ReactionAtom(ModuleAtom):
     def __init__(self, reaction, function, platform_code, token_index,
@@ -2371,8 +2563,14 @@ class BufferAtom(Atom):
         if self.output_atom:
             if type(self.output_atom) == ListAtom:
                 code = templates.expression(templates.buffer_processing_output_code(self.name,self.handle))
-                for elem in self.output_atom.get_handles()[::-1]:
-                    code += templates.expression(templates.buffer_processing_output_code(self.name,elem[0]))
+                # Read the whole list in one block operation and then
+                # distribute in the same order as reading element by element
+                elements = self.output_atom.get_handles()[::-1]
+                block_name = '_' + self.name + '_%03i_block'%self._index
+                code += templates.declaration_bundle_real(block_name, len(elements))
+                code += templates.expression(templates.buffer_processing_block_output_code(self.name, block_name, len(elements)))
+                for i, elem in enumerate(elements):
+                    code += templates.assignment(elem[0], templates.bundle_indexing(block_name, i))
                 if not self.output_atom.get_domain() in domain_code:
                     domain_code[self.output_atom.get_domain()] = [ code, []]
                 else:
@@ -2425,6 +2623,16 @@ class PlatformFunctions:
         templates.domain_rate = self.sample_rate
         self.unique_id = 0
 
+        self.value_numbering = [] # Stack of shared value contexts, one per scope
+        self.shared_handles = set()
+
+        # Global state, for builds that carry state across reloads
+        self.state_instances = []
+        self.state_declarations = {}
+
+        # Module name -> whether its instance constants are template parameters
+        self.module_template_consts = {}
+
     def log_debug(self, text):
         if self.debug_messages:
             print(text)
@@ -2687,7 +2895,13 @@ class PlatformFunctions:
         return node_groups
 
     def instantiation_code(self, instance):
-        if instance.get_type() == 'real':
+        if type(instance) == BridgeInstance:
+            code = templates.declaration_bridge(instance.get_type(), instance.get_name(), instance.get_channel())
+        elif type(instance) == ModuleArrayInstance:
+            code = templates.declaration_module_array(instance.get_module_type(), instance.get_name(), instance.get_size())
+        elif self.is_compile_time_constant(instance):
+            code = templates.declaration_constexpr_real(instance.get_name(), instance.get_code())
+        elif instance.get_type() == 'real':
             code = templates.declaration_real(instance.get_name())
         elif instance.get_type() == 'bool':
             code = templates.declaration_bool(instance.get_name())
@@ -2701,7 +2915,8 @@ class PlatformFunctions:
             else:
                 raise ValueError("Unsupported bundle type.")
         elif instance.get_type() == 'module':
-            code = templates.declaration_module(instance.get_module_type(), instance.get_name(), instance.get_instance_consts())
+            code = templates.declaration_module(instance.get_module_type(), instance.get_name(), instance.get_instance_consts(),
+                                                self.module_template_consts.get(instance.get_module_type(), False))
         elif instance.get_type() == 'reaction':
             code = templates.declaration_reaction(instance.get_module_type(), instance.get_name())
         elif instance.get_type() == 'buffer':
@@ -2711,8 +2926,64 @@ class PlatformFunctions:
 #        code += templates.source_marker(instance.get_line(), instance.get_filename())
         return code
 
+    def is_compile_time_constant(self, instance):
+        ''' Numeric constants in the global scope are declared constexpr. In
+        class scope they remain members as they would need to be static. '''
+        if not type(instance) == ConstantInstance or not instance.get_scope() == 0:
+            return False
+        try:
+            float(instance.get_code())
+        except ValueError:
+            return False
+        return True
+
+    def get_state_entries(self):
+        ''' Names of global instances with a signature of their declaration
+        and initial value. For modules the signature includes the class, so
+        state is only carried across builds when its layout hasn't changed. '''
+        entries = []
+        for instance, code, init_code in self.state_instances:
+            if code == '':
+                continue
+            signature = code + init_code
+            if isinstance(instance, ModuleInstance) and instance.get_module_type() in self.state_declarations:
+                signature += self.state_declarations[instance.get_module_type()]
+            entries.append([instance.get_name(), hashlib.md5(signature.encode('utf-8')).hexdigest()[:16]])
+        return entries
+
+    def get_resamplers(self, previous_atom, in_tokens, from_rate, to_rate, domain_rate):
+        ''' Selects how real signals are converted across a rate boundary:
+        polyphase FIR decimation or interpolation for integer ratios, and a
+        ramp from slower rates up to the domain rate. Other connections keep
+        sampling the value directly. '''
+        if not templates.resampling or len(in_tokens) == 0:
+            return []
+        if not isinstance(previous_atom, NameAtom) or not previous_atom.declaration['type'] == 'signal':
+            return []
+        if signal_type_string(previous_atom.declaration):
+            return []
+        if not from_rate or from_rate <= 0 or not domain_rate or domain_rate <= 0:
+            return []
+        resamplers = []
+        if to_rate < from_rate:
+            ratio = from_rate/float(to_rate)
+            if ratio == int(ratio) and ratio <= templates.resampler_max_ratio:
+                for token in in_tokens:
+                    resamplers.append(templates.decimator(token, int(ratio)))
+        elif to_rate > domain_rate:
+            ratio = to_rate/float(from_rate)
+            if from_rate == domain_rate and ratio == int(ratio) and ratio <= templates.resampler_max_ratio:
+                for token in in_tokens:
+                    resamplers.append(templates.interpolator(token, int(ratio)))
+        else:
+            for token in in_tokens:
+                resamplers.append(templates.ramp(token, from_rate/float(to_rate)))
+        return resamplers
+
     def initialization_code(self, instance):
         code = ''
+        if self.is_compile_time_constant(instance):
+            return code
         if not instance.get_code() == '':
             if instance.get_type() == 'real':
                 value = instance.get_code()
@@ -2799,14 +3070,14 @@ class PlatformFunctions:
                         type(atom) == ListAtom or type(atom) == ExpressionAtom):
                         for new_inst in new_instances:
                                 # Don't count module instances. You only need its i/o tokens
-                            if not type(new_inst) == ModuleInstance and not type(new_inst) == Declaration:
+                            if not isinstance(new_inst, ModuleInstance) and not type(new_inst) == Declaration:
                                 writes[current_domain].append(new_inst)
                 # It's a read for any but the last
                 if group.index(atom) < len(group) -1:
                     if (type(atom) == NameAtom or type(atom) == BundleAtom or
                         type(atom) == ListAtom or type(atom) == ExpressionAtom):
                         for new_inst in new_instances:
-                            if not type(new_inst) == ModuleInstance and not type(new_inst) == Declaration:
+                            if not isinstance(new_inst, ModuleInstance) and not type(new_inst) == Declaration:
                                 # Don't count module instances. You only need its i/o tokens
                                 reads[current_domain].append(new_inst)
 
@@ -2844,11 +3115,23 @@ class PlatformFunctions:
                     if current_rate == -1 or not current_rate:
                         current_rate = atom.rate
                     elif atom.rate != current_rate:
-                        templates.set_domain_rate(self.get_domain_default_rate(current_domain))
+                        domain_rate = self.get_domain_default_rate(current_domain)
+                        templates.set_domain_rate(domain_rate)
+                        resamplers = self.get_resamplers(previous_atom, in_tokens,
+                                                         current_rate, atom.rate, domain_rate)
+                        for resampler in resamplers:
+                            # Input is taken before leaving the current rate
+                            header_code[current_domain] += resampler[0]
+                            init_code[current_domain] += resampler[1]
+                            processing_code[current_domain] += resampler[2]
                         new_inst, new_init, new_proc = templates.rate_start(atom.rate)
                         processing_code[current_domain] += new_proc
                         header_code[current_domain] += new_inst
                         init_code[current_domain] += new_init
+                        if len(resamplers) > 0:
+                            for resampler in resamplers:
+                                processing_code[current_domain] += resampler[3]
+                            in_tokens = [resampler[4] for resampler in resamplers]
                         # We want to avoid inlining across rate boundaries
                         if previous_atom:
                             previous_atom.set_inline(False)
@@ -2958,15 +3241,18 @@ class PlatformFunctions:
             framework_name = None
         if not framework_name or (framework_name == templates.framework):
             node_groups = self.make_stream_nodes(stream)
+            self.share_stream_value(stream, node_groups)
             first_line = node_groups[0][0].get_line()
             #last_line = node_groups[0][-1].get_line()
             stream_filename = node_groups[0][0].get_filename()
 
             new_code = self.generate_code_from_groups(node_groups, global_groups)
             header_code, init_code, new_processing_code, scope_instances, scope_declarations, reads, writes = new_code
+            platform_writes = self.get_platform_writes(node_groups)
         else:
             stream_filename = ''
             header_code, init_code, new_processing_code, scope_instances, scope_declarations, reads, writes = [{} for i in range(7)]
+            platform_writes = set()
 #        self.log_debug("READS------ " + str(reads) )
 #        self.log_debug("WRITES------ " + str(writes) )
 #        self.log_debug("-- End stream")
@@ -2974,6 +3260,10 @@ class PlatformFunctions:
         for domain in new_processing_code.keys():
             wrapper_begin = templates.stream_begin_code%stream_index + templates.source_marker(first_line, stream_filename)
             wrapper_end =  templates.stream_end_code%stream_index
+            if templates.profiling:
+                site = templates.profile_site('stream %i (%s)'%(stream_index, domain), stream_filename, first_line)
+                wrapper_begin += templates.profile_begin_code(site)
+                wrapper_end = templates.profile_end_code(site) + wrapper_end
             new_processing_code[domain] = wrapper_begin + new_processing_code[domain] + wrapper_end
 
         return {"global_groups" : global_groups,
@@ -2983,9 +3273,237 @@ class PlatformFunctions:
                 "scope_instances": scope_instances,
                 "scope_declarations": scope_declarations,
                 "reads" : reads,
-                "writes" : writes
+                "writes" : writes,
+                "platform_writes" : platform_writes
                 }
 
+    # Value numbering. Streams often start with the same expression, e.g.
+    # 2 * _Pi * Freq / AudioRate. Identical expressions reading the same
+    # versions of the same blocks in a domain are computed once and shared.
+    def get_value_key(self, member):
+        ''' Returns a hashable key for the value of a stream member or None
+        if it can't be shared. Function calls hold state and platform types
+        may have side effects when read, so only expressions over values,
+        constants and signals are numbered. '''
+        if 'expression' in member:
+            expression = member['expression']
+            if 'value' in expression:
+                operands = [expression['value']]
+            else:
+                operands = [expression['left'], expression['right']]
+            key = [expression['type']]
+            for operand in operands:
+                operand_key = self.get_value_key(operand)
+                if operand_key is None:
+                    return None
+                key.append(operand_key)
+            return tuple(key)
+        elif 'value' in member:
+            return ('value', repr(member['value']))
+        elif 'name' in member or 'bundle' in member:
+            if 'name' in member:
+                name = member['name']['name']
+                index = None
+            else:
+                name = member['bundle']['name']
+                index = member['bundle']['index']
+                if not type(index) == int:
+                    return None
+            declaration = self.find_declaration_in_tree(name)
+            if not declaration or not declaration.get('type') in ['signal', 'constant', 'switch', 'signalbridge']:
+                return None
+            versions = self.value_numbering[-1]['versions']
+            return ('name', name, index, versions.get(name, 0), declaration['type'])
+        return None
+
+    def value_key_reads_signal(self, key):
+        if key[0] == 'name':
+            return not key[4] == 'constant'
+        for element in key[1:]:
+            if type(element) == tuple and self.value_key_reads_signal(element):
+                return True
+        return False
+
+    def get_shared_value_key(self, stream):
+        ''' Key for the expression that starts a stream. Only this leading
+        expression is shared: subexpressions, and expressions in function
+        properties or later in the stream, are computed by each stream.
+        Expressions that only use constants are left to the compiler to
+        fold. '''
+        if len(stream) < 2 or not 'expression' in stream[0]:
+            return None
+        key = self.get_value_key(stream[0])
+        if key is None or not self.value_key_reads_signal(key):
+            return None
+        domain = None
+        for member in stream:
+            domain = self.get_stream_member_domain(member)
+            if domain:
+                break
+        # Streams only share values computed at the same rate
+        rate = None
+        for member in stream:
+            rate = self.get_stream_member_rate(member)
+            if rate is not None:
+                break
+        if rate is None:
+            rate = self.get_domain_default_rate(domain)
+        if not (type(rate) == int or type(rate) == float):
+            return None
+        return (domain, rate, self.value_numbering[-1]['epoch'], key)
+
+    def get_stream_member_rate(self, stream_member):
+        ''' Rate set on a stream member, or None if it has none of its own.
+        Rates that are not resolved to a number are returned as they are. '''
+        rate = None
+        if 'name' in stream_member or 'bundle' in stream_member:
+            if 'name' in stream_member:
+                name = stream_member['name']['name']
+            else:
+                name = stream_member['bundle']['name']
+            declaration = self.find_declaration_in_tree(name)
+            if declaration and 'ports' in declaration and 'rate' in declaration['ports']:
+                rate = declaration['ports']['rate']
+        elif 'function' in stream_member:
+            rate = stream_member['function'].get('rate')
+        if (type(rate) == int or type(rate) == float) and rate <= 0:
+            return None
+        return rate
+
+    def update_value_versions(self, stream):
+        ''' Invalidate shared values that read blocks this stream writes '''
+        context = self.value_numbering[-1]
+        for i, member in enumerate(stream):
+            elements = member['list'] if 'list' in member else [member]
+            for element in elements:
+                name = None
+                if 'name' in element:
+                    name = element['name']['name']
+                elif 'bundle' in element:
+                    name = element['bundle']['name']
+                elif 'function' in element:
+                    declaration = self.find_declaration_in_tree(element['function']['name'])
+                    if not declaration or declaration['type'] in ['reaction', 'loop']:
+                        # These can write to any block in scope
+                        context['epoch'] += 1
+                if name and i > 0:
+                    context['versions'][name] = context['versions'].get(name, 0) + 1
+
+    def count_shared_values(self, tree):
+        context = {'versions' : {}, 'epoch' : 0, 'counts' : {}, 'handles' : {}}
+        self.value_numbering.append(context)
+        for node in tree:
+            if 'stream' in node:
+                key = self.get_shared_value_key(node['stream'])
+                if key:
+                    context['counts'][key] = context['counts'].get(key, 0) + 1
+                self.update_value_versions(node['stream'])
+        self.value_numbering.pop()
+        context['versions'] = {}
+        context['epoch'] = 0
+        return context
+
+    def share_stream_value(self, stream, node_groups):
+        if len(self.value_numbering) == 0 or len(node_groups[0]) == 0:
+            return
+        context = self.value_numbering[-1]
+        key = self.get_shared_value_key(stream)
+        atom = node_groups[0][0]
+        if key is None or context['counts'].get(key, 0) < 2 or not type(atom) == ExpressionAtom:
+            return
+        if key in context['handles']:
+            atom.set_shared_value(context['handles'][key], key[0], False)
+        else:
+            handle = '__shared_%03i'%atom.index
+            context['handles'][key] = handle
+            self.shared_handles.add(handle)
+            atom.set_shared_value(handle, key[0], True)
+
+    def get_platform_writes(self, node_groups):
+        ''' Names for the hardware outputs a stream writes. Platform types
+        produce no instances, so their writes are not in the stream's
+        writes. Channels of a bundle count separately when the platform
+        code indexes by channel, otherwise the whole bundle is one name. '''
+        platform_writes = set()
+        for group in node_groups:
+            for atom in group[1:]:
+                if not isinstance(atom, NameAtom) or not 'block' in atom.platform_type:
+                    continue
+                block = atom.platform_type['block']
+                if not block['type'] == 'platformType' or len(block['ports'].get('inputs', [])) == 0:
+                    continue
+                indexed = '%%bundle_index%%' in block['ports'].get('processing', '')
+                if type(atom) == BundleAtom and indexed:
+                    if type(atom.index) == int:
+                        platform_writes.add(templates.bundle_indexing(atom.handle, atom.index))
+                    else:
+                        # Unknown channel, may write any of them
+                        for i in range(atom.declaration['size']):
+                            platform_writes.add(templates.bundle_indexing(atom.handle, i))
+                elif type(atom) == BundleAtom or not 'size' in atom.declaration or not indexed:
+                    platform_writes.add(atom.handle)
+                else:
+                    for i in range(atom.declaration['size']):
+                        platform_writes.add(templates.bundle_indexing(atom.handle, i))
+        return platform_writes
+
+    def get_stream_state(self, stream_code):
+        ''' Names a stream touches and the subset it modifies. Module, buffer
+        and reaction instances hold state, so using them counts as a write. '''
+        names = set()
+        writes = set()
+        for inst in stream_code['scope_instances']:
+            if isinstance(inst, Instance):
+                names.add(inst.get_name())
+                if inst.get_type() in ['module', 'buffer', 'reaction']:
+                    writes.add(inst.get_name())
+                elif inst.get_name() in self.shared_handles:
+                    # Streams sharing a value must run in the same group
+                    writes.add(inst.get_name())
+        for domain, read in stream_code['reads'].items():
+            names.update([inst.get_name() for inst in read])
+        for domain, write in stream_code['writes'].items():
+            writes.update([inst.get_name() for inst in write])
+        writes.update(stream_code['platform_writes'])
+        names.update(writes)
+        return {'names' : names, 'writes' : writes}
+
+    def group_independent_streams(self, stream_states):
+        ''' Partition streams into groups that share no modified state, so
+        each group can be processed on its own. Returns lists of stream
+        indeces, keeping source order within and across groups. '''
+        parents = list(range(len(stream_states)))
+        def find(i):
+            while parents[i] != i:
+                parents[i] = parents[parents[i]]
+                i = parents[i]
+            return i
+
+        written = set()
+        for state in stream_states:
+            written.update(state['writes'])
+        owners = {}
+        for i, state in enumerate(stream_states):
+            for name in state['names'] & written:
+                if name in owners:
+                    root = find(i)
+                    owner_root = find(owners[name])
+                    if not root == owner_root:
+                        parents[root] = owner_root
+                else:
+                    owners[name] = i
+
+        groups = {}
+        roots = []
+        for i in range(len(stream_states)):
+            root = find(i)
+            if not root in groups:
+                groups[root] = []
+                roots.append(root)
+            groups[root].append(i)
+        # Roots can change while merging, so order by first stream
+        return sorted([groups[root] for root in roots], key = lambda group: group[0])
+
     def get_domains(self):
         domains = []
         for node in self.tree:
@@ -3127,6 +3645,7 @@ class PlatformFunctions:
 
         self.log_debug("* New Generation ----- scopes: " + str(len(self.scope_stack)))
         self.push_scope(current_scope, parent)
+        self.value_numbering.append(self.count_shared_values(tree))
 
         other_scope_instances = []
         other_scope_declarations = []
@@ -3170,6 +3689,7 @@ class PlatformFunctions:
                         "processing_code" : [] }
                     domain_code[domain]["init_code"] += init_code
 
+                stream_state = self.get_stream_state(code)
                 for domain, processing_code in code["processing_code"].items():
                     if not domain:
                         domain = self.get_platform_domain()
@@ -3178,10 +3698,14 @@ class PlatformFunctions:
                         "init_code" : '',
                         "processing_code" : [] }
                     domain_code[domain]["processing_code"].append(processing_code)
+                    if not "stream_states" in domain_code[domain]:
+                        domain_code[domain]["stream_states"] = []
+                    domain_code[domain]["stream_states"].append(stream_state)
 
                 scope_declarations += code["scope_declarations"]
                 scope_instances += code["scope_instances"]
                 stream_index += 1
+                self.update_value_versions(node["stream"])
 
                 for domain, read in code['reads'].items():
                     if not domain in reads:
@@ -3243,6 +3767,8 @@ class PlatformFunctions:
                             "init_code" : '',
                             "processing_code" : [] }
                     domain_code[new_element_domain]['header_code'] += new_element.get_code()
+                    if len(self.scope_stack) == 1:
+                        self.state_declarations[new_element.get_name()] = new_element.get_code()
 #                    self.log_debug('////// ' + new_element.get_name() + ' // Dependents : '+ ' '.join([e.get_name() for e in new_element.get_dependents()]))
 
                 elif type(new_element) == Instance or issubclass(type(new_element), Instance):
@@ -3253,8 +3779,11 @@ class PlatformFunctions:
                             "processing_code" : [] }
                     new_inst_code = self.instantiation_code(new_element)
                     domain_code[new_element_domain]["header_code"] += new_inst_code
-                    domain_code[new_element_domain]["init_code"] +=  self.initialization_code(new_element)
+                    new_init_code = self.initialization_code(new_element)
+                    domain_code[new_element_domain]["init_code"] += new_init_code
                     instanced.append(new_element)
+                    if len(self.scope_stack) == 1 and not type(new_element) in [ConstantInstance, BridgeInstance]:
+                        self.state_instances.append([new_element, new_inst_code, new_init_code])
 #                    self.log_debug('////// ' + new_element.get_name() + ' // Dependents : '+ ' '.join([e.get_name() for e in new_element.get_dependents()]))
 
             else:
@@ -3263,6 +3792,7 @@ class PlatformFunctions:
                 else:
                     other_scope_declarations.append(new_element)
 
+        self.value_numbering.pop()
         self.pop_scope()
 #        self.log_debug("* Ending Generation ----- scopes: " + str(len(self.scope_stack)))
 
@@ -3278,6 +3808,7 @@ from subprocess import check_output as ck_out
 import platform
 import os
 import json
+import hashlib
 
 class GeneratorBase(object):
     def __init__(self, out_dir = '',
@@ -3300,10 +3831,26 @@ class GeneratorBase(object):
         self.templates = templates
         self.platform = PlatformFunctions(self.tree, debug)
 
+        # Worker threads used to process independent streams in parallel.
+        # 0 processes all streams serially in the domain function
+        self.parallel_workers = 0
+        if 'ParallelStreams' in self.config and self.config['ParallelStreams']:
+            self.parallel_workers = int(self.config['ParallelStreams'])
+
+        # Filter or ramp signals crossing rate boundaries instead of
+        # sampling them directly
+        if 'Resampling' in self.config and self.config['Resampling']:
+            templates.resampling = True
+
         self.last_num_outs = 0
 
         self.written_sections = []
 
+        # Set by frameworks that build the generated code as a reloadable
+        # library. Domains then use their domainLibraryFunction, and leave
+        # their initialization and cleanup to the host.
+        self.library_build = False
+
     def log(self, text):
         print(text)
 
@@ -3339,6 +3886,7 @@ class GeneratorBase(object):
         config_code = templates.get_configuration_code(code['global_groups']['initializations'])
         self.write_section_in_file(platform_domain['ports']['initializationTag'], template_init_code + config_code, filename)
         processing_code = {}
+        stream_states = {}
 
         # Write generated code
         for domain,sections in code['domain_code'].items():
@@ -3353,8 +3901,11 @@ class GeneratorBase(object):
                         self.platform.log_debug("--- Domain none.")
                         #self.platform.log_debug('\n'.join(sections['processing_code']))
                     if not domain in processing_code:
-                        processing_code[domain] = ""
-                    processing_code[domain] += '\n'.join(sections['processing_code'])
+                        processing_code[domain] = []
+                        stream_states[domain] = []
+                    processing_code[domain] += sections['processing_code']
+                    if 'stream_states' in sections:
+                        stream_states[domain] += sections['stream_states']
 
                     self.write_section_in_file(platform_domain['ports']['declarationsTag'], sections['header_code'], filename)
                     self.write_section_in_file(platform_domain['ports']['initializationTag'], sections['init_code'], filename)
@@ -3365,32 +3916,84 @@ class GeneratorBase(object):
             if not domain_matched:
                 self.platform.log_debug('WARNING: Domain not matched: ' + str(domain))
 
+        # The platform domain goes last, as its initialization may block
+        # while other domains need to have started their own threads
+        domain_order = [d for d in processing_code if not d == self.platform.get_platform_domain()]
+        domain_order += [d for d in processing_code if d == self.platform.get_platform_domain()]
+
+        # Split domains that support it into groups of independent streams
+        stream_groups = {}
+        if self.parallel_workers > 0 and not self.library_build:
+            for domain in domain_order:
+                for platform_domain in domains:
+                    if platform_domain['ports']['domainName'] == domain and not platform_domain['ports']['domainGroupFunction'] == '':
+                        if len(stream_states[domain]) == len(processing_code[domain]):
+                            groups = self.platform.group_independent_streams(stream_states[domain])
+                            if len(groups) > 1 and templates.stream_scheduler_start_code():
+                                stream_groups[domain] = groups
+                                self.platform.log_debug("--- Domain %s: %i independent stream groups"%(domain, len(groups)))
+
         # First insert domain specific code (except processing code that depends on code generation)
-        for domain in processing_code:
+        for domain in domain_order:
             for platform_domain in domains:
                 if platform_domain['ports']['domainName'] == domain: # Check if domain is used in code (perhaps this should be cleanup by by the code resolver instread of having to check here?)
+                    if domain in stream_groups:
+                        self.write_section_in_file(platform_domain['ports']['initializationTag'], templates.stream_scheduler_start_code(), filename)
                     if platform_domain['ports']['domainIncludes']:
                         inc_text = templates.get_includes_code(platform_domain['ports']['domainIncludes'])
                         self.write_section_in_file(platform_domain['ports']['declarationsTag'], inc_text, filename)
                     if platform_domain['ports']['domainDeclarations']:
                         for declaration in platform_domain['ports']['domainDeclarations']:
                             self.write_section_in_file(platform_domain['ports']['declarationsTag'], templates.process_code(declaration['value']) + '\n', filename)
-                    if platform_domain['ports']['domainInitialization']:
+                    if platform_domain['ports']['domainInitialization'] and not self.is_library_domain(platform_domain):
                         self.write_section_in_file(platform_domain['ports']['initializationTag'], templates.process_code(platform_domain['ports']['domainInitialization']) + '\n', filename)
-                    if platform_domain['ports']['domainCleanup']:
+                    if platform_domain['ports']['domainCleanup'] and not self.is_library_domain(platform_domain):
                         self.write_section_in_file(platform_domain['ports']['cleanupTag'], templates.process_code(platform_domain['ports']['domainCleanup']) + '\n', filename)
+                    if domain in stream_groups:
+                        self.write_section_in_file(platform_domain['ports']['cleanupTag'], templates.stream_scheduler_stop_code(), filename)
+
+        # Profiling builds need the table of probe sites, which is complete
+        # only once all code has been generated
+        if templates.profiling:
+            for platform_domain in domains:
+                if platform_domain['ports']['domainName'] == self.platform.get_platform_domain():
+                    self.write_section_in_file(platform_domain['ports']['globalsTag'], templates.profile_declaration_code(), filename)
+                    self.write_section_in_file(platform_domain['ports']['cleanupTag'], templates.profile_report_code(), filename)
+                    break
 
         # Now join processing code from code generation with processing function from domain declaration
-        for domain in processing_code:
+        for domain in domain_order:
             for platform_domain in domains:
                 if platform_domain['ports']['domainName'] == domain:
-                    code = processing_code[domain]
-                    if not platform_domain['ports']['domainFunction'] == '':
-                        code = platform_domain['ports']['domainFunction'].replace("%%domainCode%%", code)
+                    if domain in stream_groups:
+                        code = self.parallel_domain_code(platform_domain, stream_groups[domain], processing_code[domain])
+                    else:
+                        code = '\n'.join(processing_code[domain])
+                        if self.is_library_domain(platform_domain):
+                            code = platform_domain['ports']['domainLibraryFunction'].replace("%%domainCode%%", code)
+                        elif not platform_domain['ports']['domainFunction'] == '':
+                            code = platform_domain['ports']['domainFunction'].replace("%%domainCode%%", code)
 
                     self.write_section_in_file(platform_domain['ports']['processingTag'], code, filename)
 
 
+    def is_library_domain(self, platform_domain):
+        return (self.library_build and 'domainLibraryFunction' in platform_domain['ports']
+                and not platform_domain['ports']['domainLibraryFunction'] == '')
+
+    def parallel_domain_code(self, platform_domain, groups, streams_code):
+        code = ''
+        group_names = []
+        for i, group in enumerate(groups):
+            group_name = '_stream_group_%03i'%i
+            group_names.append(group_name)
+            group_code = '\n'.join([streams_code[index] for index in group])
+            function = platform_domain['ports']['domainGroupFunction'].replace("%%groupName%%", group_name)
+            code += function.replace("%%domainCode%%", group_code)
+        code += templates.stream_scheduler_code(group_names, self.parallel_workers)
+        code += platform_domain['ports']['domainParallelFunction']
+        return code
+
     def make_code_pretty(self):
         if platform.system() == "Linux":
             try:
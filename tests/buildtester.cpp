@@ -36,6 +36,9 @@
 #include <cmath>
 
 #include <QList>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonDocument>
 
 #include "ast.h"
 #include "codevalidator.h"
@@ -70,7 +73,9 @@ bool BuildTester::test(std::string filename, std::string expectedResultFile)
      }
 
      if (tree) {
-         CodeValidator validator(QString::fromStdString(m_StrideRoot), tree, CodeValidator::USE_TESTING);
+         // Dead code is removed as in the compiler and editor builds
+         CodeValidator validator(QString::fromStdString(m_StrideRoot), tree,
+                                 (CodeValidator::Options) (CodeValidator::USE_TESTING | CodeValidator::ELIMINATE_DEAD_CODE));
          errors << validator.getErrors();
 
          if (errors.size() > 0) {
@@ -94,6 +99,16 @@ bool BuildTester::test(std::string filename, std::string expectedResultFile)
              std::cerr << "Can't create builder" << std::endl;
              return false;
          }
+         // Tests that need build options have them in a json file next
+         // to the stride file, in the format of the project config.json
+         QFileInfo fileInfo(QString::fromStdString(filename));
+         QFile configFile(fileInfo.absolutePath() + QDir::separator() + fileInfo.baseName() + ".json");
+         if (configFile.open(QIODevice::ReadOnly)) {
+             QVariantMap configuration = QJsonDocument::fromJson(configFile.readAll()).toVariant().toMap();
+             for (auto builder: m_builders) {
+                 builder->setConfiguration(configuration);
+             }
+         }
          buildOK = true;
          for (auto builder: m_builders) {
 //             connect(builder, SIGNAL(outputText(QString)), this, SLOT(printConsoleText(QString)));
@@ -6,12 +6,13 @@ TARGET = tst_parsertest
 CONFIG   += console
 CONFIG   -= app_bundle
 
-INCLUDEPATH += ../parser
+INCLUDEPATH += ../parser ../editor
 
 TEMPLATE = app
 
 SOURCES += tst_parsertest.cpp \
-    buildtester.cpp
+    buildtester.cpp \
+    ../editor/symbolindex.cpp
 DEFINES += BUILDPATH=\\\"$$OUT_PWD/\\\"
 CONFIG += c++11
 
@@ -83,6 +84,7 @@ DISTFILES += \
     data/P09_port_property.stride \
     data/P10_platform_validity.stride \
     data/P11_port_name_validation.stride \
+    data/P12_type_inheritance.stride \
     data/E01_constant_res.stride \
     data/E02_stream_expansions.stride \
     data/E03_multichn_streams.stride \
@@ -90,7 +92,10 @@ DISTFILES += \
     data/E05_library_objects.stride \
     data/E06_context_domain.stride \
     data/L01_library_types_validation.stride \
-    data/E07_namespaces.stride
+    data/E07_namespaces.stride \
+    data/E08_dead_code.stride \
+    data/E09_rate_order.stride \
+    data/E10_domain_order.stride
 
 # Link to codegen library
 
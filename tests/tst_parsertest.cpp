@@ -40,7 +40,9 @@
 #include "strideplatform.hpp"
 #include "codevalidator.h"
 #include "coderesolver.h"
+#include "analysiscache.h"
 #include "buildtester.hpp"
+#include "symbolindex.hpp"
 
 #define STRIDEROOT "../strideroot"
 
@@ -67,6 +69,10 @@ private Q_SLOTS:
     void testBlockMembers();
     void testModuleDomains();
     void testPortTypeValidation();
+    void testTypeInheritance();
+    void testParallelValidation();
+    void testAnalysisCacheFreedNodes();
+    void testSymbolIndexCompletion();
 
     //PlatformConsistency
     void testPlatformCommonObjects();
@@ -86,7 +92,10 @@ private Q_SLOTS:
     void testLibraryObjectInsertion();
     void testStreamExpansion();
     void testStreamRates();
+    void testRatePropagationOrder();
+    void testDomainPropagationOrder();
     void testConstantResolution();
+    void testDeadCodeElimination();
 //    void testNamespaces();
 
     // Parser
@@ -604,6 +613,160 @@ void ParserTest::testPortTypeValidation()
     QVERIFY(error.errorTokens[3] == "signal");
 }
 
+void ParserTest::testTypeInheritance()
+{
+    ASTNode tree;
+    tree = AST::parseFile(QString(QFINDTESTDATA("data/P12_type_inheritance.stride")).toStdString().c_str());
+    QVERIFY(tree != nullptr);
+    CodeValidator generator(QFINDTESTDATA(STRIDEROOT), tree, CodeValidator::NO_RATE_VALIDATION);
+    QVERIFY(generator.isValid());
+
+    // Own ports come first and every inherited port is listed once
+    QVector<ASTNode> ports = CodeValidator::getPortsForType("childType", QVector<ASTNode>(), tree);
+    QVERIFY(ports.size() > 3);
+    QVERIFY(static_cast<DeclarationNode *>(ports.at(0).get())->getName() == "ChildGainPort");
+    QStringList portNames;
+    for (ASTNode port: ports) {
+        QVERIFY(ports.count(port) == 1);
+        portNames << QString::fromStdString(static_cast<DeclarationNode *>(port.get())->getName());
+    }
+    QVERIFY(portNames.contains("GainPort"));
+    QVERIFY(portNames.contains("LabelPort"));
+
+    ASTNode gain = CodeValidator::getDefaultPortValueForType("childType", "gain", QVector<ASTNode>(), tree);
+    QVERIFY(gain && gain->getNodeType() == AST::Real);
+    QVERIFY(static_cast<ValueNode *>(gain.get())->getRealValue() == 0.5);
+    gain = CodeValidator::getDefaultPortValueForType("parentType", "gain", QVector<ASTNode>(), tree);
+    QVERIFY(gain && static_cast<ValueNode *>(gain.get())->getRealValue() == 1.0);
+
+    std::shared_ptr<DeclarationNode> child = CodeValidator::findDeclaration("Child", QVector<ASTNode>(), tree);
+    QVERIFY(child);
+    QVERIFY(child->getPropertyValue("gain"));
+
+    // Types added to the tree later are found
+    QList<LangError> errors;
+    QVERIFY(!CodeValidator::findTypeDeclarationByName("lateType", QVector<ASTNode>(), tree, errors));
+    std::shared_ptr<DeclarationNode> parentType = CodeValidator::findTypeDeclarationByName("parentType", QVector<ASTNode>(), tree, errors);
+    QVERIFY(parentType);
+    std::shared_ptr<DeclarationNode> lateType = static_pointer_cast<DeclarationNode>(parentType->deepCopy());
+    lateType->replacePropertyValue("typeName", std::make_shared<ValueNode>(string("lateType"), "", -1));
+    tree->addChild(lateType);
+    QVERIFY(CodeValidator::findTypeDeclarationByName("lateType", QVector<ASTNode>(), tree, errors) == lateType);
+    QVERIFY(CodeValidator::getPortsForType("lateType", QVector<ASTNode>(), tree).size()
+            == CodeValidator::getPortsForType("parentType", QVector<ASTNode>(), tree).size());
+}
+
+void ParserTest::testParallelValidation()
+{
+    // Errors must be the same and in the same order when validating in
+    // parallel. Rate validation is on, as it runs as one of the parallel jobs.
+    ASTNode tree = AST::parseFile(QString(QFINDTESTDATA("data/P07_type_validation.stride")).toStdString().c_str());
+    QVERIFY(tree != nullptr);
+    CodeValidator generator(QFINDTESTDATA(STRIDEROOT), tree);
+    ASTNode serialTree = AST::parseFile(QString(QFINDTESTDATA("data/P07_type_validation.stride")).toStdString().c_str());
+    QVERIFY(serialTree != nullptr);
+    CodeValidator serialGenerator(QFINDTESTDATA(STRIDEROOT), serialTree, CodeValidator::SERIAL_VALIDATION);
+
+    QList<LangError> errors = generator.getErrors();
+    QList<LangError> serialErrors = serialGenerator.getErrors();
+    QVERIFY(errors.size() > 0);
+    QVERIFY(errors.size() == serialErrors.size());
+    for (int i = 0; i < errors.size(); i++) {
+        QVERIFY(errors.at(i).type == serialErrors.at(i).type);
+        QVERIFY(errors.at(i).lineNumber == serialErrors.at(i).lineNumber);
+        QVERIFY(errors.at(i).errorTokens == serialErrors.at(i).errorTokens);
+    }
+}
+
+void ParserTest::testAnalysisCacheFreedNodes()
+{
+    // A node allocated where a freed one was must not get its results
+    ASTNode tree = std::make_shared<AST>();
+    QList<LangError> errors;
+    ASTNode node(new ValueNode(3, nullptr, 0));
+    AST *address = node.get();
+    QVERIFY(AnalysisCache::memoize(AnalysisCache::ConstInteger, node, QVector<ASTNode>(), tree,
+                                   &errors, []() { return 1.0; }) == 1.0);
+    QVERIFY(AnalysisCache::memoize(AnalysisCache::ConstInteger, node, QVector<ASTNode>(), tree,
+                                   &errors, []() { return 5.0; }) == 1.0);
+    // The allocator usually hands the freed address back within a few tries
+    for (int i = 0; i < 100; i++) {
+        node.reset();
+        node = ASTNode(new ValueNode(4, nullptr, 0));
+        if (node.get() == address) {
+            break;
+        }
+    }
+    QVERIFY(AnalysisCache::memoize(AnalysisCache::ConstInteger, node, QVector<ASTNode>(), tree,
+                                   &errors, []() { return 2.0; }) == 2.0);
+
+    // The same for a freed scope node
+    ASTNode scopeNode(new ValueNode(0, nullptr, 0));
+    address = scopeNode.get();
+    QVector<ASTNode> scope;
+    scope << scopeNode;
+    QVERIFY(AnalysisCache::memoize(AnalysisCache::ConstInteger, node, scope, tree,
+                                   &errors, []() { return 1.0; }) == 1.0);
+    for (int i = 0; i < 100; i++) {
+        scope.clear();
+        scopeNode.reset();
+        scopeNode = ASTNode(new ValueNode(0, nullptr, 0));
+        scope << scopeNode;
+        if (scopeNode.get() == address) {
+            break;
+        }
+    }
+    QVERIFY(AnalysisCache::memoize(AnalysisCache::ConstInteger, node, scope, tree,
+                                   &errors, []() { return 2.0; }) == 2.0);
+}
+
+void ParserTest::testSymbolIndexCompletion()
+{
+    SymbolIndex index;
+    index.addSymbol("SineOsc", SymbolIndex::Function, "SineOsc()");
+    index.addSymbol("Oscillator", SymbolIndex::Function, "Oscillator()");
+    index.addSymbol("LowOsc", SymbolIndex::Function, "LowOsc()");
+    index.addSymbol("Osc", SymbolIndex::Function, "Osc()");
+    index.addSymbol("OscType", SymbolIndex::Type, "OscType");
+    index.build();
+
+    // Queries shorter than 3 characters only complete prefixes
+    QVector<SymbolIndex::Symbol> matches = index.complete("Os", SymbolIndex::Function);
+    QVERIFY(matches.size() == 2);
+    QVERIFY(matches[0].name == "Osc");
+    QVERIFY(matches[1].name == "Oscillator");
+    QVERIFY(index.complete("Lo", SymbolIndex::Function).size() == 1);
+    QVERIFY(index.complete("sc", SymbolIndex::Function).isEmpty());
+
+    // Prefix matches come first, then names containing the query, each
+    // sorted by name. Symbols of the other kind are left out.
+    matches = index.complete("Osc", SymbolIndex::Function);
+    QVERIFY(matches.size() == 4);
+    QVERIFY(matches[0].name == "Osc");
+    QVERIFY(matches[1].name == "Oscillator");
+    QVERIFY(matches[2].name == "LowOsc");
+    QVERIFY(matches[3].name == "SineOsc");
+    QVERIFY(matches[3].syntax == "SineOsc()");
+    matches = index.complete("osc", SymbolIndex::Function);
+    QVERIFY(matches.size() == 4);
+    QVERIFY(matches[0].name == "LowOsc");
+    matches = index.complete("Osc", SymbolIndex::Type);
+    QVERIFY(matches.size() == 1);
+    QVERIFY(matches[0].name == "OscType");
+
+    // maxResults cuts the list after the best ranked matches
+    matches = index.complete("Osc", SymbolIndex::Function, 3);
+    QVERIFY(matches.size() == 3);
+    QVERIFY(matches[2].name == "LowOsc");
+    matches = index.complete("Osc", SymbolIndex::Function, 1);
+    QVERIFY(matches.size() == 1);
+    QVERIFY(matches[0].name == "Osc");
+
+    QVERIFY(index.findSymbol("Osc", SymbolIndex::Function));
+    QVERIFY(!index.findSymbol("Osc", SymbolIndex::Type));
+    QVERIFY(index.complete("Xyz", SymbolIndex::Function).isEmpty());
+}
+
 void ParserTest::testLibraryObjectInsertion()
 {
     ASTNode tree;
@@ -631,6 +794,43 @@ void ParserTest::testLibraryObjectInsertion()
     QVERIFY(!decl);
 }
 
+void ParserTest::testDeadCodeElimination()
+{
+    ASTNode tree;
+    tree = AST::parseFile(QString(QFINDTESTDATA("data/E08_dead_code.stride")).toStdString().c_str());
+    QVERIFY(tree != nullptr);
+    CodeValidator generator(QFINDTESTDATA(STRIDEROOT), tree,
+                            (CodeValidator::Options) (CodeValidator::NO_RATE_VALIDATION | CodeValidator::ELIMINATE_DEAD_CODE));
+    QVERIFY(generator.isValid());
+
+    int streamCount = 0;
+    for (ASTNode node: tree->getChildren()) {
+        if (node->getNodeType() == AST::Stream) {
+            streamCount++;
+        }
+    }
+    QVERIFY(streamCount == 5);
+
+    QVERIFY(CodeValidator::findDeclaration("Used", QVector<ASTNode>(), tree));
+    // Step is only read inside a live reaction
+    QVERIFY(CodeValidator::findDeclaration("Step", QVector<ASTNode>(), tree));
+    QVERIFY(CodeValidator::findDeclaration("Hold", QVector<ASTNode>(), tree));
+    QVERIFY(CodeValidator::findDeclaration("AudioOut", QVector<ASTNode>(), tree));
+    QVERIFY(!CodeValidator::findDeclaration("Unused", QVector<ASTNode>(), tree));
+    QVERIFY(!CodeValidator::findDeclaration("Feedback", QVector<ASTNode>(), tree));
+    QVERIFY(!CodeValidator::findDeclaration("NotUsed", QVector<ASTNode>(), tree));
+    // Level was only used by a dead stream
+    QVERIFY(!CodeValidator::findDeclaration("Level", QVector<ASTNode>(), tree));
+
+    std::shared_ptr<DeclarationNode> module = CodeValidator::findDeclaration("Gain", QVector<ASTNode>(), tree);
+    QVERIFY(module);
+    ListNode *streams = static_cast<ListNode *>(module->getPropertyValue("streams").get());
+    QVERIFY(streams->getChildren().size() == 1);
+    ListNode *blockList = static_cast<ListNode *>(module->getPropertyValue("blocks").get());
+    QVERIFY(CodeValidator::findDeclaration("Output", QVector<ASTNode>::fromStdVector(blockList->getChildren()), nullptr));
+    QVERIFY(!CodeValidator::findDeclaration("Internal", QVector<ASTNode>::fromStdVector(blockList->getChildren()), nullptr));
+}
+
 void ParserTest::testContextDomain()
 {
     ASTNode tree;
@@ -1075,6 +1275,40 @@ void ParserTest::testStreamRates()
     QVERIFY(CodeValidator::getNodeRate(stream->getRight(), QVector<ASTNode>(), tree) == 44100);
 }
 
+void ParserTest::testRatePropagationOrder()
+{
+    ASTNode tree;
+    tree = AST::parseFile(QString(QFINDTESTDATA("data/E09_rate_order.stride")).toStdString().c_str());
+    QVERIFY(tree != nullptr);
+    CodeValidator generator(QFINDTESTDATA(STRIDEROOT), tree);
+    QVERIFY(generator.isValid());
+
+    // Pulled through a stream that comes later
+    QVERIFY(CodeValidator::getNodeRate(std::make_shared<BlockNode>("First", "", -1), QVector<ASTNode>(), tree) == 22050);
+    QVERIFY(CodeValidator::getNodeRate(std::make_shared<BlockNode>("Middle", "", -1), QVector<ASTNode>(), tree) == 22050);
+
+    // Pushed from a stream that comes later
+    QVERIFY(CodeValidator::getNodeRate(std::make_shared<BlockNode>("Copy", "", -1), QVector<ASTNode>(), tree) == 11025);
+    QVERIFY(CodeValidator::getNodeRate(std::make_shared<BlockNode>("Sink", "", -1), QVector<ASTNode>(), tree) == 11025);
+}
+
+void ParserTest::testDomainPropagationOrder()
+{
+    ASTNode tree;
+    tree = AST::parseFile(QString(QFINDTESTDATA("data/E10_domain_order.stride")).toStdString().c_str());
+    QVERIFY(tree != nullptr);
+    CodeValidator generator(QFINDTESTDATA(STRIDEROOT), tree, CodeValidator::NO_RATE_VALIDATION);
+    QVERIFY(generator.isValid());
+
+    for (auto name : {"First", "Middle"}) {
+        std::shared_ptr<DeclarationNode> decl = CodeValidator::findDeclaration(name, QVector<ASTNode>(), tree);
+        QVERIFY(decl);
+        ASTNode domain = decl->getDomain();
+        QVERIFY(domain && domain->getNodeType() == AST::String);
+        QVERIFY(static_cast<ValueNode *>(domain.get())->getStringValue() == "OSCInDomain");
+    }
+}
+
 void ParserTest::testStreamExpansion()
 {
     ASTNode tree;
@@ -2021,6 +2255,17 @@ void ParserTest::testScope()
     QVERIFY(node->getName() == "Block_2");
     QVERIFY(node->getScopeLevels() == 1);
     QVERIFY(node->getScopeAt(0) == "Ns");
+    // Namespaces and files are shared between nodes
+    QVERIFY(node->getNamespaceId() == stream->getLeft()->getNamespaceId());
+    QVERIFY(node->getNamespaceId() != stream->getNamespaceId());
+    QVERIFY(node->getFileId() == stream->getFileId());
+    ASTNode copy = stream->getRight()->deepCopy();
+    QVERIFY(copy->getNamespaceId() == node->getNamespaceId());
+    QVERIFY(copy->getFilename() == node->getFilename());
+    copy->setRootScope("Outer");
+    QVERIFY(copy->getScopeLevels() == 2);
+    QVERIFY(copy->getScopeAt(0) == "Outer");
+    QVERIFY(node->getScopeLevels() == 1);
 
 
     //    Ns::Bundle[1] + Ns::Bundle[2] >> Constant;